@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "disjoint_set.h"
+
+DisjointSet* dset_create (int size)
+{
+  DisjointSet *set = NULL;
+  int i;
+
+  if (size <= 0)
+    return NULL;
+
+  set = (DisjointSet *)calloc(1, sizeof (DisjointSet));
+  if (! set)
+  {
+    printf ("[%s,%d] Fail to allocate memory for disjoint set\n", __func__, __LINE__);
+    return NULL;
+  }
+
+  set->parent = (int *)malloc(size * sizeof (int));
+  set->rank   = (unsigned char *)calloc(size, sizeof (unsigned char));
+  if (! set->parent || ! set->rank)
+  {
+    printf ("[%s,%d] Fail to allocate memory for disjoint set arrays\n", __func__, __LINE__);
+    dset_deinit (set);
+    return NULL;
+  }
+
+  for (i = 0; i < size; ++i)
+    set->parent[i] = i;
+
+  set->size     = size;
+  set->numSets  = size;
+  return set;
+}
+
+void dset_deinit (DisjointSet *set)
+{
+  if (! set)
+    return;
+
+  if (set->parent)  free (set->parent);
+  if (set->rank)    free (set->rank);
+  free (set);
+  set = NULL;
+}
+
+/* Representative of the set of item, every item on the way is linked to it */
+int dset_find (DisjointSet *set, int item)
+{
+  int root, next;
+
+  if (! set || item < 0 || item >= set->size)
+    return -1;
+
+  root = item;
+  while (set->parent[root] != root)
+    root = set->parent[root];
+
+  while (set->parent[item] != root)
+  {
+    next = set->parent[item];
+    set->parent[item] = root;
+    item = next;
+  }
+
+  return root;
+}
+
+/* Same as dset_find without writing, so threads can query while no union runs */
+int dset_find_root (DisjointSet *set, int item)
+{
+  if (! set || item < 0 || item >= set->size)
+    return -1;
+
+  while (set->parent[item] != item)
+    item = set->parent[item];
+
+  return item;
+}
+
+/* Merge the sets of both items, return 1 if they were apart, 0 if not, -1 on error */
+int dset_union (DisjointSet *set, int item_1, int item_2)
+{
+  int root_1, root_2;
+
+  root_1 = dset_find (set, item_1);
+  root_2 = dset_find (set, item_2);
+  if (root_1 == -1 || root_2 == -1)
+    return -1;
+
+  if (root_1 == root_2)
+    return 0;
+
+  if (set->rank[root_1] < set->rank[root_2])
+    set->parent[root_1] = root_2;
+  else if (set->rank[root_1] > set->rank[root_2])
+    set->parent[root_2] = root_1;
+  else
+  {
+    set->parent[root_2] = root_1;
+    set->rank[root_1]++;
+  }
+
+  set->numSets--;
+  return 1;
+}
+
+/*
+ * Lock-free variants for threads that find and union at the same time.
+ * Paths are halved with compare-and-swap and roots are linked by index,
+ * the larger one under the smaller, so the rank array is not used.
+ */
+int dset_find_concurrent (DisjointSet *set, int item)
+{
+  int parent, grand;
+
+  if (! set || item < 0 || item >= set->size)
+    return -1;
+
+  for (;;)
+  {
+    parent = __atomic_load_n (&set->parent[item], __ATOMIC_ACQUIRE);
+    if (parent == item)
+      return item;
+
+    grand = __atomic_load_n (&set->parent[parent], __ATOMIC_ACQUIRE);
+    if (grand != parent)
+      __atomic_compare_exchange_n (&set->parent[item], &parent, grand, 0,
+                                   __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+    item = grand;
+  }
+}
+
+/* Return 1 if this call merged the two sets, 0 if they already were one, -1 on error */
+int dset_union_concurrent (DisjointSet *set, int item_1, int item_2)
+{
+  int root_1, root_2, swap;
+
+  for (;;)
+  {
+    root_1 = dset_find_concurrent (set, item_1);
+    root_2 = dset_find_concurrent (set, item_2);
+    if (root_1 == -1 || root_2 == -1)
+      return -1;
+
+    if (root_1 == root_2)
+      return 0;
+
+    if (root_1 < root_2)
+    {
+      swap    = root_1;
+      root_1  = root_2;
+      root_2  = swap;
+    }
+
+    /* Fails if root_1 got linked meanwhile, then look again */
+    if (__atomic_compare_exchange_n (&set->parent[root_1], &root_1, root_2, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+    {
+      __atomic_fetch_sub (&set->numSets, 1, __ATOMIC_RELAXED);
+      return 1;
+    }
+  }
+}
@@ -0,0 +1,24 @@
+#ifndef __DISJOINT_SET_H__
+#define __DISJOINT_SET_H__
+
+/*
+ * Union-find over the items 0 .. size - 1, with path compression and
+ * union by rank
+ */
+typedef struct DisjointSet
+{
+  int size;
+  int numSets;
+  int *parent;
+  unsigned char *rank;
+} DisjointSet;
+
+DisjointSet* dset_create (int size);
+void dset_deinit (DisjointSet *set);
+int dset_find (DisjointSet *set, int item);
+int dset_find_root (DisjointSet *set, int item);
+int dset_union (DisjointSet *set, int item_1, int item_2);
+int dset_find_concurrent (DisjointSet *set, int item);
+int dset_union_concurrent (DisjointSet *set, int item_1, int item_2);
+
+#endif /* __DISJOINT_SET_H__ */
@@ -3,20 +3,83 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include <limits.h>
 #include "graph.h"
-#include "stack.h"
 #include "queue.h"
-#include "priority_queue.h"
+#include "indexed_heap.h"
+#include "worker_pool.h"
+#include "disjoint_set.h"
 
-#define MAX_VERTICES 100
-#define INFINITY     10000
-#define UNKNOW_VETEX -1
+#define GRAPH_DENSE_INDEX_FACTOR  4
+#define GRAPH_HASH_MIN_CAPACITY   16
+#define GRAPH_HASH_EMPTY          -1
+#define GRAPH_HASH_DELETED        -2
 
 #define MIN(A,B)    (((A) < (B)) ? (A) : (B))
+#define MAX(A,B)    (((A) > (B)) ? (A) : (B))
+
+/*
+ * Edge nodes come out of slabs owned by the graph instead of one malloc
+ * each. The newest slab hands out its nodes in address order, so arcs
+ * added together sit next to each other, removed nodes go to a free list
+ * that is drawn from first, and graph_deinit releases whole slabs without
+ * walking the adjacency lists. Slabs start at GRAPH_SLAB_MIN_NODES nodes
+ * and double up to GRAPH_SLAB_MAX_NODES.
+ */
+#define GRAPH_SLAB_MIN_NODES    64
+#define GRAPH_SLAB_MAX_NODES    (1 << 16)
+
+typedef struct VertexSlab
+{
+  struct VertexSlab *next;
+  int capacity;
+  int used;
+  Vertex nodes[];
+} VertexSlab;
+
+static Vertex *graph_node_alloc (Graph* graph)
+{
+  VertexSlab *slab;
+  Vertex *node;
+
+  if (graph->freeNodes)
+  {
+    node              = graph->freeNodes;
+    graph->freeNodes  = node->next;
+    graph->numFreeNodes--;
+    return node;
+  }
+
+  slab = graph->slabs;
+  if (! slab || slab->used == slab->capacity)
+  {
+    slab = (VertexSlab *)malloc(sizeof (VertexSlab) + (size_t)graph->slabNodes * sizeof (Vertex));
+    if (! slab)
+      return NULL;
+
+    slab->next        = graph->slabs;
+    slab->capacity    = graph->slabNodes;
+    slab->used        = 0;
+    graph->slabs      = slab;
+    graph->slabNodes  = MIN(graph->slabNodes * 2, GRAPH_SLAB_MAX_NODES);
+  }
+
+  return &slab->nodes[slab->used++];
+}
+
+static void vertex_release (Graph* graph, Vertex* node)
+{
+  node->next        = graph->freeNodes;
+  graph->freeNodes  = node;
+  graph->numFreeNodes++;
+}
 
-Vertex *vertex_init (int id, int dest, int weight)
+Vertex *vertex_init (Graph* graph, int id, int dest, int weight)
 {
-  Vertex* newVertex = (Vertex*)malloc(sizeof(Vertex));
+  Vertex* newVertex = graph_node_alloc (graph);
+  if (! newVertex)
+    return NULL;
+
   newVertex->id           = id;
   newVertex->edge.dest    = dest;
   newVertex->edge.weight  = weight;
@@ -25,83 +88,375 @@ Vertex *vertex_init (int id, int dest, int weight)
   return newVertex;
 }
 
-Graph* graph_init(int numVertices) 
+/*
+ * numVertices is only the initial number of slots, the vertex arrays grow
+ * geometrically when more vertices are added. Without GRAPH_DIRECTED in
+ * flags every edge is stored as two arcs, one at each end.
+ */
+Graph* graph_init(int numVertices)
 {
-  if (numVertices <= 0 || numVertices > MAX_VERTICES)
+  return graph_init_flags (numVertices, 0);
+}
+
+Graph* graph_init_flags (int numVertices, int flags)
+{
+  if (numVertices <= 0)
   {
-    printf("Error: Number of vertices must be between 1 and %d\n", MAX_VERTICES);
+    printf("Error: Number of vertices must be positive\n");
     return NULL;
   }
 
-  Graph* graph = (Graph*)malloc(sizeof(Graph));
+  Graph* graph = (Graph*)calloc(1, sizeof(Graph));
   if (! graph)
   {
 	  printf ("Fail to allocate memory for graph!\n");
 	  return NULL;
   }
 
-  graph->numVertices = numVertices;
-  graph->vertices = malloc(numVertices * sizeof(Vertex *));
-  if (! graph->vertices)
+  graph->capacity   = numVertices;
+  graph->directed   = (flags & GRAPH_DIRECTED) ? 1 : 0;
+  graph->slabNodes  = GRAPH_SLAB_MIN_NODES;
+  graph->vertices   = malloc(numVertices * sizeof(Vertex *));
+  graph->tails      = malloc(numVertices * sizeof(Vertex *));
+  graph->slotIds    = malloc(numVertices * sizeof(int));
+  graph->freeSlots  = malloc(numVertices * sizeof(int));
+  if (graph->directed)
+    graph->inDegree = calloc(numVertices, sizeof(int));
+  if (! graph->vertices || ! graph->tails || ! graph->slotIds || ! graph->freeSlots
+      || (graph->directed && ! graph->inDegree))
   {
 	  printf ("Fail to allocate memory for vertices!\n");
+	  graph_deinit (graph);
 	  return NULL;
   }
 
   for (int i = 0; i < numVertices; i++)
+  {
     graph->vertices[i] = NULL;
+    graph->tails[i]    = NULL;
+    graph->slotIds[i]  = UNKNOW_VETEX;
+  }
 
   return graph;
 }
 
-int graph_get_vertex_by_id (Graph* graph, int id)
+/*
+ * Vertex id -> slot index
+ * Compact ids (smaller than a few times the number of slots) are looked up
+ * in the dense array, other ids go to an open addressing hash table with
+ * linear probing. Both are updated whenever a slot is taken or released.
+ */
+static unsigned int graph_id_hash (int id, int capacity)
 {
-  int i = 0;
+  return ((unsigned int)id * 2654435761u) & (unsigned int)(capacity - 1);
+}
 
-  if (! graph)
+static int graph_hash_lookup (Graph* graph, int id)
+{
+  unsigned int pos;
+  int n;
+
+  if (! graph->hashSize)
     return UNKNOW_VETEX;
 
-  for (i = 0; i < graph->numVertices; i++)
+  pos = graph_id_hash (id, graph->hashCapacity);
+  for (n = 0; n < graph->hashCapacity; ++n)
   {
-    if (graph->vertices[i]
-        && graph->vertices[i]->id == id)
+    if (graph->hashKeys[pos] == GRAPH_HASH_EMPTY)
       break;
+    if (graph->hashKeys[pos] == id)
+      return graph->hashSlots[pos];
+
+    pos = (pos + 1) & (graph->hashCapacity - 1);
   }
 
-  if (i == graph->numVertices)
-    return UNKNOW_VETEX;
+  return UNKNOW_VETEX;
+}
 
-  return i;
+static int graph_hash_resize (Graph* graph, int capacity)
+{
+  int *old_keys = graph->hashKeys, *old_slots = graph->hashSlots;
+  int old_capacity = graph->hashCapacity, i;
+  unsigned int pos;
+
+  graph->hashKeys   = (int *)malloc(capacity * sizeof (int));
+  graph->hashSlots  = (int *)malloc(capacity * sizeof (int));
+  if (! graph->hashKeys || ! graph->hashSlots)
+  {
+    printf ("[%s,%d] Fail to allocate memory for vertex hash index\n", __func__, __LINE__);
+    if (graph->hashKeys)  free (graph->hashKeys);
+    if (graph->hashSlots) free (graph->hashSlots);
+    graph->hashKeys   = old_keys;
+    graph->hashSlots  = old_slots;
+    return -1;
+  }
+
+  for (i = 0; i < capacity; ++i)
+    graph->hashKeys[i] = GRAPH_HASH_EMPTY;
+
+  graph->hashCapacity = capacity;
+  graph->hashUsed     = graph->hashSize;
+
+  /* Re-insert the live keys, tombstones are dropped */
+  for (i = 0; i < old_capacity; ++i)
+  {
+    if (old_keys[i] < 0)
+      continue;
+
+    pos = graph_id_hash (old_keys[i], capacity);
+    while (graph->hashKeys[pos] != GRAPH_HASH_EMPTY)
+      pos = (pos + 1) & (capacity - 1);
+
+    graph->hashKeys[pos]  = old_keys[i];
+    graph->hashSlots[pos] = old_slots[i];
+  }
+
+  if (old_keys)   free (old_keys);
+  if (old_slots)  free (old_slots);
+  return 0;
 }
 
-int graph_get_empty_vertex (Graph* graph)
+static int graph_hash_insert (Graph* graph, int id, int slot)
 {
-  int i = 0;
+  unsigned int pos;
+  int capacity;
 
-  if (! graph)
+  /* Keep the table at most half full, counting tombstones */
+  if ((graph->hashUsed + 1) * 2 > graph->hashCapacity)
+  {
+    capacity = (graph->hashCapacity) ? graph->hashCapacity : GRAPH_HASH_MIN_CAPACITY;
+    while ((graph->hashSize + 1) * 4 > capacity)
+      capacity *= 2;
+
+    if (graph_hash_resize (graph, capacity) != 0)
+      return -1;
+  }
+
+  pos = graph_id_hash (id, graph->hashCapacity);
+  while (graph->hashKeys[pos] >= 0)
+    pos = (pos + 1) & (graph->hashCapacity - 1);
+
+  if (graph->hashKeys[pos] == GRAPH_HASH_EMPTY)
+    graph->hashUsed++;
+  graph->hashKeys[pos]  = id;
+  graph->hashSlots[pos] = slot;
+  graph->hashSize++;
+  return 0;
+}
+
+static void graph_hash_remove (Graph* graph, int id)
+{
+  unsigned int pos;
+  int n;
+
+  if (! graph->hashSize)
+    return;
+
+  pos = graph_id_hash (id, graph->hashCapacity);
+  for (n = 0; n < graph->hashCapacity; ++n)
+  {
+    if (graph->hashKeys[pos] == GRAPH_HASH_EMPTY)
+      return;
+    if (graph->hashKeys[pos] == id)
+    {
+      graph->hashKeys[pos] = GRAPH_HASH_DELETED;
+      graph->hashSize--;
+      return;
+    }
+
+    pos = (pos + 1) & (graph->hashCapacity - 1);
+  }
+}
+
+static int graph_index_add (Graph* graph, int id, int slot)
+{
+  int size, i, *new_index;
+
+  if (id / GRAPH_DENSE_INDEX_FACTOR < graph->capacity)
+  {
+    if (id >= graph->denseSize)
+    {
+      size = (graph->denseSize) ? graph->denseSize : graph->capacity;
+      while (size <= id)
+        size *= 2;
+
+      new_index = (int *)realloc(graph->denseIndex, size * sizeof (int));
+      if (! new_index)
+      {
+        printf ("[%s,%d] Fail to allocate memory for vertex index\n", __func__, __LINE__);
+        return -1;
+      }
+
+      for (i = graph->denseSize; i < size; ++i)
+        new_index[i] = UNKNOW_VETEX;
+      graph->denseIndex = new_index;
+      graph->denseSize  = size;
+    }
+    graph->denseIndex[id] = slot;
+  }
+  else if (graph_hash_insert (graph, id, slot) != 0)
+    return -1;
+
+  graph->slotIds[slot] = id;
+  return 0;
+}
+
+static void graph_index_remove (Graph* graph, int id, int slot)
+{
+  if (id < graph->denseSize
+      && graph->denseIndex[id] == slot)
+    graph->denseIndex[id] = UNKNOW_VETEX;
+  else
+    graph_hash_remove (graph, id);
+
+  graph->slotIds[slot] = UNKNOW_VETEX;
+  graph->freeSlots[graph->numFree++] = slot;
+}
+
+int graph_get_vertex_by_id (Graph* graph, int id)
+{
+  if (! graph || id < 0)
     return UNKNOW_VETEX;
 
-  for (i = 0; i < graph->numVertices; i++)
+  if (id < graph->denseSize
+      && graph->denseIndex[id] != UNKNOW_VETEX)
+    return graph->denseIndex[id];
+
+  return graph_hash_lookup (graph, id);
+}
+
+static int graph_grow (Graph* graph)
+{
+  Vertex **new_vertices;
+  int *new_slot_ids, *new_free_slots, *new_in_degree, capacity, i;
+
+  if (graph->capacity > INT_MAX / 2)
   {
-    if (graph->vertices[i] == NULL)
-      break;
+    printf ("[%s,%d] Graph can not hold more vertices\n", __func__, __LINE__);
+    return -1;
+  }
+  capacity = graph->capacity * 2;
+
+  new_vertices = (Vertex **)realloc(graph->vertices, capacity * sizeof (Vertex *));
+  if (! new_vertices)
+    goto ERR_EXIT;
+  graph->vertices = new_vertices;
+
+  new_vertices = (Vertex **)realloc(graph->tails, capacity * sizeof (Vertex *));
+  if (! new_vertices)
+    goto ERR_EXIT;
+  graph->tails = new_vertices;
+
+  new_slot_ids = (int *)realloc(graph->slotIds, capacity * sizeof (int));
+  if (! new_slot_ids)
+    goto ERR_EXIT;
+  graph->slotIds = new_slot_ids;
+
+  new_free_slots = (int *)realloc(graph->freeSlots, capacity * sizeof (int));
+  if (! new_free_slots)
+    goto ERR_EXIT;
+  graph->freeSlots = new_free_slots;
+
+  if (graph->directed)
+  {
+    new_in_degree = (int *)realloc(graph->inDegree, capacity * sizeof (int));
+    if (! new_in_degree)
+      goto ERR_EXIT;
+    graph->inDegree = new_in_degree;
+    memset (graph->inDegree + graph->capacity, 0, (capacity - graph->capacity) * sizeof (int));
+  }
+
+  for (i = graph->capacity; i < capacity; ++i)
+  {
+    graph->vertices[i] = NULL;
+    graph->tails[i]    = NULL;
+    graph->slotIds[i]  = UNKNOW_VETEX;
   }
+  graph->capacity = capacity;
+  return 0;
+
+ERR_EXIT:
+  /* Arrays that were already grown stay valid, only the capacity is kept */
+  printf ("[%s,%d] Fail to grow the vertex arrays\n", __func__, __LINE__);
+  return -1;
+}
+
+int graph_get_empty_vertex (Graph* graph)
+{
+  if (! graph)
+    return UNKNOW_VETEX;
+
+  /* Reuse a released slot first, then hand out the next untouched one */
+  if (graph->numFree)
+    return graph->freeSlots[--graph->numFree];
+
+  if (graph->numVertices == graph->capacity
+      && graph_grow (graph) != 0)
+    return UNKNOW_VETEX;
+
+  return graph->numVertices++;
+}
 
-  if (i == graph->numVertices)
+/* Return the slot of the vertex, taking a new slot if the id is not in the graph yet */
+static int graph_get_or_add_vertex (Graph* graph, int id)
+{
+  int i;
+
+  i = graph_get_vertex_by_id (graph, id);
+  if (i != UNKNOW_VETEX)
+    return i;
+
+  i = graph_get_empty_vertex (graph);
+  if (i == UNKNOW_VETEX)
+    return UNKNOW_VETEX;
+
+  if (graph_index_add (graph, id, i) != 0)
   {
-    printf ("[%s,%d] Graph is already full\n", __func__, __LINE__);
+    graph->freeSlots[graph->numFree++] = i;
     return UNKNOW_VETEX;
   }
 
   return i;
 }
 
+/* Link node after the last arc of slot i */
+static void graph_list_append (Graph* graph, int i, Vertex* node)
+{
+  node->prev = graph->tails[i];
+  if (graph->tails[i] == NULL)
+    graph->vertices[i] = node;
+  else
+    graph->tails[i]->next = node;
+  graph->tails[i] = node;
+}
+
+static void graph_list_unlink (Graph* graph, int i, Vertex* node)
+{
+  if (node->prev != NULL)
+    node->prev->next = node->next;
+  else
+    graph->vertices[i] = node->next;
+
+  if (node->next != NULL)
+    node->next->prev = node->prev;
+  else
+    graph->tails[i] = node->prev;
+}
+
+/* A slot is released once no arc leaves it, and in a directed graph none enters it */
+static int graph_slot_unused (Graph* graph, int i)
+{
+  return graph->vertices[i] == NULL
+         && (! graph->directed || graph->inDegree[i] == 0);
+}
+
 int graph_add_edge(Graph* graph, int src, int dest, int weight)
 {
   Vertex* newVertex = NULL;
   int i = 0;
 
-  if (src < 0
+  if (! graph
+      || src < 0
       || dest < 0
       || src == dest)
   {
@@ -109,71 +464,207 @@ int graph_add_edge(Graph* graph, int src, int dest, int weight)
     return -1;
   }
 
+  /* Get location for vertex */
+  i = graph_get_or_add_vertex (graph, src);
+  if (i == UNKNOW_VETEX)
+    return -1;
+
   /* Add edge for src->dest */
-  newVertex = vertex_init(src, dest, weight);
+  newVertex = vertex_init(graph, src, dest, weight);
   if (newVertex == NULL)
   {
     printf("Error: Could not allocate memory for new vertex\n");
     return -1;
   }
 
+  graph_list_append (graph, i, newVertex);
+  graph->numEdges++;
+
   /* Get location for vertex */
-  i = graph_get_vertex_by_id (graph, src);
+  i = graph_get_or_add_vertex (graph, dest);
   if (i == UNKNOW_VETEX)
-  {
-    i = graph_get_empty_vertex (graph);
-    if (i == UNKNOW_VETEX)
-      return -1;
-  }
+    return -1;
 
-  if (graph->vertices[i] == NULL)
-    graph->vertices[i] = newVertex;
-  else
+  if (graph->directed)
   {
-    Vertex* temp = graph->vertices[i];
-    while (temp->next != NULL) {
-      temp = temp->next;
-    }
-    temp->next = newVertex;
-    newVertex->prev = temp;
+    graph->inDegree[i]++;
+    return 0;
   }
 
   /* Add edge for dest->src */
-  newVertex = vertex_init(dest, src, weight);
+  newVertex = vertex_init(graph, dest, src, weight);
   if (newVertex == NULL) {
     printf("Error: Could not allocate memory for new vertex\n");
     return -1;
   }
 
-  /* Get location for vertex */
-  i = graph_get_vertex_by_id (graph, dest);
-  if (i == UNKNOW_VETEX)
+  graph_list_append (graph, i, newVertex);
+  graph->numEdges++;
+
+  return 0;
+}
+
+/*
+ * Insert num_edges edges between vertex ids, the same graph as that many
+ * graph_add_edge calls in a row. The edges go in batches of
+ * GRAPH_ADD_EDGES_BATCH: every id of a batch is resolved to its slot once,
+ * the new arcs are counted per slot and bucketed by a prefix sum, their
+ * nodes are taken in bucket order so the new arcs of a slot are adjacent
+ * in the slab, then they are linked into one chain and spliced after the
+ * tail of the slot.
+ * Return 0 on success, -1 on error, the batches before a failing one stay
+ * in the graph.
+ */
+#define GRAPH_ADD_EDGES_BATCH   (1 << 20)
+
+int graph_add_edges (Graph* graph, const GraphEdge *edges, int num_edges)
+{
+  const GraphEdge *edge;
+  Vertex **arcs = NULL, *node;
+  int *slots = NULL, *touched = NULL, *order = NULL, *count = NULL, *new_count;
+  int first, num, num_arcs, num_resolved = 0, num_touched, count_size = 0, total, i, j, s, end, rv = -1;
+  int step = (graph && graph->directed) ? 2 : 1;
+
+  if (! graph || (num_edges && ! edges) || num_edges < 0)
+    return -1;
+
+  for (i = 0; i < num_edges; ++i)
   {
-    i = graph_get_empty_vertex (graph);
-    if (i == UNKNOW_VETEX)
+    if (edges[i].src < 0 || edges[i].dest < 0 || edges[i].src == edges[i].dest)
+    {
+      printf ("[%s,%d] Error: Edge %d (%d -> %d) is out of bounds\n", __func__, __LINE__,
+              i, edges[i].src, edges[i].dest);
       return -1;
+    }
   }
 
-  if (graph->vertices[i] == NULL)
-    graph->vertices[i] = newVertex;
-  else
+  num       = MIN(num_edges, GRAPH_ADD_EDGES_BATCH);
+  slots     = (int *)malloc(2 * num * sizeof (int));
+  touched   = (int *)malloc(2 * num * sizeof (int));
+  order     = (int *)malloc(2 * num * sizeof (int));
+  arcs      = (Vertex **)malloc(2 * num * sizeof (Vertex *));
+  if (num && (! slots || ! touched || ! order || ! arcs))
   {
-    Vertex* temp = graph->vertices[i];
-    while (temp->next != NULL) {
-      temp = temp->next;
+    printf ("[%s,%d] Fail to allocate memory for edge batch\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  for (first = 0; first < num_edges; first += GRAPH_ADD_EDGES_BATCH)
+  {
+    num       = MIN(num_edges - first, GRAPH_ADD_EDGES_BATCH);
+    num_arcs  = 2 * num / step;
+
+    /* Arc 2k is src -> dest of edge k, arc 2k + 1 its reverse, left out when directed */
+    for (j = 0; j < 2 * num; ++j)
+    {
+      edge      = &edges[first + j / 2];
+      slots[j]  = graph_get_or_add_vertex (graph, (j & 1) ? edge->dest : edge->src);
+      if (slots[j] == UNKNOW_VETEX)
+        goto EXIT;
+      num_resolved++;
+    }
+
+    if (count_size < graph->capacity)
+    {
+      new_count = (int *)realloc(count, graph->capacity * sizeof (int));
+      if (! new_count)
+      {
+        printf ("[%s,%d] Fail to allocate memory for degree count\n", __func__, __LINE__);
+        goto EXIT;
+      }
+      count = new_count;
+      memset (count + count_size, 0, (graph->capacity - count_size) * sizeof (int));
+      count_size = graph->capacity;
+    }
+
+    num_touched = 0;
+    for (j = 0; j < 2 * num; j += step)
+    {
+      if (count[slots[j]]++ == 0)
+        touched[num_touched++] = slots[j];
+    }
+
+    /* count[s] becomes the end of the bucket of s, the backward scatter moves it to the start */
+    total = 0;
+    for (i = 0; i < num_touched; ++i)
+    {
+      total            += count[touched[i]];
+      count[touched[i]] = total;
+    }
+
+    for (j = 2 * num - step; j >= 0; j -= step)
+      order[--count[slots[j]]] = j;
+
+    for (i = 0; i < num_arcs; ++i)
+    {
+      j     = order[i];
+      edge  = &edges[first + j / 2];
+      node  = (j & 1) ? vertex_init (graph, edge->dest, edge->src, edge->weight)
+                      : vertex_init (graph, edge->src, edge->dest, edge->weight);
+      if (! node)
+      {
+        printf ("Error: Could not allocate memory for new vertex\n");
+        while (i > 0)
+          vertex_release (graph, arcs[--i]);
+        goto EXIT;
+      }
+      arcs[i] = node;
     }
-    temp->next = newVertex;
-    newVertex->prev = temp;
+
+    for (i = 0; i < num_touched; ++i)
+    {
+      s   = touched[i];
+      end = (i + 1 < num_touched) ? count[touched[i + 1]] : num_arcs;
+      for (j = count[s]; j < end - 1; ++j)
+      {
+        arcs[j]->next     = arcs[j + 1];
+        arcs[j + 1]->prev = arcs[j];
+      }
+
+      node                  = graph->tails[s];
+      arcs[count[s]]->prev  = node;
+      if (node == NULL)
+        graph->vertices[s] = arcs[count[s]];
+      else
+        node->next = arcs[count[s]];
+      graph->tails[s] = arcs[end - 1];
+      count[s]        = 0;
+    }
+
+    if (graph->directed)
+      for (j = 1; j < 2 * num; j += 2)
+        graph->inDegree[slots[j]]++;
+
+    graph->numEdges += num_arcs;
+    num_resolved = 0;
+  }
+  rv = 0;
+
+EXIT:
+  /* Vertices the failed batch created are released again */
+  for (j = 0; j < num_resolved; ++j)
+  {
+    s = slots[j];
+    if (graph_slot_unused (graph, s) && graph->slotIds[s] != UNKNOW_VETEX)
+      graph_index_remove (graph, graph->slotIds[s], s);
   }
+
+  if (slots)    free (slots);
+  if (touched)  free (touched);
+  if (order)    free (order);
+  if (arcs)     free (arcs);
+  if (count)    free (count);
+  return rv;
 }
 
-int graph_remove_edge(Graph* graph, int src, int dest) 
+int graph_remove_edge(Graph* graph, int src, int dest)
 {
   int i = 0;
 
-  if (src < 0
+  if (! graph
+      || src < 0
       || dest < 0
-      || src == dest) 
+      || src == dest)
   {
     printf("Error: Vertex index out of bounds\n");
     return -1;
@@ -190,7 +681,6 @@ int graph_remove_edge(Graph* graph, int src, int dest)
 
   Vertex* temp = graph->vertices[i];
   while (temp != NULL
-        && temp->id != src
         && temp->edge.dest != dest) {
     temp = temp->next;
   }
@@ -199,16 +689,26 @@ int graph_remove_edge(Graph* graph, int src, int dest)
     return -1;
   }
 
-  if (temp->prev != NULL)
-    temp->prev->next = temp->next;
-  else
-    graph->vertices[i] = temp->next;
+  graph_list_unlink (graph, i, temp);
+  vertex_release (graph, temp);
+  temp = NULL;
+  graph->numEdges--;
 
-  if (temp->next != NULL)
-    temp->next->prev = temp->prev;
+  /* Release the slot once the vertex has no edge left */
+  if (graph_slot_unused (graph, i))
+    graph_index_remove (graph, src, i);
 
-  free(temp);
-  temp = NULL;
+  if (graph->directed)
+  {
+    i = graph_get_vertex_by_id (graph, dest);
+    if (i == UNKNOW_VETEX)
+      return -1;
+
+    graph->inDegree[i]--;
+    if (graph_slot_unused (graph, i))
+      graph_index_remove (graph, dest, i);
+    return 0;
+  }
 
   /* Remove edge for dest->src */
   i = graph_get_vertex_by_id (graph, dest);
@@ -221,7 +721,6 @@ int graph_remove_edge(Graph* graph, int src, int dest)
 
   temp = graph->vertices[i];
   while (temp != NULL
-        && temp->id != dest
         && temp->edge.dest != src) {
     temp = temp->next;
   }
@@ -230,16 +729,15 @@ int graph_remove_edge(Graph* graph, int src, int dest)
     return -1;
   }
 
-  if (temp->prev != NULL)
-    temp->prev->next = temp->next;
-  else
-    graph->vertices[i] = temp->next;
+  graph_list_unlink (graph, i, temp);
+  vertex_release (graph, temp);
+  temp = NULL;
+  graph->numEdges--;
 
-  if (temp->next != NULL)
-    temp->next->prev = temp->prev;
+  if (graph->vertices[i] == NULL)
+    graph_index_remove (graph, dest, i);
 
-  free(temp);
-  temp = NULL;
+  return 0;
 }
 
 void graph_print(Graph* graph) 
@@ -261,678 +759,4163 @@ void graph_print(Graph* graph)
   }
 }
 
-void graph_deinit (Graph* graph) 
+/*
+ * Bytes held by the graph, split into the per-vertex arrays (slots and id
+ * index) and the slabs of adjacency nodes, free and untouched nodes
+ * included. malloc bookkeeping is not included.
+ */
+size_t graph_memory_usage (Graph* graph, size_t *vertex_bytes, size_t *edge_bytes)
 {
-  if (graph == NULL)
-  {
-    printf("[%s,%d] Error: Graph is NULL\n", __func__, __LINE__);
-    return;
-  }
+  GraphAllocStats stats;
+  size_t v_bytes = 0, e_bytes = 0;
 
-  for (int i = 0; i < graph->numVertices; i++) {
-    Vertex* current = graph->vertices[i];
-    Vertex* next = NULL;
-    while (current != NULL) {
-      next = current->next;
-      if (current)
-        free(current);
-      current = next;
-    }
+  if (graph_alloc_stats (graph, &stats) == 0)
+  {
+    v_bytes = sizeof (Graph)
+              + (size_t)graph->capacity * (2 * sizeof (Vertex *) + 2 * sizeof (int))
+              + (graph->directed ? (size_t)graph->capacity * sizeof (int) : 0)
+              + (size_t)graph->denseSize * sizeof (int)
+              + (size_t)graph->hashCapacity * 2 * sizeof (int);
+    e_bytes = stats.slabBytes;
   }
 
-  if (graph->vertices)
-    free(graph->vertices);
-  graph->vertices = NULL;
-
-  free(graph);
-  graph = NULL;
+  if (vertex_bytes) *vertex_bytes = v_bytes;
+  if (edge_bytes)   *edge_bytes   = e_bytes;
+  return v_bytes + e_bytes;
 }
 
-int graph_DFS (Graph* graph, int start_vertex)
+/* Every node of the slabs is in use, on the free list or still untouched */
+int graph_alloc_stats (Graph* graph, GraphAllocStats *stats)
 {
-  int *visited_vertices = NULL;
-  Stack *stack = NULL;
-  int *top, i;
+  VertexSlab *slab;
 
-  if (! graph)
+  if (! graph || ! stats)
+    return -1;
+
+  memset (stats, 0, sizeof (GraphAllocStats));
+  for (slab = graph->slabs; slab; slab = slab->next)
+  {
+    stats->numSlabs++;
+    stats->slabBytes      += sizeof (VertexSlab) + (size_t)slab->capacity * sizeof (Vertex);
+    stats->nodesCapacity  += slab->capacity;
+  }
+
+  stats->nodesInUse = graph->numEdges;
+  stats->nodesFree  = graph->numFreeNodes;
+  if (graph->slabs)
+    stats->nodesUntouched = graph->slabs->capacity - graph->slabs->used;
+  return 0;
+}
+
+void graph_alloc_stats_print (Graph* graph)
+{
+  GraphAllocStats stats;
+
+  if (graph_alloc_stats (graph, &stats) != 0)
+  {
+    printf ("[%s,%d] Error: Graph is NULL\n", __func__, __LINE__);
+    return;
+  }
+
+  printf ("Edge nodes: %llu in use, %llu free, %llu untouched, %llu slabs, %.1f MB\n",
+          (unsigned long long)stats.nodesInUse, (unsigned long long)stats.nodesFree,
+          (unsigned long long)stats.nodesUntouched, (unsigned long long)stats.numSlabs,
+          stats.slabBytes / (1024.0 * 1024.0));
+}
+
+void graph_deinit (Graph* graph) 
+{
+  if (graph == NULL)
+  {
+    printf("[%s,%d] Error: Graph is NULL\n", __func__, __LINE__);
+    return;
+  }
+
+  /* The nodes live in the slabs, the lists need no walk */
+  while (graph->slabs != NULL) {
+    VertexSlab* next = graph->slabs->next;
+    free(graph->slabs);
+    graph->slabs = next;
+  }
+
+  if (graph->vertices)
+    free(graph->vertices);
+  graph->vertices = NULL;
+
+  if (graph->tails)       free (graph->tails);
+  if (graph->inDegree)    free (graph->inDegree);
+
+  if (graph->slotIds)     free (graph->slotIds);
+  if (graph->freeSlots)   free (graph->freeSlots);
+  if (graph->denseIndex)  free (graph->denseIndex);
+  if (graph->hashKeys)    free (graph->hashKeys);
+  if (graph->hashSlots)   free (graph->hashSlots);
+
+  free(graph);
+  graph = NULL;
+}
+
+/*
+ * Compressed Sparse Row (CSR) snapshot of the graph
+ *    offsets[i] .. offsets[i + 1] - 1  : edges going out of slot i
+ *    dest[e], weight[e]                : destination slot and weight of edge e
+ *    ids[i]                            : vertex id stored in slot i
+ * Slot indices are the same as in graph->vertices, so the distance and
+ * prev_node arrays produced on a snapshot can be read against the Graph.
+ */
+GraphCSR* graph_csr_build (Graph* graph)
+{
+  GraphCSR *csr = NULL;
+  Vertex *temp = NULL;
+  int i, i_dest, capacity, *new_dest, *new_weight;
+
+  if (! graph || ! graph->numVertices || ! graph->vertices)
+    return NULL;
+
+  csr = (GraphCSR *)calloc(1, sizeof (GraphCSR));
+  if (! csr)
+  {
+    printf ("[%s,%d] Fail to allocate memory for CSR graph\n", __func__, __LINE__);
+    return NULL;
+  }
+
+  capacity          = graph->numVertices;
+  csr->numVertices  = graph->numVertices;
+  csr->directed     = graph->directed;
+  csr->ids          = (int *)malloc(csr->numVertices * sizeof (int));
+  csr->offsets      = (int *)malloc((csr->numVertices + 1) * sizeof (int));
+  csr->dest         = (int *)malloc(capacity * sizeof (int));
+  csr->weight       = (int *)malloc(capacity * sizeof (int));
+  if (! csr->ids || ! csr->offsets || ! csr->dest || ! csr->weight)
+  {
+    printf ("[%s,%d] Fail to allocate memory for CSR arrays\n", __func__, __LINE__);
+    goto ERR_EXIT;
+  }
+
+  /* Single pass over the adjacency lists, the edge arrays grow geometrically */
+  for (i = 0; i < graph->numVertices; ++i)
+  {
+    csr->offsets[i] = csr->numEdges;
+    csr->ids[i]     = graph->slotIds[i];
+
+    for (temp = graph->vertices[i]; temp; temp = temp->next)
+    {
+      i_dest = graph_get_vertex_by_id (graph, temp->edge.dest);
+      if (i_dest == UNKNOW_VETEX)
+        continue;
+
+      if (csr->numEdges == capacity)
+      {
+        capacity *= 2;
+        new_dest    = (int *)realloc(csr->dest, capacity * sizeof (int));
+        if (new_dest)
+          csr->dest = new_dest;
+        new_weight  = (int *)realloc(csr->weight, capacity * sizeof (int));
+        if (new_weight)
+          csr->weight = new_weight;
+        if (! new_dest || ! new_weight)
+        {
+          printf ("[%s,%d] Fail to grow CSR edge arrays\n", __func__, __LINE__);
+          goto ERR_EXIT;
+        }
+      }
+
+      csr->dest[csr->numEdges]    = i_dest;
+      csr->weight[csr->numEdges]  = temp->edge.weight;
+      csr->numEdges++;
+    }
+  }
+  csr->offsets[csr->numVertices] = csr->numEdges;
+
+  if (graph_csr_index_build (csr) != 0)
+    goto ERR_EXIT;
+
+  return csr;
+
+ERR_EXIT:
+  graph_csr_deinit (csr);
+  return NULL;
+}
+
+void graph_csr_deinit (GraphCSR* csr)
+{
+  if (! csr)
+    return;
+
+  if (csr->ids)     free (csr->ids);
+  if (csr->offsets) free (csr->offsets);
+  if (csr->dest)    free (csr->dest);
+  if (csr->weight)  free (csr->weight);
+  if (csr->reverse && csr->reverse != csr)
+    graph_csr_deinit (csr->reverse);
+  if (csr->denseIndex)  free (csr->denseIndex);
+  if (csr->hashKeys)    free (csr->hashKeys);
+  if (csr->hashSlots)   free (csr->hashSlots);
+  free (csr);
+  csr = NULL;
+}
+
+/*
+ * Vertex id -> slot index of a snapshot, same layout as the Graph index:
+ * compact ids go to the dense array, the others to an open addressing hash
+ * table whose empty cells hold UNKNOW_VETEX as slot. Slots without a vertex
+ * are left out, if an id appears twice its first slot wins. Return 0 on
+ * success, -1 on error.
+ */
+int graph_csr_index_build (GraphCSR* csr)
+{
+  unsigned int pos;
+  int i, id, max_id = -1, num_hashed = 0, capacity;
+
+  if (! csr || ! csr->ids)
+    return -1;
+
+  for (i = 0; i < csr->numVertices; ++i)
+  {
+    id = csr->ids[i];
+    if (id == UNKNOW_VETEX)
+      continue;
+    if (id >= 0 && id / GRAPH_DENSE_INDEX_FACTOR < csr->numVertices)
+      max_id = MAX(max_id, id);
+    else
+      num_hashed++;
+  }
+
+  csr->denseSize  = max_id + 1;
+  csr->denseIndex = (int *)malloc(MAX(csr->denseSize, 1) * sizeof (int));
+  if (! csr->denseIndex)
+    goto ERR_EXIT;
+  for (i = 0; i < csr->denseSize; ++i)
+    csr->denseIndex[i] = UNKNOW_VETEX;
+
+  if (num_hashed)
+  {
+    capacity = GRAPH_HASH_MIN_CAPACITY;
+    while (num_hashed * 2 > capacity)
+      capacity *= 2;
+
+    csr->hashKeys   = (int *)malloc(capacity * sizeof (int));
+    csr->hashSlots  = (int *)malloc(capacity * sizeof (int));
+    if (! csr->hashKeys || ! csr->hashSlots)
+      goto ERR_EXIT;
+    for (i = 0; i < capacity; ++i)
+      csr->hashSlots[i] = UNKNOW_VETEX;
+    csr->hashCapacity = capacity;
+  }
+
+  for (i = 0; i < csr->numVertices; ++i)
+  {
+    id = csr->ids[i];
+    if (id == UNKNOW_VETEX)
+      continue;
+
+    if (id >= 0 && id < csr->denseSize)
+    {
+      if (csr->denseIndex[id] == UNKNOW_VETEX)
+        csr->denseIndex[id] = i;
+      continue;
+    }
+
+    pos = graph_id_hash (id, csr->hashCapacity);
+    while (csr->hashSlots[pos] != UNKNOW_VETEX && csr->hashKeys[pos] != id)
+      pos = (pos + 1) & (csr->hashCapacity - 1);
+    if (csr->hashSlots[pos] == UNKNOW_VETEX)
+    {
+      csr->hashKeys[pos]  = id;
+      csr->hashSlots[pos] = i;
+    }
+  }
+
+  return 0;
+
+ERR_EXIT:
+  printf ("[%s,%d] Fail to allocate memory for CSR vertex index\n", __func__, __LINE__);
+  if (csr->denseIndex)  free (csr->denseIndex);
+  if (csr->hashKeys)    free (csr->hashKeys);
+  if (csr->hashSlots)   free (csr->hashSlots);
+  csr->denseIndex   = NULL;
+  csr->hashKeys     = NULL;
+  csr->hashSlots    = NULL;
+  csr->denseSize    = 0;
+  csr->hashCapacity = 0;
+  return -1;
+}
+
+int graph_csr_get_vertex_by_id (GraphCSR* csr, int id)
+{
+  unsigned int pos;
+
+  if (! csr || id == UNKNOW_VETEX)
+    return UNKNOW_VETEX;
+
+  if (id >= 0 && id < csr->denseSize)
+    return csr->denseIndex[id];
+
+  if (! csr->hashCapacity)
+    return UNKNOW_VETEX;
+
+  pos = graph_id_hash (id, csr->hashCapacity);
+  while (csr->hashSlots[pos] != UNKNOW_VETEX)
+  {
+    if (csr->hashKeys[pos] == id)
+      return csr->hashSlots[pos];
+    pos = (pos + 1) & (csr->hashCapacity - 1);
+  }
+
+  return UNKNOW_VETEX;
+}
+
+/* Reverse every edge of the snapshot, slots and ids stay the same */
+GraphCSR* graph_csr_transpose (GraphCSR* csr)
+{
+  GraphCSR *rcsr = NULL;
+  int i, e, pos;
+
+  if (! csr || ! csr->numVertices)
+    return NULL;
+
+  rcsr = (GraphCSR *)calloc(1, sizeof (GraphCSR));
+  if (! rcsr)
+  {
+    printf ("[%s,%d] Fail to allocate memory for CSR graph\n", __func__, __LINE__);
+    return NULL;
+  }
+
+  rcsr->numVertices = csr->numVertices;
+  rcsr->numEdges    = csr->numEdges;
+  rcsr->directed    = csr->directed;
+  rcsr->ids         = (int *)malloc(csr->numVertices * sizeof (int));
+  rcsr->offsets     = (int *)calloc(csr->numVertices + 1, sizeof (int));
+  rcsr->dest        = (int *)malloc((csr->numEdges ? csr->numEdges : 1) * sizeof (int));
+  rcsr->weight      = (int *)malloc((csr->numEdges ? csr->numEdges : 1) * sizeof (int));
+  if (! rcsr->ids || ! rcsr->offsets || ! rcsr->dest || ! rcsr->weight)
+  {
+    printf ("[%s,%d] Fail to allocate memory for CSR arrays\n", __func__, __LINE__);
+    graph_csr_deinit (rcsr);
+    return NULL;
+  }
+
+  memcpy (rcsr->ids, csr->ids, csr->numVertices * sizeof (int));
+
+  /* Count the in-degrees, prefix sum them, then scatter the edges */
+  for (e = 0; e < csr->numEdges; ++e)
+    rcsr->offsets[csr->dest[e] + 1]++;
+  for (i = 0; i < csr->numVertices; ++i)
+    rcsr->offsets[i + 1] += rcsr->offsets[i];
+
+  for (i = 0; i < csr->numVertices; ++i)
+  {
+    for (e = csr->offsets[i]; e < csr->offsets[i + 1]; ++e)
+    {
+      pos = rcsr->offsets[csr->dest[e]]++;
+      rcsr->dest[pos]   = i;
+      rcsr->weight[pos] = csr->weight[e];
+    }
+  }
+
+  /* The scatter moved every offset to the start of the next vertex */
+  for (i = csr->numVertices; i > 0; --i)
+    rcsr->offsets[i] = rcsr->offsets[i - 1];
+  rcsr->offsets[0] = 0;
+
+  if (graph_csr_index_build (rcsr) != 0)
+  {
+    graph_csr_deinit (rcsr);
+    return NULL;
+  }
+
+  return rcsr;
+}
+
+/*
+ * Incoming arcs of every slot. An undirected snapshot already holds both
+ * arcs of each edge and is its own reverse, a directed one gets its
+ * transpose built on the first call and kept until graph_csr_deinit.
+ * Not safe to call from several threads on the same snapshot.
+ */
+GraphCSR* graph_csr_reverse (GraphCSR* csr)
+{
+  if (! csr)
+    return NULL;
+
+  if (! csr->directed)
+    return csr;
+
+  if (! csr->reverse)
+    csr->reverse = graph_csr_transpose (csr);
+  return csr->reverse;
+}
+
+/*
+ * Parallel CSR construction from a raw edge array. Every worker counts the
+ * arcs of its share of the edges in a histogram of its own, a prefix sum
+ * over (vertex, worker) turns the histograms into the first write position
+ * of each worker inside every adjacency range, and the scatter then runs
+ * without atomics. The arcs of a vertex come out in input order whatever
+ * the number of workers.
+ */
+typedef struct CsrBuilder
+{
+  const GraphEdge *edges;
+  int numEdges;
+  int numVertices;
+  int flags;
+  int numWorkers;
+  int *hist;              /* hist[w * numVertices + v], arcs of worker w out of v */
+  int *blockSum;          /* per worker, arcs out of its vertex range */
+  int *degree;            /* arcs left per vertex after dedup */
+  int *error;             /* per worker */
+  GraphCSR *csr;
+  GraphCSR *out;          /* compacted copy when duplicates are dropped */
+} CsrBuilder;
+
+static void csr_builder_phase (WorkerPool *pool, WorkerTask task, CsrBuilder *cb)
+{
+  if (pool)
+    wpool_run (pool, task, cb);
+  else
+    task (0, 1, cb);
+}
+
+static void csr_count_task (int id, int num_workers, void *arg)
+{
+  CsrBuilder *cb = (CsrBuilder *)arg;
+  int *hist = cb->hist + (size_t)id * cb->numVertices;
+  const GraphEdge *edge;
+  int i, begin, end;
+
+  memset (hist, 0, cb->numVertices * sizeof (int));
+  wpool_range (id, num_workers, cb->numEdges, &begin, &end);
+  for (i = begin; i < end; ++i)
+  {
+    edge = &cb->edges[i];
+    if (edge->src < 0 || edge->src >= cb->numVertices
+        || edge->dest < 0 || edge->dest >= cb->numVertices)
+    {
+      cb->error[id] = 1;
+      return;
+    }
+
+    if (edge->src == edge->dest)
+      continue;
+
+    hist[edge->src]++;
+    if (! (cb->flags & GRAPH_CSR_DIRECTED))
+      hist[edge->dest]++;
+  }
+}
+
+/* Exclusive scan over the workers of each vertex, leaves the sum of the vertex range */
+static void csr_scan_task (int id, int num_workers, void *arg)
+{
+  CsrBuilder *cb = (CsrBuilder *)arg;
+  int v, w, begin, end, count, total = 0;
+  size_t pos;
+
+  wpool_range (id, num_workers, cb->numVertices, &begin, &end);
+  for (v = begin; v < end; ++v)
+  {
+    for (w = 0, pos = v; w < cb->numWorkers; ++w, pos += cb->numVertices)
+    {
+      count         = cb->hist[pos];
+      cb->hist[pos] = total;
+      total        += count;
+    }
+    cb->csr->offsets[v + 1] = total;
+  }
+  cb->blockSum[id] = total;
+}
+
+/* Add the base of the vertex range, offsets[v + 1] turns from a running sum into an offset */
+static void csr_offset_task (int id, int num_workers, void *arg)
+{
+  CsrBuilder *cb = (CsrBuilder *)arg;
+  int v, w, begin, end, base = 0;
+  size_t pos;
+
+  for (w = 0; w < id; ++w)
+    base += cb->blockSum[w];
+
+  wpool_range (id, num_workers, cb->numVertices, &begin, &end);
+  for (v = begin; v < end; ++v)
+  {
+    for (w = 0, pos = v; w < cb->numWorkers; ++w, pos += cb->numVertices)
+      cb->hist[pos] += base;
+    cb->csr->offsets[v + 1] += base;
+  }
+}
+
+static void csr_scatter_task (int id, int num_workers, void *arg)
+{
+  CsrBuilder *cb = (CsrBuilder *)arg;
+  int *hist = cb->hist + (size_t)id * cb->numVertices;
+  const GraphEdge *edge;
+  int i, pos, begin, end;
+
+  wpool_range (id, num_workers, cb->numEdges, &begin, &end);
+  for (i = begin; i < end; ++i)
+  {
+    edge = &cb->edges[i];
+    if (edge->src == edge->dest)
+      continue;
+
+    pos                   = hist[edge->src]++;
+    cb->csr->dest[pos]    = edge->dest;
+    cb->csr->weight[pos]  = edge->weight;
+    if (cb->flags & GRAPH_CSR_DIRECTED)
+      continue;
+
+    pos                   = hist[edge->dest]++;
+    cb->csr->dest[pos]    = edge->src;
+    cb->csr->weight[pos]  = edge->weight;
+  }
+}
+
+static int csr_key_cmp (const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+/*
+ * Sort every adjacency range of the worker by (dest, weight). The key
+ * packs dest over the weight with its sign bit flipped, so a plain
+ * unsigned order puts the lightest of parallel arcs first, which is the
+ * one kept by dedup.
+ */
+static void csr_sort_task (int id, int num_workers, void *arg)
+{
+  CsrBuilder *cb = (CsrBuilder *)arg;
+  GraphCSR *csr = cb->csr;
+  uint64_t *keys = NULL, key;
+  int v, e, j, begin, end, first, deg, max_deg = 0, kept;
+
+  wpool_range (id, num_workers, csr->numVertices, &begin, &end);
+  for (v = begin; v < end; ++v)
+    max_deg = MAX(max_deg, csr->offsets[v + 1] - csr->offsets[v]);
+
+  keys = (uint64_t *)malloc(MAX(max_deg, 1) * sizeof (uint64_t));
+  if (! keys)
+  {
+    cb->error[id] = 1;
+    return;
+  }
+
+  for (v = begin; v < end; ++v)
+  {
+    first = csr->offsets[v];
+    deg   = csr->offsets[v + 1] - first;
+    for (e = 0; e < deg; ++e)
+      keys[e] = ((uint64_t)(uint32_t)csr->dest[first + e] << 32)
+                | ((uint32_t)csr->weight[first + e] ^ 0x80000000u);
+
+    if (deg > 16)
+      qsort (keys, deg, sizeof (uint64_t), csr_key_cmp);
+    else
+    {
+      for (e = 1; e < deg; ++e)
+      {
+        key = keys[e];
+        for (j = e; j > 0 && keys[j - 1] > key; --j)
+          keys[j] = keys[j - 1];
+        keys[j] = key;
+      }
+    }
+
+    /* Unpack, keeping only the first arc to each dest when dedup is on */
+    kept = 0;
+    for (e = 0; e < deg; ++e)
+    {
+      if ((cb->flags & GRAPH_CSR_DEDUP) && kept
+          && csr->dest[first + kept - 1] == (int)(keys[e] >> 32))
+        continue;
+
+      csr->dest[first + kept]   = (int)(keys[e] >> 32);
+      csr->weight[first + kept] = (int)((uint32_t)keys[e] ^ 0x80000000u);
+      kept++;
+    }
+    cb->degree[v] = kept;
+  }
+
+  free (keys);
+}
+
+/* Same two pass scan as the build, on the degrees left after dedup */
+static void csr_dedup_scan_task (int id, int num_workers, void *arg)
+{
+  CsrBuilder *cb = (CsrBuilder *)arg;
+  int v, begin, end, total = 0;
+
+  wpool_range (id, num_workers, cb->numVertices, &begin, &end);
+  for (v = begin; v < end; ++v)
+  {
+    total += cb->degree[v];
+    cb->out->offsets[v + 1] = total;
+  }
+  cb->blockSum[id] = total;
+}
+
+static void csr_dedup_move_task (int id, int num_workers, void *arg)
+{
+  CsrBuilder *cb = (CsrBuilder *)arg;
+  int v, w, begin, end, from, to, base = 0;
+
+  for (w = 0; w < id; ++w)
+    base += cb->blockSum[w];
+
+  wpool_range (id, num_workers, cb->numVertices, &begin, &end);
+  for (v = begin; v < end; ++v)
+  {
+    cb->out->offsets[v + 1] += base;
+    to    = cb->out->offsets[v + 1] - cb->degree[v];
+    from  = cb->csr->offsets[v];
+    memcpy (cb->out->dest + to, cb->csr->dest + from, cb->degree[v] * sizeof (int));
+    memcpy (cb->out->weight + to, cb->csr->weight + from, cb->degree[v] * sizeof (int));
+  }
+}
+
+static GraphCSR* csr_alloc (int num_vertices, int num_edges)
+{
+  GraphCSR *csr;
+
+  csr = (GraphCSR *)calloc(1, sizeof (GraphCSR));
+  if (! csr)
+    return NULL;
+
+  csr->numVertices  = num_vertices;
+  csr->numEdges     = num_edges;
+  csr->ids          = (int *)malloc(num_vertices * sizeof (int));
+  csr->offsets      = (int *)malloc((num_vertices + 1) * sizeof (int));
+  csr->dest         = (int *)malloc(MAX(num_edges, 1) * sizeof (int));
+  csr->weight       = (int *)malloc(MAX(num_edges, 1) * sizeof (int));
+  if (! csr->ids || ! csr->offsets || ! csr->dest || ! csr->weight)
+  {
+    graph_csr_deinit (csr);
+    return NULL;
+  }
+
+  csr->offsets[0] = 0;
+  return csr;
+}
+
+static int csr_builder_failed (CsrBuilder *cb)
+{
+  int w;
+
+  for (w = 0; w < cb->numWorkers; ++w)
+    if (cb->error[w])
+      return 1;
+  return 0;
+}
+
+/*
+ * Build the CSR of num_edges edges between the vertices 0 .. num_vertices - 1,
+ * vertex v lands in slot v and ids[v] = v. Each edge gives one arc each way
+ * like graph_add_edge, only src -> dest with GRAPH_CSR_DIRECTED, self loops
+ * are dropped.
+ * GRAPH_CSR_SORTED orders every adjacency range by dest, GRAPH_CSR_DEDUP
+ * also keeps only the lightest of parallel arcs. The histograms take
+ * num_workers * num_vertices ints on top of the CSR. pool may be NULL.
+ */
+GraphCSR* graph_csr_from_edges (const GraphEdge *edges, int num_edges, int num_vertices,
+                                int flags, struct WorkerPool *pool)
+{
+  CsrBuilder cb;
+  GraphCSR *csr = NULL;
+  int v, num_arcs;
+
+  if ((num_edges && ! edges) || num_edges < 0 || num_edges > INT_MAX / 2 || num_vertices <= 0)
+    return NULL;
+
+  memset (&cb, 0, sizeof (cb));
+  cb.edges        = edges;
+  cb.numEdges     = num_edges;
+  cb.numVertices  = num_vertices;
+  cb.flags        = (flags & GRAPH_CSR_DEDUP) ? flags | GRAPH_CSR_SORTED : flags;
+  cb.numWorkers   = (pool) ? pool->numWorkers : 1;
+  cb.hist         = (int *)malloc((size_t)cb.numWorkers * num_vertices * sizeof (int));
+  cb.blockSum     = (int *)calloc(cb.numWorkers, sizeof (int));
+  cb.error        = (int *)calloc(cb.numWorkers, sizeof (int));
+  cb.csr          = csr_alloc (num_vertices, 0);
+  if (! cb.hist || ! cb.blockSum || ! cb.error || ! cb.csr)
+  {
+    printf ("[%s,%d] Fail to allocate memory for CSR builder\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  csr_builder_phase (pool, csr_count_task, &cb);
+  if (csr_builder_failed (&cb))
+  {
+    printf ("[%s,%d] Error: Edge endpoint out of 0 .. %d\n", __func__, __LINE__, num_vertices - 1);
+    goto EXIT;
+  }
+
+  csr_builder_phase (pool, csr_scan_task, &cb);
+  csr_builder_phase (pool, csr_offset_task, &cb);
+
+  num_arcs = cb.csr->offsets[num_vertices];
+  free (cb.csr->dest);
+  free (cb.csr->weight);
+  cb.csr->numEdges  = num_arcs;
+  cb.csr->dest      = (int *)malloc(MAX(num_arcs, 1) * sizeof (int));
+  cb.csr->weight    = (int *)malloc(MAX(num_arcs, 1) * sizeof (int));
+  if (! cb.csr->dest || ! cb.csr->weight)
+  {
+    printf ("[%s,%d] Fail to allocate memory for CSR arrays\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  for (v = 0; v < num_vertices; ++v)
+    cb.csr->ids[v] = v;
+  csr_builder_phase (pool, csr_scatter_task, &cb);
+
+  if (cb.flags & GRAPH_CSR_SORTED)
+  {
+    cb.degree = (int *)malloc(num_vertices * sizeof (int));
+    if (! cb.degree)
+    {
+      printf ("[%s,%d] Fail to allocate memory for CSR degrees\n", __func__, __LINE__);
+      goto EXIT;
+    }
+
+    csr_builder_phase (pool, csr_sort_task, &cb);
+    if (csr_builder_failed (&cb))
+    {
+      printf ("[%s,%d] Fail to allocate memory for adjacency sort\n", __func__, __LINE__);
+      goto EXIT;
+    }
+  }
+
+  if (cb.flags & GRAPH_CSR_DEDUP)
+  {
+    /* The histograms are done with, the degrees decide the size of the copy */
+    free (cb.hist);
+    cb.hist = NULL;
+
+    num_arcs = 0;
+    for (v = 0; v < num_vertices; ++v)
+      num_arcs += cb.degree[v];
+
+    cb.out = csr_alloc (num_vertices, num_arcs);
+    if (! cb.out)
+    {
+      printf ("[%s,%d] Fail to allocate memory for CSR arrays\n", __func__, __LINE__);
+      goto EXIT;
+    }
+    memcpy (cb.out->ids, cb.csr->ids, num_vertices * sizeof (int));
+
+    csr_builder_phase (pool, csr_dedup_scan_task, &cb);
+    csr_builder_phase (pool, csr_dedup_move_task, &cb);
+    graph_csr_deinit (cb.csr);
+    cb.csr  = cb.out;
+    cb.out  = NULL;
+  }
+
+  if (graph_csr_index_build (cb.csr) != 0)
+    goto EXIT;
+
+  csr           = cb.csr;
+  csr->directed = (flags & GRAPH_CSR_DIRECTED) ? 1 : 0;
+  cb.csr        = NULL;
+
+EXIT:
+  if (cb.hist)      free (cb.hist);
+  if (cb.blockSum)  free (cb.blockSum);
+  if (cb.degree)    free (cb.degree);
+  if (cb.error)     free (cb.error);
+  graph_csr_deinit (cb.csr);
+  graph_csr_deinit (cb.out);
+  return csr;
+}
+
+/*
+ * Iterative DFS over CSR slots. The stack is one array of (vertex, next arc)
+ * frames, so the depth of the graph costs neither call stack nor a malloc
+ * per push. Every dfs_search_next reports one event, the caller drives the
+ * search and keeps whatever state its algorithm needs around the events.
+ */
+int dfs_search_init (DfsSearch *search, GraphCSR *csr)
+{
+  int i;
+
+  if (! search || ! csr)
+    return -1;
+
+  search->csr         = csr;
+  search->depth       = 0;
+  search->numVisited  = 0;
+  search->rootPending = 0;
+  search->u           = UNKNOW_VETEX;
+  search->v           = UNKNOW_VETEX;
+  search->edge        = -1;
+  search->stack       = (DfsFrame *)malloc(csr->numVertices * sizeof (DfsFrame));
+  search->order       = (int *)malloc(csr->numVertices * sizeof (int));
+  if (! search->stack || ! search->order)
+  {
+    printf ("[%s,%d] Fail to allocate memory for DFS\n", __func__, __LINE__);
+    dfs_search_deinit (search);
+    return -1;
+  }
+
+  for (i = 0; i < csr->numVertices; ++i)
+    search->order[i] = -1;
+
+  return 0;
+}
+
+void dfs_search_deinit (DfsSearch *search)
+{
+  if (! search)
+    return;
+
+  if (search->stack)  free (search->stack);
+  if (search->order)  free (search->order);
+  search->stack = NULL;
+  search->order = NULL;
+}
+
+/* Start a new tree from slot i_root, -1 if it was already visited */
+int dfs_search_root (DfsSearch *search, int i_root)
+{
+  if (search->depth || search->order[i_root] != -1)
+    return -1;
+
+  search->order[i_root]   = search->numVisited++;
+  search->stack[0].vertex = i_root;
+  search->stack[0].cursor = search->csr->offsets[i_root];
+  search->depth           = 1;
+  search->rootPending     = 1;
+  return 0;
+}
+
+/*
+ * Advance the search by one event:
+ *    DFS_DISCOVER : v entered the tree through arc edge out of u, u is
+ *                   UNKNOW_VETEX and edge -1 for a root
+ *    DFS_NONTREE  : arc edge u -> v reached the already visited v
+ *    DFS_FINISH   : every arc out of v is done, u is its tree parent
+ *    DFS_DONE     : the tree is complete, call dfs_search_root again
+ */
+DfsEvent dfs_search_next (DfsSearch *search)
+{
+  GraphCSR *csr = search->csr;
+  DfsFrame *top;
+  int v;
+
+  if (search->rootPending)
+  {
+    search->rootPending = 0;
+    search->u           = UNKNOW_VETEX;
+    search->v           = search->stack[0].vertex;
+    search->edge        = -1;
+    return DFS_DISCOVER;
+  }
+
+  if (! search->depth)
+    return DFS_DONE;
+
+  top = &search->stack[search->depth - 1];
+  if (top->cursor < csr->offsets[top->vertex + 1])
+  {
+    search->edge  = top->cursor++;
+    search->u     = top->vertex;
+    v = search->v = csr->dest[search->edge];
+    if (search->order[v] != -1)
+      return DFS_NONTREE;
+
+    search->order[v] = search->numVisited++;
+    top++;
+    top->vertex = v;
+    top->cursor = csr->offsets[v];
+    search->depth++;
+    return DFS_DISCOVER;
+  }
+
+  search->v = top->vertex;
+  search->depth--;
+  search->u = (search->depth) ? search->stack[search->depth - 1].vertex : UNKNOW_VETEX;
+  return DFS_FINISH;
+}
+
+int graph_csr_DFS (GraphCSR* csr, int start_vertex)
+{
+  DfsSearch search;
+  DfsEvent event;
+  int i_start;
+
+  if (! csr)
+  {
+    printf ("[%s,%d] Error, Graph is NULL\n", __func__, __LINE__);
+    return -1;
+  }
+
+  i_start = graph_csr_get_vertex_by_id (csr, start_vertex);
+  if (i_start == UNKNOW_VETEX)
+  {
+    printf ("[%s,%d] Start vertex %d is not in the graph\n", __func__, __LINE__, start_vertex);
+    return -1;
+  }
+
+  if (dfs_search_init (&search, csr) != 0)
+    return -1;
+
+  dfs_search_root (&search, i_start);
+  printf ("Visited ");
+  while ((event = dfs_search_next (&search)) != DFS_DONE)
+  {
+    if (event == DFS_DISCOVER)
+      printf (" -> %d", csr->ids[search.v]);
+  }
+
+  printf ("\n");
+
+  /* Clean up */
+  dfs_search_deinit (&search);
+  return 0;
+}
+
+int graph_DFS (Graph* graph, int start_vertex)
+{
+  GraphCSR *csr = NULL;
+  int rv;
+
+  csr = graph_csr_build (graph);
+  if (! csr)
+  {
+    printf ("[%s,%d] Error, Fail to build CSR snapshot\n", __func__, __LINE__);
+    return -1;
+  }
+
+  rv = graph_csr_DFS (csr, start_vertex);
+  graph_csr_deinit (csr);
+  return rv;
+}
+
+/*
+ * Tarjan's strongly connected components. component[v] receives the index
+ * of the component of slot v, components come out in reverse topological
+ * order of the condensation. Return the number of components, -1 on error.
+ */
+int tarjan_scc (GraphCSR *csr, int *component)
+{
+  DfsSearch search;
+  DfsEvent event;
+  int *low = NULL, *scc_stack = NULL, i, v, top = 0, num_scc = 0, rv = -1;
+
+  if (! csr || ! component)
+    return -1;
+
+  if (dfs_search_init (&search, csr) != 0)
+    return -1;
+
+  low       = (int *)malloc(csr->numVertices * sizeof (int));
+  scc_stack = (int *)malloc(csr->numVertices * sizeof (int));
+  if (! low || ! scc_stack)
+  {
+    printf ("[%s,%d] Fail to allocate memory for SCC\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  /* component[v] stays -1 while v is on the SCC stack */
+  for (i = 0; i < csr->numVertices; ++i)
+    component[i] = -1;
+
+  for (i = 0; i < csr->numVertices; ++i)
+  {
+    if (dfs_search_root (&search, i) != 0)
+      continue;
+
+    while ((event = dfs_search_next (&search)) != DFS_DONE)
+    {
+      switch (event)
+      {
+        case DFS_DISCOVER:
+          low[search.v]       = search.order[search.v];
+          scc_stack[top++]    = search.v;
+          break;
+
+        case DFS_NONTREE:
+          if (component[search.v] == -1)
+            low[search.u] = MIN(low[search.u], search.order[search.v]);
+          break;
+
+        case DFS_FINISH:
+          if (low[search.v] == search.order[search.v])
+          {
+            do
+            {
+              v = scc_stack[--top];
+              component[v] = num_scc;
+            } while (v != search.v);
+            num_scc++;
+          }
+          if (search.u != UNKNOW_VETEX)
+            low[search.u] = MIN(low[search.u], low[search.v]);
+          break;
+
+        default:
+          break;
+      }
+    }
+  }
+  rv = num_scc;
+
+EXIT:
+  if (low)        free (low);
+  if (scc_stack)  free (scc_stack);
+  dfs_search_deinit (&search);
+  return rv;
+}
+
+/*
+ * Reverse DFS postorder, order receives every slot so that each arc goes
+ * from an earlier to a later entry. Return 0 on success, -1 on error or if
+ * the graph has a cycle.
+ */
+int topological_sort (GraphCSR *csr, int *order)
+{
+  DfsSearch search;
+  DfsEvent event;
+  char *finished = NULL;
+  int i, pos = csr ? csr->numVertices : 0, rv = -1;
+
+  if (! csr || ! order)
+    return -1;
+
+  if (dfs_search_init (&search, csr) != 0)
+    return -1;
+
+  finished = (char *)calloc(csr->numVertices, sizeof (char));
+  if (! finished)
+  {
+    printf ("[%s,%d] Fail to allocate memory for topological sort\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  for (i = 0; i < csr->numVertices; ++i)
+  {
+    if (dfs_search_root (&search, i) != 0)
+      continue;
+
+    while ((event = dfs_search_next (&search)) != DFS_DONE)
+    {
+      /* An arc back to a vertex still on the stack closes a cycle */
+      if (event == DFS_NONTREE && ! finished[search.v])
+      {
+        printf ("[%s,%d] Graph has a cycle through %d, no topological order\n",
+                __func__, __LINE__, csr->ids[search.v]);
+        goto EXIT;
+      }
+
+      if (event == DFS_FINISH)
+      {
+        finished[search.v] = 1;
+        order[--pos]       = search.v;
+      }
+    }
+  }
+  rv = 0;
+
+EXIT:
+  if (finished)
+    free (finished);
+  dfs_search_deinit (&search);
+  return rv;
+}
+
+/*
+ * Articulation points and bridges of an undirected graph, both arcs of an
+ * edge are in the CSR. is_cut[v] is set to 1 if removing slot v disconnects
+ * its component, is_bridge[e], when not NULL, to 1 for both arcs of every
+ * edge whose removal does. Return the number of articulation points, -1 on
+ * error.
+ */
+int articulation_points (GraphCSR *csr, char *is_cut, char *is_bridge)
+{
+  DfsSearch search;
+  DfsEvent event;
+  int *low = NULL, *parent = NULL, *children = NULL;
+  char *skipped = NULL;
+  int i, e, u, v, num_cut = 0, rv = -1;
+
+  if (! csr || ! is_cut)
+    return -1;
+
+  if (csr->directed)
+  {
+    printf ("[%s,%d] Articulation points need an undirected graph\n", __func__, __LINE__);
+    return -1;
+  }
+
+  if (dfs_search_init (&search, csr) != 0)
+    return -1;
+
+  low       = (int *)malloc(csr->numVertices * sizeof (int));
+  parent    = (int *)malloc(csr->numVertices * sizeof (int));
+  children  = (int *)calloc(csr->numVertices, sizeof (int));
+  skipped   = (char *)calloc(csr->numVertices, sizeof (char));
+  if (! low || ! parent || ! children || ! skipped)
+  {
+    printf ("[%s,%d] Fail to allocate memory for articulation points\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  memset (is_cut, 0, csr->numVertices * sizeof (char));
+  if (is_bridge)
+    memset (is_bridge, 0, csr->numEdges * sizeof (char));
+
+  for (i = 0; i < csr->numVertices; ++i)
+  {
+    if (dfs_search_root (&search, i) != 0)
+      continue;
+
+    while ((event = dfs_search_next (&search)) != DFS_DONE)
+    {
+      u = search.u;
+      v = search.v;
+      switch (event)
+      {
+        case DFS_DISCOVER:
+          low[v]    = search.order[v];
+          parent[v] = u;
+          if (u != UNKNOW_VETEX)
+            children[u]++;
+          break;
+
+        case DFS_NONTREE:
+          /* The way back to the parent is the tree edge itself, a parallel edge is not */
+          if (v == parent[u] && ! skipped[u])
+            skipped[u] = 1;
+          else
+            low[u] = MIN(low[u], search.order[v]);
+          break;
+
+        case DFS_FINISH:
+          if (u == UNKNOW_VETEX)
+          {
+            if (children[v] > 1)
+              is_cut[v] = 1;
+            break;
+          }
+
+          low[u] = MIN(low[u], low[v]);
+          if (parent[u] != UNKNOW_VETEX && low[v] >= search.order[u])
+            is_cut[u] = 1;
+
+          if (is_bridge && low[v] > search.order[u])
+          {
+            /* No parallel edge to u, so exactly one arc of each side */
+            for (e = csr->offsets[u]; e < csr->offsets[u + 1]; ++e)
+              if (csr->dest[e] == v)
+                is_bridge[e] = 1;
+            for (e = csr->offsets[v]; e < csr->offsets[v + 1]; ++e)
+              if (csr->dest[e] == u)
+                is_bridge[e] = 1;
+          }
+          break;
+
+        default:
+          break;
+      }
+    }
+  }
+
+  for (i = 0; i < csr->numVertices; ++i)
+    num_cut += is_cut[i];
+  rv = num_cut;
+
+EXIT:
+  if (low)      free (low);
+  if (parent)   free (parent);
+  if (children) free (children);
+  if (skipped)  free (skipped);
+  dfs_search_deinit (&search);
+  return rv;
+}
+
+int graph_csr_BFS (GraphCSR* csr, int start_vertex)
+{
+  int *visited_vertices = NULL;
+  Queue *queue = NULL;
+  int *front, i_start, e;
+
+  if (! csr)
+  {
+    printf ("[%s,%d] Error, Graph is NULL\n", __func__, __LINE__);
+    return -1;
+  }
+
+  i_start = graph_csr_get_vertex_by_id (csr, start_vertex);
+  if (i_start == UNKNOW_VETEX)
+  {
+    printf ("[%s,%d] Start vertex %d is not in the graph\n", __func__, __LINE__, start_vertex);
+    return -1;
+  }
+
+  visited_vertices = (int *)calloc(csr->numVertices, sizeof(int));
+  if (! visited_vertices)
+  {
+    printf ("[%s,%d] Error: Fail to allocate memory for visited array\n", __func__, __LINE__);
+    return -1;
+  }
+
+  queue = queue_create (csr->numVertices);
+  if (! queue)
+  {
+    printf ("[%s,%d] Error: Fail to allocate memory for queue\n", __func__, __LINE__);
+    free (visited_vertices);
+    return -1;
+  }
+
+  /* Push the first vertex into the queue */
+  queue_enqueue (queue, &i_start);
+  visited_vertices[i_start] = 1;
+  printf ("Visited ");
+
+  while (! queue_is_empty (queue))
+  {
+    /* Pop the front of the queue */
+    queue_dequeue (queue, (void **)&front);
+    if (front)
+    {
+      printf (" -> %d", csr->ids[*front]);
+
+      /* Push unvisited adjacencies into the queue */
+      for (e = csr->offsets[*front]; e < csr->offsets[*front + 1]; ++e)
+      {
+        if (visited_vertices[csr->dest[e]] == 0)
+        {
+          visited_vertices[csr->dest[e]] = 1;
+          queue_enqueue (queue, &csr->dest[e]);
+        }
+      }
+    }
+  }
+
+  printf ("\n");
+
+  /* Clean up */
+  queue_delete (queue);
+  free (visited_vertices);
+  return 0;
+}
+
+int graph_BFS (Graph* graph, int start_vertex)
+{
+  GraphCSR *csr = NULL;
+  int rv;
+
+  csr = graph_csr_build (graph);
+  if (! csr)
+  {
+    printf ("[%s,%d] Error, Fail to build CSR snapshot\n", __func__, __LINE__);
+    return -1;
+  }
+
+  rv = graph_csr_BFS (csr, start_vertex);
+  graph_csr_deinit (csr);
+  return rv;
+}
+
+/*
+ * Direction-optimizing BFS switches to bottom-up steps once the arcs out of
+ * the frontier pass 1 / BFS_ALPHA of the arcs still unexplored, and back to
+ * top-down once the frontier falls under 1 / BFS_BETA of the vertices.
+ */
+#define BFS_ALPHA   14
+#define BFS_BETA    24
+
+#define BFS_BIT_TEST(map, i)  (((map)[(i) >> 6] >> ((i) & 63)) & 1)
+#define BFS_BIT_SET(map, i)   ((map)[(i) >> 6] |= (uint64_t)1 << ((i) & 63))
+
+typedef struct BfsSearch
+{
+  GraphCSR *csr;
+  GraphCSR *rcsr;         /* incoming arcs for the bottom-up steps */
+  int *parent;
+  int *depth;
+  uint64_t *visited;
+  int numWords;
+  int level;
+} BfsSearch;
+
+/* Expand every vertex of the frontier queue, return the size of the next one */
+static int bfs_top_down (BfsSearch *bs, int *frontier, int num_front, int *next, int64_t *next_arcs)
+{
+  GraphCSR *csr = bs->csr;
+  int i, u, v, e, num_next = 0;
+
+  *next_arcs = 0;
+  for (i = 0; i < num_front; ++i)
+  {
+    u = frontier[i];
+    for (e = csr->offsets[u]; e < csr->offsets[u + 1]; ++e)
+    {
+      v = csr->dest[e];
+      if (BFS_BIT_TEST(bs->visited, v))
+        continue;
+
+      BFS_BIT_SET(bs->visited, v);
+      bs->parent[v] = u;
+      bs->depth[v]  = bs->level;
+      next[num_next++] = v;
+      *next_arcs += csr->offsets[v + 1] - csr->offsets[v];
+    }
+  }
+
+  return num_next;
+}
+
+/* Every unvisited vertex looks for a parent in the frontier bitmap */
+static int bfs_bottom_up (BfsSearch *bs, uint64_t *front, uint64_t *next, int64_t *next_arcs)
+{
+  GraphCSR *csr = bs->csr, *rcsr = bs->rcsr;
+  int w, v, e, end, num_next = 0;
+
+  *next_arcs = 0;
+  memset (next, 0, bs->numWords * sizeof (uint64_t));
+  for (w = 0; w < bs->numWords; ++w)
+  {
+    if (bs->visited[w] == UINT64_MAX)
+      continue;
+
+    end = MIN((w + 1) * 64, csr->numVertices);
+    for (v = w * 64; v < end; ++v)
+    {
+      if (BFS_BIT_TEST(bs->visited, v))
+        continue;
+
+      for (e = rcsr->offsets[v]; e < rcsr->offsets[v + 1]; ++e)
+      {
+        if (! BFS_BIT_TEST(front, rcsr->dest[e]))
+          continue;
+
+        bs->parent[v] = rcsr->dest[e];
+        bs->depth[v]  = bs->level;
+        BFS_BIT_SET(next, v);
+        num_next++;
+        *next_arcs += csr->offsets[v + 1] - csr->offsets[v];
+        break;
+      }
+    }
+  }
+
+  /* Mark the new level visited only now, so it can not parent itself */
+  for (w = 0; w < bs->numWords; ++w)
+    bs->visited[w] |= next[w];
+
+  return num_next;
+}
+
+/*
+ * BFS tree from vertex id src over CSR slots: parent[v] is the slot v was
+ * reached from, UNKNOW_VETEX for src and unreachable vertices, depth[v] the
+ * number of hops from src, -1 if unreachable. rcsr holds the incoming arcs
+ * for the bottom-up steps, NULL takes graph_csr_reverse of csr, which is csr
+ * itself for an undirected graph. Return the number of vertices reached, -1
+ * on error.
+ */
+int bfs_mode (GraphCSR *csr, GraphCSR *rcsr, int src, BfsMode mode, int *parent, int *depth)
+{
+  BfsSearch bs;
+  int *frontier = NULL, *next = NULL, *temp;
+  uint64_t *front_map = NULL, *next_map = NULL, *temp_map;
+  int64_t front_arcs, unexplored_arcs;
+  int i, i_src, num_front, reached, top_down = 1, rv = -1;
+
+  if (! csr || ! csr->numVertices || ! parent || ! depth)
+    return -1;
+
+  i_src = graph_csr_get_vertex_by_id (csr, src);
+  if (i_src == UNKNOW_VETEX)
+  {
+    printf ("[%s,%d] Start vertex %d is not in the graph\n", __func__, __LINE__, src);
+    return -1;
+  }
+
+  if (! rcsr && mode == BFS_DIRECTION_OPTIMIZING)
+  {
+    rcsr = graph_csr_reverse (csr);
+    if (! rcsr)
+      return -1;
+  }
+
+  bs.csr      = csr;
+  bs.rcsr     = rcsr ? rcsr : csr;
+  bs.parent   = parent;
+  bs.depth    = depth;
+  bs.numWords = (csr->numVertices + 63) / 64;
+  bs.level    = 0;
+  bs.visited  = (uint64_t *)calloc(bs.numWords, sizeof (uint64_t));
+  frontier    = (int *)malloc(csr->numVertices * sizeof (int));
+  next        = (int *)malloc(csr->numVertices * sizeof (int));
+  front_map   = (uint64_t *)calloc(bs.numWords, sizeof (uint64_t));
+  next_map    = (uint64_t *)calloc(bs.numWords, sizeof (uint64_t));
+  if (! bs.visited || ! frontier || ! next || ! front_map || ! next_map)
+  {
+    printf ("[%s,%d] Fail to allocate memory for BFS\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  for (i = 0; i < csr->numVertices; ++i)
+  {
+    parent[i] = UNKNOW_VETEX;
+    depth[i]  = -1;
+  }
+
+  BFS_BIT_SET(bs.visited, i_src);
+  depth[i_src]    = 0;
+  frontier[0]     = i_src;
+  num_front       = 1;
+  reached         = 1;
+  front_arcs      = csr->offsets[i_src + 1] - csr->offsets[i_src];
+  unexplored_arcs = csr->numEdges - front_arcs;
+
+  while (num_front > 0)
+  {
+    if (mode == BFS_DIRECTION_OPTIMIZING)
+    {
+      if (top_down && front_arcs > unexplored_arcs / BFS_ALPHA)
+      {
+        memset (front_map, 0, bs.numWords * sizeof (uint64_t));
+        for (i = 0; i < num_front; ++i)
+          BFS_BIT_SET(front_map, frontier[i]);
+        top_down = 0;
+      }
+      else if (! top_down && num_front < csr->numVertices / BFS_BETA)
+      {
+        num_front = 0;
+        for (i = 0; i < csr->numVertices; ++i)
+          if (BFS_BIT_TEST(front_map, i))
+            frontier[num_front++] = i;
+        top_down = 1;
+      }
+    }
+
+    bs.level++;
+    if (top_down)
+    {
+      num_front = bfs_top_down (&bs, frontier, num_front, next, &front_arcs);
+      temp      = frontier;
+      frontier  = next;
+      next      = temp;
+    }
+    else
+    {
+      num_front = bfs_bottom_up (&bs, front_map, next_map, &front_arcs);
+      temp_map  = front_map;
+      front_map = next_map;
+      next_map  = temp_map;
+    }
+
+    reached         += num_front;
+    unexplored_arcs -= front_arcs;
+  }
+  rv = reached;
+
+EXIT:
+  if (bs.visited)   free (bs.visited);
+  if (frontier)     free (frontier);
+  if (next)         free (next);
+  if (front_map)    free (front_map);
+  if (next_map)     free (next_map);
+  return rv;
+}
+
+int bfs (GraphCSR *csr, GraphCSR *rcsr, int src, int *parent, int *depth)
+{
+  return bfs_mode (csr, rcsr, src, BFS_DIRECTION_OPTIMIZING, parent, depth);
+}
+
+/*
+ * Parallel top-down BFS. Workers take chunks of the frontier, claim a vertex
+ * by swapping its parent away from UNKNOW_VETEX and queue it in a buffer of
+ * their own. A prefix sum over the buffer sizes places each of them in the
+ * next frontier, which the workers then copy over side by side.
+ */
+#define BFS_PARALLEL_CHUNK      64
+#define BFS_PARALLEL_MIN_WORK   4096
+
+typedef struct BfsBuffer
+{
+  int *items;
+  int size;
+  int capacity;
+  int offset;             /* first slot of the buffer in the next frontier */
+  int error;
+  int64_t arcs;           /* arcs out of the queued vertices */
+} BfsBuffer;
+
+typedef struct BfsParallel
+{
+  GraphCSR *csr;
+  int *parent;
+  int *depth;
+  int *frontier;
+  int *next;
+  int numFront;
+  int cursor;             /* first frontier entry not taken by a worker */
+  int level;
+  int numWorkers;
+  BfsBuffer *buffers;
+} BfsParallel;
+
+static void bfs_init_task (int id, int num_workers, void *arg)
+{
+  BfsParallel *bp = (BfsParallel *)arg;
+  int i, begin, end;
+
+  wpool_range (id, num_workers, bp->csr->numVertices, &begin, &end);
+  for (i = begin; i < end; ++i)
+  {
+    bp->parent[i] = UNKNOW_VETEX;
+    bp->depth[i]  = -1;
+  }
+}
+
+static void bfs_expand_task (int id, int num_workers, void *arg)
+{
+  BfsParallel *bp = (BfsParallel *)arg;
+  BfsBuffer *buf = &bp->buffers[id];
+  GraphCSR *csr = bp->csr;
+  int i, u, v, e, begin, end, unclaimed, capacity, size = 0, *items = buf->items;
+  int64_t arcs = 0;
+
+  (void)num_workers;
+  /* Chunks rather than a fixed split, the degrees of a frontier vary a lot */
+  while ((begin = __atomic_fetch_add (&bp->cursor, BFS_PARALLEL_CHUNK, __ATOMIC_RELAXED))
+         < bp->numFront)
+  {
+    end = MIN(begin + BFS_PARALLEL_CHUNK, bp->numFront);
+    for (i = begin; i < end; ++i)
+    {
+      u = bp->frontier[i];
+      for (e = csr->offsets[u]; e < csr->offsets[u + 1]; ++e)
+      {
+        v = csr->dest[e];
+        if (__atomic_load_n (&bp->parent[v], __ATOMIC_RELAXED) != UNKNOW_VETEX)
+          continue;
+
+        unclaimed = UNKNOW_VETEX;
+        if (! __atomic_compare_exchange_n (&bp->parent[v], &unclaimed, u, 0,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+          continue;
+
+        if (size == buf->capacity)
+        {
+          capacity = (buf->capacity) ? buf->capacity * 2 : 1024;
+          items = (int *)realloc(buf->items, capacity * sizeof (int));
+          if (! items)
+          {
+            buf->error = 1;
+            goto EXIT;
+          }
+          buf->items    = items;
+          buf->capacity = capacity;
+        }
+
+        bp->depth[v]  = bp->level;
+        items[size++] = v;
+        arcs         += csr->offsets[v + 1] - csr->offsets[v];
+      }
+    }
+  }
+
+EXIT:
+  buf->size = size;
+  buf->arcs = arcs;
+}
+
+static void bfs_gather_task (int id, int num_workers, void *arg)
+{
+  BfsParallel *bp = (BfsParallel *)arg;
+  int t;
+
+  /* A worker that never claimed a vertex has no items array yet */
+  for (t = id; t < bp->numWorkers; t += num_workers)
+    if (bp->buffers[t].size)
+      memcpy (bp->next + bp->buffers[t].offset, bp->buffers[t].items,
+              bp->buffers[t].size * sizeof (int));
+}
+
+/* Levels with little work run on this thread only, waking the pool costs more */
+static void bfs_phase (BfsParallel *bp, WorkerPool *pool, WorkerTask task, int64_t work)
+{
+  if (pool && work >= BFS_PARALLEL_MIN_WORK)
+    wpool_run (pool, task, bp);
+  else
+    task (0, 1, bp);
+}
+
+/*
+ * Same contract as bfs_mode, the parent of a vertex is whichever frontier
+ * vertex claimed it first so the tree can differ from one run to the next,
+ * the depths do not. A NULL pool runs the whole search on this thread.
+ */
+int bfs_parallel (GraphCSR *csr, int src, struct WorkerPool *pool, int *parent, int *depth)
+{
+  BfsParallel bp;
+  int *temp, t, i_src, reached, rv = -1;
+  int64_t front_arcs;
+
+  if (! csr || ! csr->numVertices || ! parent || ! depth)
+    return -1;
+
+  i_src = graph_csr_get_vertex_by_id (csr, src);
+  if (i_src == UNKNOW_VETEX)
+  {
+    printf ("[%s,%d] Start vertex %d is not in the graph\n", __func__, __LINE__, src);
+    return -1;
+  }
+
+  memset (&bp, 0, sizeof (bp));
+  bp.csr        = csr;
+  bp.parent     = parent;
+  bp.depth      = depth;
+  bp.numWorkers = (pool) ? pool->numWorkers : 1;
+  bp.frontier   = (int *)malloc(csr->numVertices * sizeof (int));
+  bp.next       = (int *)malloc(csr->numVertices * sizeof (int));
+  bp.buffers    = (BfsBuffer *)calloc(bp.numWorkers, sizeof (BfsBuffer));
+  if (! bp.frontier || ! bp.next || ! bp.buffers)
+  {
+    printf ("[%s,%d] Fail to allocate memory for BFS\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  bfs_phase (&bp, pool, bfs_init_task, csr->numVertices);
+
+  /* src is claimed by itself for the search so nobody takes it back */
+  parent[i_src]   = i_src;
+  depth[i_src]    = 0;
+  bp.frontier[0]  = i_src;
+  bp.numFront     = 1;
+  reached         = 1;
+  front_arcs      = csr->offsets[i_src + 1] - csr->offsets[i_src];
+
+  while (bp.numFront > 0)
+  {
+    bp.level++;
+    bp.cursor = 0;
+    /* A level run on this thread only leaves the other buffers untouched */
+    for (t = 0; t < bp.numWorkers; ++t)
+    {
+      bp.buffers[t].size = 0;
+      bp.buffers[t].arcs = 0;
+    }
+    bfs_phase (&bp, pool, bfs_expand_task, front_arcs);
+
+    /* Prefix sum over the buffer sizes */
+    bp.numFront = 0;
+    front_arcs  = 0;
+    for (t = 0; t < bp.numWorkers; ++t)
+    {
+      if (bp.buffers[t].error)
+      {
+        printf ("[%s,%d] Fail to allocate memory for the next frontier\n", __func__, __LINE__);
+        goto EXIT;
+      }
+      bp.buffers[t].offset  = bp.numFront;
+      bp.numFront          += bp.buffers[t].size;
+      front_arcs           += bp.buffers[t].arcs;
+    }
+
+    bfs_phase (&bp, pool, bfs_gather_task, bp.numFront);
+    temp        = bp.frontier;
+    bp.frontier = bp.next;
+    bp.next     = temp;
+    reached    += bp.numFront;
+  }
+  rv = reached;
+
+EXIT:
+  parent[i_src] = UNKNOW_VETEX;
+  if (bp.buffers)
+  {
+    for (t = 0; t < bp.numWorkers; ++t)
+      if (bp.buffers[t].items)
+        free (bp.buffers[t].items);
+    free (bp.buffers);
+  }
+  if (bp.frontier)  free (bp.frontier);
+  if (bp.next)      free (bp.next);
+  return rv;
+}
+
+int graph_csr_bfs_parallel (GraphCSR *csr, int src, int num_workers)
+{
+  WorkerPool *pool = NULL;
+  int *parent = NULL, *depth = NULL, i, rv = -1;
+
+  if (! csr || ! csr->numVertices)
+    return -1;
+
+  parent  = (int *)malloc(csr->numVertices * sizeof (int));
+  depth   = (int *)malloc(csr->numVertices * sizeof (int));
+  if (! parent || ! depth)
+  {
+    printf ("[%s,%d] Fail to allocate memory for BFS tree\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  if (num_workers > 1)
+    pool = wpool_create (num_workers);
+
+  if (bfs_parallel (csr, src, pool, parent, depth) < 0)
+    goto EXIT;
+
+  for (i = 0; i < csr->numVertices; i++)
+  {
+    if (csr->ids[i] == UNKNOW_VETEX || csr->ids[i] == src)
+      continue;
+
+    if (depth[i] < 0)
+      printf ("\nHops from %d to %d: INF\n", src, csr->ids[i]);
+    else
+      printf ("\nHops from %d to %d: %d\n", src, csr->ids[i], depth[i]);
+    graph_csr_print_path (csr, parent, src, csr->ids[i]);
+  }
+  rv = 0;
+
+EXIT:
+  wpool_deinit (pool);
+  if (parent) free (parent);
+  if (depth)  free (depth);
+  return rv;
+}
+
+int graph_bfs_parallel (Graph *graph, int src, int num_workers)
+{
+  GraphCSR *csr = NULL;
+  int rv;
+
+  csr = graph_csr_build (graph);
+  if (! csr)
+  {
+    printf ("[%s,%d] Error, Fail to build CSR snapshot\n", __func__, __LINE__);
+    return -1;
+  }
+
+  rv = graph_csr_bfs_parallel (csr, src, num_workers);
+  graph_csr_deinit (csr);
+  return rv;
+}
+
+/*
+ * Multi-source BFS, up to MS_BFS_BATCH searches share one traversal. Bit b
+ * of seen[v], visit[v] and next[v] belongs to the b-th source of the batch,
+ * so a single scan of the arcs of v pushes v's frontier bits of every
+ * search at once.
+ */
+#define MS_BFS_BATCH    64
+
+static void ms_bfs_batch (GraphCSR *csr, const int *i_src, int num_src, int *depth,
+                          uint64_t *seen, uint64_t *visit, uint64_t *next)
+{
+  int b, v, e, level, n = csr->numVertices;
+  uint64_t fresh, active, bits;
+
+  memset (seen, 0, n * sizeof (uint64_t));
+  memset (visit, 0, n * sizeof (uint64_t));
+  memset (next, 0, n * sizeof (uint64_t));
+  for (b = 0; b < num_src; ++b)
+  {
+    for (v = 0; v < n; ++v)
+      depth[(size_t)b * n + v] = -1;
+
+    seen[i_src[b]]  |= (uint64_t)1 << b;
+    visit[i_src[b]] |= (uint64_t)1 << b;
+    depth[(size_t)b * n + i_src[b]] = 0;
+  }
+
+  for (level = 1, active = 1; active; ++level)
+  {
+    for (v = 0; v < n; ++v)
+    {
+      if (! visit[v])
+        continue;
+
+      for (e = csr->offsets[v]; e < csr->offsets[v + 1]; ++e)
+        next[csr->dest[e]] |= visit[v];
+    }
+
+    /* Keep the bits of the searches that had not reached v yet */
+    active = 0;
+    for (v = 0; v < n; ++v)
+    {
+      fresh     = next[v] & ~seen[v];
+      next[v]   = 0;
+      visit[v]  = fresh;
+      if (! fresh)
+        continue;
+
+      seen[v] |= fresh;
+      active  |= fresh;
+      for (bits = fresh; bits; bits &= bits - 1)
+      {
+        b = __builtin_ctzll (bits);
+        depth[(size_t)b * n + v] = level;
+      }
+    }
+  }
+}
+
+/*
+ * Hop distances from num_src source ids, run MS_BFS_BATCH sources at a time.
+ * depth holds num_src rows of numVertices entries, row b is the distance of
+ * every CSR slot from sources[b], -1 if unreachable. Return 0 on success,
+ * -1 on error.
+ */
+int ms_bfs (GraphCSR *csr, const int *sources, int num_src, int *depth)
+{
+  uint64_t *seen = NULL, *visit = NULL, *next = NULL;
+  int i_src[MS_BFS_BATCH], b, first, count, rv = -1;
+
+  if (! csr || ! csr->numVertices || ! sources || num_src < 0 || ! depth)
+    return -1;
+
+  seen  = (uint64_t *)malloc(csr->numVertices * sizeof (uint64_t));
+  visit = (uint64_t *)malloc(csr->numVertices * sizeof (uint64_t));
+  next  = (uint64_t *)malloc(csr->numVertices * sizeof (uint64_t));
+  if (! seen || ! visit || ! next)
+  {
+    printf ("[%s,%d] Fail to allocate memory for MS-BFS\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  for (first = 0; first < num_src; first += MS_BFS_BATCH)
+  {
+    count = MIN(MS_BFS_BATCH, num_src - first);
+    for (b = 0; b < count; ++b)
+    {
+      i_src[b] = graph_csr_get_vertex_by_id (csr, sources[first + b]);
+      if (i_src[b] == UNKNOW_VETEX)
+      {
+        printf ("[%s,%d] Start vertex %d is not in the graph\n", __func__, __LINE__,
+                sources[first + b]);
+        goto EXIT;
+      }
+    }
+
+    ms_bfs_batch (csr, i_src, count, depth + (size_t)first * csr->numVertices,
+                  seen, visit, next);
+  }
+  rv = 0;
+
+EXIT:
+  if (seen)   free (seen);
+  if (visit)  free (visit);
+  if (next)   free (next);
+  return rv;
+}
+
+/*
+ * Walk prev_node back from i_dest to i_src and store the slots of the path
+ * in forward order. Return the number of slots on the path, 0 if i_dest is
+ * not reachable or the path does not fit into path_len slots
+ */
+int graph_csr_get_path (GraphCSR *csr, int *prev_node, int i_src, int i_dest,
+                        int *path, int path_len)
+{
+  int i, len = 0, temp;
+
+  if (! csr || ! prev_node || ! path || path_len <= 0)
+    return 0;
+
+  for (i = i_dest; i != i_src; i = prev_node[i])
+  {
+    if (i == UNKNOW_VETEX || len == path_len - 1)
+      return 0;
+
+    path[len++] = i;
+  }
+  path[len++] = i_src;
+
+  /* Reverse into src -> dest order */
+  for (i = 0; i < len / 2; ++i)
+  {
+    temp              = path[i];
+    path[i]           = path[len - 1 - i];
+    path[len - 1 - i] = temp;
+  }
+
+  return len;
+}
+
+int graph_csr_print_path (GraphCSR *csr, int *prev_node, int src, int dest)
+{
+  int i_dest, i_src, *path = NULL, len, i;
+
+  if (!csr || !prev_node)
+    return -1;
+
+  i_dest = graph_csr_get_vertex_by_id (csr, dest);
+  if (i_dest == UNKNOW_VETEX)
+  {
+    printf ("[%s,%d] There no vertex %d in the graph!\n", __func__, __LINE__, dest);
+    return 0;
+  }
+
+  i_src = graph_csr_get_vertex_by_id (csr, src);
+  if (i_src == UNKNOW_VETEX)
+  {
+    printf ("[%s,%d] There no vertex %d in the graph!\n", __func__, __LINE__, src);
+    return 0;
+  }
+
+  path = (int *)malloc(csr->numVertices * sizeof (int));
+  if (! path)
+  {
+    printf ("[%s,%d] Fail to allocate memory for path\n", __func__, __LINE__);
+    return -1;
+  }
+
+  len = graph_csr_get_path (csr, prev_node, i_src, i_dest, path, csr->numVertices);
+  if (! len)
+    printf ("There is no path from %d to %d\n", src, dest);
+  else
+  {
+    printf ("Path from %d to %d: %d ", src, dest, src);
+    for (i = 1; i < len; ++i)
+      printf ("-> %d ", csr->ids[path[i]]);
+    printf ("\n");
+  }
+
+  free (path);
+  return 0;
+}
+
+/*
+ * Dijkstra search state, one vertex is settled per step
+ * A vertex is in the heap with key distance[v] until it is settled, a
+ * shorter distance found meanwhile decreases its key in place.
+ */
+int dijkstra_search_init (DijkstraSearch *search, GraphCSR *csr, int i_src,
+                          graph_dist_t *distance, int *prev_node)
+{
+  int i;
+
+  if (! search || ! csr || ! distance || ! prev_node
+      || i_src < 0 || i_src >= csr->numVertices)
+    return -1;
+
+  search->heap = iheap_create (csr->numVertices);
+  if (! search->heap)
+  {
+    printf ("[%s,%d] Fail to create indexed heap!\n", __func__, __LINE__);
+    return -1;
+  }
+
+  search->csr       = csr;
+  search->distance  = distance;
+  search->prev_node = prev_node;
+  search->settled   = 0;
+
+  for (i = 0; i < csr->numVertices; ++i)
+  {
+    distance[i]   = GRAPH_DIST_INFINITY;
+    prev_node[i]  = UNKNOW_VETEX;
+  }
+
+  distance[i_src] = 0;
+  iheap_push (search->heap, i_src, 0);
+  return 0;
+}
+
+void dijkstra_search_deinit (DijkstraSearch *search)
+{
+  if (! search)
+    return;
+
+  iheap_deinit (search->heap);
+  search->heap = NULL;
+}
+
+/* Return the key of the next vertex to settle, GRAPH_DIST_INFINITY if none is left */
+graph_dist_t dijkstra_search_peek (DijkstraSearch *search)
+{
+  int64_t key;
+
+  if (! search || iheap_peek (search->heap, &key) == -1)
+    return GRAPH_DIST_INFINITY;
+
+  return (graph_dist_t)key;
+}
+
+/* Settle the closest vertex and relax its edges, return its slot or UNKNOW_VETEX when done */
+int dijkstra_search_settle (DijkstraSearch *search)
+{
+  GraphCSR *csr;
+  graph_dist_t temp_dist;
+  int u, v, e;
+
+  if (! search)
+    return UNKNOW_VETEX;
+
+  u = iheap_pop (search->heap, NULL);
+  if (u == -1)
+    return UNKNOW_VETEX;
+
+  csr = search->csr;
+  search->settled++;
+  for (e = csr->offsets[u]; e < csr->offsets[u + 1]; ++e)
+  {
+    v = csr->dest[e];
+    temp_dist = search->distance[u] + csr->weight[e];
+    if (temp_dist < search->distance[v])
+    {
+      search->distance[v]   = temp_dist;
+      search->prev_node[v]  = u;
+      iheap_push (search->heap, v, temp_dist);
+    }
+  }
+
+  return u;
+}
+
+/*
+ * Single source shortest paths from src on non negative weights
+ * If dest is a vertex id, the search stops as soon as dest is settled and
+ * only the distances of settled vertices are final. Pass UNKNOW_VETEX to
+ * compute the whole shortest path tree.
+ */
+int dijkstra (GraphCSR *csr, int src, int dest, graph_dist_t *distance, int *prev_node)
+{
+  DijkstraSearch search;
+  int i_src, i_dest = UNKNOW_VETEX;
+
+  if (!csr || !csr->numVertices
+      || !distance || !prev_node)
+    return -1;
+
+  i_src = graph_csr_get_vertex_by_id (csr, src);
+  if (i_src == UNKNOW_VETEX)
+  {
+    printf ("[%s,%d] Error: There is no edge with src %d in graph\n",
+           __func__, __LINE__, src);
+    return -1;
+  }
+
+  if (dest != UNKNOW_VETEX)
+  {
+    i_dest = graph_csr_get_vertex_by_id (csr, dest);
+    if (i_dest == UNKNOW_VETEX)
+    {
+      printf ("[%s,%d] Error: There is no vertex %d in graph\n",
+             __func__, __LINE__, dest);
+      return -1;
+    }
+  }
+
+  if (dijkstra_search_init (&search, csr, i_src, distance, prev_node) != 0)
+    return -1;
+
+  while (! iheap_is_empty (search.heap))
+  {
+    if (dijkstra_search_settle (&search) == i_dest
+        && i_dest != UNKNOW_VETEX)
+      break;
+  }
+
+  dijkstra_search_deinit (&search);
+  return 0;
+}
+
+/*
+ * A* search from i_src to i_dest, the heap key of a vertex is its distance
+ * plus heuristic (vertex, i_dest, arg). The heuristic must never overestimate
+ * the remaining distance, a NULL heuristic makes it a plain Dijkstra search
+ * with early exit. A vertex is pushed back into the heap if a shorter path
+ * to it is found after it was settled, so the result stays exact with an
+ * inconsistent heuristic.
+ * Return the number of settled vertices, -1 on error.
+ */
+int astar (GraphCSR *csr, int i_src, int i_dest, GraphHeuristic heuristic, void *arg,
+           graph_dist_t *distance, int *prev_node)
+{
+  IndexedHeap *heap = NULL;
+  graph_dist_t temp_dist, h;
+  int i, u, v, e, settled = 0;
+
+  if (! csr || ! distance || ! prev_node
+      || i_src < 0 || i_src >= csr->numVertices
+      || i_dest < 0 || i_dest >= csr->numVertices)
+    return -1;
+
+  heap = iheap_create (csr->numVertices);
+  if (! heap)
+  {
+    printf ("[%s,%d] Fail to create indexed heap!\n", __func__, __LINE__);
+    return -1;
+  }
+
+  for (i = 0; i < csr->numVertices; ++i)
+  {
+    distance[i]   = GRAPH_DIST_INFINITY;
+    prev_node[i]  = UNKNOW_VETEX;
+  }
+
+  distance[i_src] = 0;
+  iheap_push (heap, i_src, (heuristic) ? (*heuristic)(i_src, i_dest, arg) : 0);
+
+  while ((u = iheap_pop (heap, NULL)) != -1)
+  {
+    settled++;
+    if (u == i_dest)
+      break;
+
+    for (e = csr->offsets[u]; e < csr->offsets[u + 1]; ++e)
+    {
+      v = csr->dest[e];
+      temp_dist = distance[u] + csr->weight[e];
+      if (temp_dist < distance[v])
+      {
+        distance[v]   = temp_dist;
+        prev_node[v]  = u;
+        h = (heuristic) ? (*heuristic)(v, i_dest, arg) : 0;
+        iheap_push (heap, v, (int64_t)temp_dist + h);
+      }
+    }
+  }
+
+  iheap_deinit (heap);
+  return settled;
+}
+
+/*
+ * ALT (A*, Landmarks, Triangle inequality) preprocessing
+ * Landmarks are picked one by one as the vertex farthest from the landmarks
+ * already chosen. For every landmark L the distances d(L, v) and d(v, L) are
+ * stored, then |d(L, t) - d(L, v)| style differences bound d(v, t) from below.
+ */
+GraphALT* graph_alt_build (GraphCSR *csr, GraphCSR *rcsr, int num_landmarks)
+{
+  GraphALT *alt = NULL;
+  graph_dist_t *min_dist = NULL, *dist;
+  int *prev_node = NULL, k, i, next;
+
+  if (! csr || ! rcsr || ! csr->numVertices || num_landmarks <= 0
+      || rcsr->numVertices != csr->numVertices)
+    return NULL;
+
+  alt = (GraphALT *)calloc(1, sizeof (GraphALT));
+  if (! alt)
+  {
+    printf ("[%s,%d] Fail to allocate memory for ALT data\n", __func__, __LINE__);
+    return NULL;
+  }
+
+  alt->numVertices  = csr->numVertices;
+  alt->landmarks    = (int *)malloc(num_landmarks * sizeof (int));
+  alt->distFrom     = (graph_dist_t *)malloc((size_t)num_landmarks * csr->numVertices * sizeof (graph_dist_t));
+  if (rcsr != csr)
+    alt->distTo     = (graph_dist_t *)malloc((size_t)num_landmarks * csr->numVertices * sizeof (graph_dist_t));
+  else
+    alt->distTo     = alt->distFrom;
+  min_dist          = (graph_dist_t *)malloc(csr->numVertices * sizeof (graph_dist_t));
+  prev_node         = (int *)malloc(csr->numVertices * sizeof (int));
+  if (! alt->landmarks || ! alt->distFrom || ! alt->distTo || ! min_dist || ! prev_node)
+  {
+    printf ("[%s,%d] Fail to allocate memory for ALT arrays\n", __func__, __LINE__);
+    goto ERR_EXIT;
+  }
+
+  /* Start from the vertex farthest away from the first vertex of the graph */
+  for (next = 0; next < csr->numVertices && csr->ids[next] == UNKNOW_VETEX; ++next);
+  if (dijkstra (csr, csr->ids[next], UNKNOW_VETEX, min_dist, prev_node) != 0)
+    goto ERR_EXIT;
+
+  for (k = 0; k < num_landmarks; ++k)
+  {
+    for (i = 0; i < csr->numVertices; ++i)
+    {
+      if (min_dist[i] != GRAPH_DIST_INFINITY
+          && min_dist[i] > min_dist[next])
+        next = i;
+    }
+
+    /* Every reachable vertex is already a landmark */
+    if (k && min_dist[next] == 0)
+      break;
+
+    alt->landmarks[k] = next;
+    dist = alt->distFrom + (size_t)k * csr->numVertices;
+    if (dijkstra (csr, csr->ids[next], UNKNOW_VETEX, dist, prev_node) != 0)
+      goto ERR_EXIT;
+
+    if (rcsr != csr
+        && dijkstra (rcsr, rcsr->ids[next], UNKNOW_VETEX,
+                     alt->distTo + (size_t)k * csr->numVertices, prev_node) != 0)
+      goto ERR_EXIT;
+
+    if (k == 0)
+    {
+      for (i = 0; i < csr->numVertices; ++i)
+        min_dist[i] = dist[i];
+    }
+    else
+    {
+      for (i = 0; i < csr->numVertices; ++i)
+        min_dist[i] = MIN(min_dist[i], dist[i]);
+    }
+    alt->numLandmarks++;
+  }
+
+  free (min_dist);
+  free (prev_node);
+  return alt;
+
+ERR_EXIT:
+  if (min_dist)   free (min_dist);
+  if (prev_node)  free (prev_node);
+  graph_alt_deinit (alt);
+  return NULL;
+}
+
+void graph_alt_deinit (GraphALT *alt)
+{
+  if (! alt)
+    return;
+
+  if (alt->distTo && alt->distTo != alt->distFrom)
+    free (alt->distTo);
+  if (alt->distFrom)  free (alt->distFrom);
+  if (alt->landmarks) free (alt->landmarks);
+  free (alt);
+  alt = NULL;
+}
+
+/* GraphHeuristic for astar (), arg is the GraphALT built on the same snapshot */
+graph_dist_t graph_alt_heuristic (int i_vertex, int i_dest, void *arg)
+{
+  GraphALT *alt = (GraphALT *)arg;
+  graph_dist_t *from, *to, bound = 0;
+  int k;
+
+  if (! alt)
+    return 0;
+
+  for (k = 0; k < alt->numLandmarks; ++k)
+  {
+    from  = alt->distFrom + (size_t)k * alt->numVertices;
+    to    = alt->distTo + (size_t)k * alt->numVertices;
+
+    /* d(v, t) >= d(L, t) - d(L, v) */
+    if (from[i_dest] != GRAPH_DIST_INFINITY && from[i_vertex] != GRAPH_DIST_INFINITY
+        && from[i_dest] - from[i_vertex] > bound)
+      bound = from[i_dest] - from[i_vertex];
+
+    /* d(v, t) >= d(v, L) - d(t, L) */
+    if (to[i_vertex] != GRAPH_DIST_INFINITY && to[i_dest] != GRAPH_DIST_INFINITY
+        && to[i_vertex] - to[i_dest] > bound)
+      bound = to[i_vertex] - to[i_dest];
+  }
+
+  return bound;
+}
+
+/*
+ * Point to point shortest path, the forward search runs from i_src on csr
+ * and the backward search from i_dest on rcsr, which holds the reversed
+ * edges (the same snapshot for an undirected graph). The two searches
+ * settle one vertex in turn and stop once the sum of their next keys can
+ * not improve on the best path met so far.
+ * Return the slot where the searches meet, UNKNOW_VETEX if i_dest can not
+ * be reached from i_src.
+ */
+int dijkstra_bidirectional (GraphCSR *csr, GraphCSR *rcsr, int i_src, int i_dest,
+                            graph_dist_t *dist_fwd, int *prev_fwd,
+                            graph_dist_t *dist_bwd, int *prev_bwd,
+                            graph_dist_t *distance)
+{
+  DijkstraSearch search[2];
+  graph_dist_t best = GRAPH_DIST_INFINITY, top[2];
+  int64_t sum;
+  int meet = UNKNOW_VETEX, side = 0, u, v, e;
+  graph_dist_t *dist_other;
+
+  if (! csr || ! rcsr || ! distance
+      || rcsr->numVertices != csr->numVertices)
+    return UNKNOW_VETEX;
+
+  if (dijkstra_search_init (&search[0], csr, i_src, dist_fwd, prev_fwd) != 0)
+    return UNKNOW_VETEX;
+  if (dijkstra_search_init (&search[1], rcsr, i_dest, dist_bwd, prev_bwd) != 0)
+  {
+    dijkstra_search_deinit (&search[0]);
+    return UNKNOW_VETEX;
+  }
+
+  if (i_src == i_dest)
+  {
+    best = 0;
+    meet = i_src;
+  }
+
+  while (1)
+  {
+    top[0] = dijkstra_search_peek (&search[0]);
+    top[1] = dijkstra_search_peek (&search[1]);
+    /* Two finite keys can still overflow a 32-bit graph_dist_t when added */
+    if (top[0] == GRAPH_DIST_INFINITY || top[1] == GRAPH_DIST_INFINITY
+        || (int64_t)top[0] + top[1] >= best)
+      break;
+
+    u = dijkstra_search_settle (&search[side]);
+    dist_other = search[1 - side].distance;
+
+    /* Any vertex whose distance just dropped may close a shorter path */
+    for (e = search[side].csr->offsets[u]; e < search[side].csr->offsets[u + 1]; ++e)
+    {
+      v = search[side].csr->dest[e];
+      if (dist_other[v] == GRAPH_DIST_INFINITY)
+        continue;
+
+      sum = (int64_t)search[side].distance[v] + dist_other[v];
+      if (sum < best)
+      {
+        best = (graph_dist_t)sum;
+        meet = v;
+      }
+    }
+
+    side = 1 - side;
+  }
+
+  dijkstra_search_deinit (&search[0]);
+  dijkstra_search_deinit (&search[1]);
+
+  *distance = best;
+  return meet;
+}
+
+/*
+ * Shortest path from src to dest, both vertex ids. The length goes to
+ * distance and the vertex ids of the path, src and dest included, to path.
+ * Return the number of vertices on the path, 0 if dest is not reachable or
+ * the path does not fit into path_len entries, -1 on error.
+ */
+int graph_csr_shortest_path (GraphCSR *csr, int src, int dest,
+                             graph_dist_t *distance, int *path, int path_len)
+{
+  graph_dist_t *dist_fwd = NULL, *dist_bwd = NULL;
+  GraphCSR *rcsr;
+  int *prev_fwd = NULL, *prev_bwd = NULL;
+  int i_src, i_dest, meet, len = 0, i, rv = -1;
+
+  if (! csr || ! csr->numVertices || ! distance || ! path || path_len <= 0)
+    return -1;
+
+  i_src   = graph_csr_get_vertex_by_id (csr, src);
+  i_dest  = graph_csr_get_vertex_by_id (csr, dest);
+  if (i_src == UNKNOW_VETEX || i_dest == UNKNOW_VETEX)
+  {
+    printf ("[%s,%d] Vertex %d or %d is not in the graph\n", __func__, __LINE__, src, dest);
+    return -1;
+  }
+
+  dist_fwd  = (graph_dist_t *)malloc(csr->numVertices * sizeof (graph_dist_t));
+  dist_bwd  = (graph_dist_t *)malloc(csr->numVertices * sizeof (graph_dist_t));
+  prev_fwd  = (int *)malloc(csr->numVertices * sizeof (int));
+  prev_bwd  = (int *)malloc(csr->numVertices * sizeof (int));
+  rcsr      = graph_csr_reverse (csr);
+  if (! dist_fwd || ! dist_bwd || ! prev_fwd || ! prev_bwd || ! rcsr)
+  {
+    printf ("[%s,%d] Fail to allocate memory for search arrays\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  meet = dijkstra_bidirectional (csr, rcsr, i_src, i_dest, dist_fwd, prev_fwd,
+                                 dist_bwd, prev_bwd, distance);
+  rv = 0;
+  if (meet == UNKNOW_VETEX)
+    goto EXIT;
+
+  /* src -> meet from the forward tree, then meet -> dest down the backward tree */
+  len = graph_csr_get_path (csr, prev_fwd, i_src, meet, path, path_len);
+  if (! len)
+    goto EXIT;
+
+  for (i = prev_bwd[meet]; i != UNKNOW_VETEX; i = prev_bwd[i])
+  {
+    if (len == path_len)
+    {
+      len = 0;
+      goto EXIT;
+    }
+    path[len++] = i;
+  }
+
+  for (i = 0; i < len; ++i)
+    path[i] = csr->ids[path[i]];
+  rv = len;
+
+EXIT:
+  if (dist_fwd) free (dist_fwd);
+  if (dist_bwd) free (dist_bwd);
+  if (prev_fwd) free (prev_fwd);
+  if (prev_bwd) free (prev_bwd);
+  return rv;
+}
+
+int graph_shortest_path (Graph *graph, int src, int dest,
+                         graph_dist_t *distance, int *path, int path_len)
+{
+  GraphCSR *csr = NULL;
+  int rv;
+
+  csr = graph_csr_build (graph);
+  if (! csr)
+  {
+    printf ("[%s,%d] Error, Fail to build CSR snapshot\n", __func__, __LINE__);
+    return -1;
+  }
+
+  rv = graph_csr_shortest_path (csr, src, dest, distance, path, path_len);
+  graph_csr_deinit (csr);
+  return rv;
+}
+
+int graph_csr_dijkstra (GraphCSR *csr, int src)
+{
+  graph_dist_t *distance;
+  int *prev_node, rv, i;
+
+  if (!csr || !csr->numVertices)
+    return -1;
+
+  distance = (graph_dist_t *)malloc(csr->numVertices * sizeof (graph_dist_t));
+  if (!distance)
+  {
+    printf ("[%s,%d] Fail to allocated memory for distance array!\n",
+            __func__, __LINE__);
+    return -1;
+  }
+
+  prev_node = (int *)malloc(csr->numVertices * sizeof (int));
+  if (!prev_node)
+  {
+    printf ("[%s,%d] Fail to allocated memory for distance array!\n",
+            __func__, __LINE__);
+    free (distance);
+    return -1;
+  }
+
+  rv = dijkstra (csr, src, UNKNOW_VETEX, distance, prev_node);
+  if (rv == 0)
+  {
+    for (i = 0; i < csr->numVertices; i++)
+    {
+      if (csr->ids[i] != UNKNOW_VETEX
+          && csr->ids[i] != src)
+      {
+        if (distance[i] == GRAPH_DIST_INFINITY)
+          printf ("\nDistance from %d to %d: INF\n", src, csr->ids[i]);
+        else
+          printf ("\nDistance from %d to %d: %lld\n", src, csr->ids[i], (long long)distance[i]);
+        graph_csr_print_path (csr, prev_node, src, csr->ids[i]);
+      }
+    }
+  }
+
+  free (distance);
+  free (prev_node);
+
+  return rv;
+}
+
+int graph_dijkstra (Graph *graph, int src)
+{
+  GraphCSR *csr = NULL;
+  int rv;
+
+  csr = graph_csr_build (graph);
+  if (! csr)
+  {
+    printf ("[%s,%d] Error, Fail to build CSR snapshot\n", __func__, __LINE__);
+    return -1;
+  }
+
+  rv = graph_csr_dijkstra (csr, src);
+  graph_csr_deinit (csr);
+  return rv;
+}
+
+/*
+ * Delta-stepping SSSP
+ * Tentative distances are kept in buckets of width delta. The lowest
+ * bucket is emptied by relaxing its light edges (weight <= delta) until it
+ * stays empty, then the heavy edges of every vertex removed from it are
+ * relaxed once. Each worker owns the vertices v with v % numWorkers equal to
+ * its index: it scans its own bucket entries and sends relaxation requests
+ * to the owner of the target, so distance[], prev_node[] and the buckets
+ * are only ever written by one thread and no atomics are needed.
+ */
+#define DELTA_PARALLEL_MIN_WORK   1024
+#define DELTA_MAX_BUCKETS         (1 << 16)   /* per worker, delta is raised to fit */
+#define DELTA_WORK_BUCKET         0
+#define DELTA_WORK_REMOVED        1
+#define DELTA_WORK_REQUESTS       2
+
+typedef struct DeltaRequest
+{
+  int vertex;
+  int from;
+  graph_dist_t dist;
+} DeltaRequest;
+
+typedef struct DeltaList
+{
+  int size;
+  int capacity;
+  int *items;
+} DeltaList;
+
+typedef struct DeltaWorker
+{
+  DeltaList *buckets;       /* cyclic bucket lists of the owned vertices */
+  DeltaList frontier;       /* vertices taken from the current bucket */
+  DeltaList removed;        /* every vertex taken from the current bucket, for the heavy pass */
+  DeltaRequest **requests;  /* requests[t] : requests for the vertices of worker t */
+  int *numRequests;
+  int *capRequests;
+  int pending;              /* entries left in the current bucket after a relax phase */
+  int error;
+} DeltaWorker;
+
+typedef struct DeltaStepping
+{
+  GraphCSR *csr;
+  graph_dist_t delta;
+  graph_dist_t *distance;
+  int *prev_node;
+  int64_t *bucket;          /* bucket index of each vertex, -1 if it is in no bucket */
+  char *removed;            /* vertex is on the removed list of its owner */
+  int numBuckets;
+  int64_t current;
+  int heavy;
+  int numWorkers;
+  DeltaWorker *workers;
+} DeltaStepping;
+
+static int delta_list_push (DeltaList *list, int item)
+{
+  int capacity, *items;
+
+  if (list->size == list->capacity)
+  {
+    capacity = (list->capacity) ? list->capacity * 2 : 16;
+    items = (int *)realloc(list->items, capacity * sizeof (int));
+    if (! items)
+      return -1;
+
+    list->items     = items;
+    list->capacity  = capacity;
+  }
+
+  list->items[list->size++] = item;
+  return 0;
+}
+
+static int delta_request_push (DeltaWorker *worker, int owner, int vertex, int from,
+                               graph_dist_t dist)
+{
+  DeltaRequest *requests;
+  int capacity;
+
+  if (worker->numRequests[owner] == worker->capRequests[owner])
+  {
+    capacity = (worker->capRequests[owner]) ? worker->capRequests[owner] * 2 : 64;
+    requests = (DeltaRequest *)realloc(worker->requests[owner], capacity * sizeof (DeltaRequest));
+    if (! requests)
+      return -1;
+
+    worker->requests[owner]     = requests;
+    worker->capRequests[owner]  = capacity;
+  }
+
+  requests = &worker->requests[owner][worker->numRequests[owner]++];
+  requests->vertex  = vertex;
+  requests->from    = from;
+  requests->dist    = dist;
+  return 0;
+}
+
+static void delta_init_task (int id, int num_workers, void *arg)
+{
+  DeltaStepping *ds = (DeltaStepping *)arg;
+  int i, begin, end;
+
+  wpool_range (id, num_workers, ds->csr->numVertices, &begin, &end);
+  for (i = begin; i < end; ++i)
+  {
+    ds->distance[i]   = GRAPH_DIST_INFINITY;
+    ds->prev_node[i]  = UNKNOW_VETEX;
+    ds->bucket[i]     = -1;
+    ds->removed[i]    = 0;
+  }
+}
+
+/*
+ * Light phase: take the owned vertices out of the current bucket.
+ * Heavy phase: go through the vertices removed from it.
+ * Either way, send a request for every edge of the matching class.
+ */
+static void delta_request_task (int id, int num_workers, void *arg)
+{
+  DeltaStepping *ds = (DeltaStepping *)arg;
+  DeltaWorker *worker = &ds->workers[id];
+  DeltaList *list, *source;
+  GraphCSR *csr = ds->csr;
+  graph_dist_t temp_dist;
+  int i, e, u, v;
+
+  for (i = 0; i < num_workers; ++i)
+    worker->numRequests[i] = 0;
+
+  if (ds->heavy)
+    source = &worker->removed;
+  else
+  {
+    list = &worker->buckets[ds->current % ds->numBuckets];
+    worker->frontier.size = 0;
+    for (i = 0; i < list->size; ++i)
+    {
+      u = list->items[i];
+
+      /* Entries of vertices that moved to a lower bucket since are stale */
+      if (ds->bucket[u] != ds->current)
+        continue;
+
+      ds->bucket[u] = -1;
+      if (delta_list_push (&worker->frontier, u) != 0)
+        goto ERR_EXIT;
+      if (! ds->removed[u])
+      {
+        ds->removed[u] = 1;
+        if (delta_list_push (&worker->removed, u) != 0)
+          goto ERR_EXIT;
+      }
+    }
+    list->size = 0;
+    source = &worker->frontier;
+  }
+
+  for (i = 0; i < source->size; ++i)
+  {
+    u = source->items[i];
+    for (e = csr->offsets[u]; e < csr->offsets[u + 1]; ++e)
+    {
+      if ((csr->weight[e] > ds->delta) != ds->heavy)
+        continue;
+
+      v = csr->dest[e];
+      temp_dist = ds->distance[u] + csr->weight[e];
+
+      /* distance[v] is not written in this phase, the check saves most requests */
+      if (temp_dist < ds->distance[v]
+          && delta_request_push (worker, v % num_workers, v, u, temp_dist) != 0)
+        goto ERR_EXIT;
+    }
+  }
+
+  if (ds->heavy)
+  {
+    for (i = 0; i < worker->removed.size; ++i)
+      ds->removed[worker->removed.items[i]] = 0;
+    worker->removed.size = 0;
+  }
+  return;
+
+ERR_EXIT:
+  worker->error = 1;
+}
+
+/* Apply the requests for the owned vertices and move them to their new bucket */
+static void delta_relax_task (int id, int num_workers, void *arg)
+{
+  DeltaStepping *ds = (DeltaStepping *)arg;
+  DeltaWorker *worker = &ds->workers[id];
+  DeltaRequest *request;
+  int64_t index;
+  int t, i;
+
+  for (t = 0; t < num_workers; ++t)
+  {
+    for (i = 0; i < ds->workers[t].numRequests[id]; ++i)
+    {
+      request = &ds->workers[t].requests[id][i];
+      if (request->dist >= ds->distance[request->vertex])
+        continue;
+
+      ds->distance[request->vertex]   = request->dist;
+      ds->prev_node[request->vertex]  = request->from;
+
+      index = request->dist / ds->delta;
+      if (ds->bucket[request->vertex] != index)
+      {
+        ds->bucket[request->vertex] = index;
+        if (delta_list_push (&worker->buckets[index % ds->numBuckets], request->vertex) != 0)
+          worker->error = 1;
+      }
+    }
+  }
+
+  worker->pending = worker->buckets[ds->current % ds->numBuckets].size;
+}
+
+/*
+ * Run one phase on every worker. The tasks of one phase are independent, so
+ * a phase with little work runs them one after the other on this thread
+ * instead of paying for waking up the pool.
+ */
+static int delta_phase (DeltaStepping *ds, WorkerPool *pool, WorkerTask task, int64_t work)
+{
+  int t;
+
+  if (pool && work >= DELTA_PARALLEL_MIN_WORK)
+    wpool_run (pool, task, ds);
+  else
+  {
+    for (t = 0; t < ds->numWorkers; ++t)
+      task (t, ds->numWorkers, ds);
+  }
+
+  for (t = 0; t < ds->numWorkers; ++t)
+  {
+    if (ds->workers[t].error)
+    {
+      printf ("[%s,%d] Fail to allocate memory for delta stepping\n", __func__, __LINE__);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/* Work of the next phase: bucket entries, removed vertices or requests */
+static int64_t delta_work (DeltaStepping *ds, int what)
+{
+  int64_t work = 0;
+  int t, i;
+
+  for (t = 0; t < ds->numWorkers; ++t)
+  {
+    if (what == DELTA_WORK_BUCKET)
+      work += ds->workers[t].buckets[ds->current % ds->numBuckets].size;
+    else if (what == DELTA_WORK_REMOVED)
+      work += ds->workers[t].removed.size;
+    else
+    {
+      for (i = 0; i < ds->numWorkers; ++i)
+        work += ds->workers[t].numRequests[i];
+    }
+  }
+
+  return work;
+}
+
+static void delta_stepping_deinit (DeltaStepping *ds)
+{
+  DeltaWorker *worker;
+  int t, i;
+
+  if (ds->workers)
+  {
+    for (t = 0; t < ds->numWorkers; ++t)
+    {
+      worker = &ds->workers[t];
+      if (worker->buckets)
+      {
+        for (i = 0; i < ds->numBuckets; ++i)
+          free (worker->buckets[i].items);
+        free (worker->buckets);
+      }
+      if (worker->requests)
+      {
+        for (i = 0; i < ds->numWorkers; ++i)
+          free (worker->requests[i]);
+        free (worker->requests);
+      }
+      free (worker->frontier.items);
+      free (worker->removed.items);
+      if (worker->numRequests) free (worker->numRequests);
+      if (worker->capRequests) free (worker->capRequests);
+    }
+    free (ds->workers);
+  }
+
+  if (ds->bucket)   free (ds->bucket);
+  if (ds->removed)  free (ds->removed);
+}
+
+/*
+ * Single source shortest paths from vertex id src with the same output as
+ * dijkstra(). Edge weights must not be negative. A delta <= 0 picks the
+ * largest weight over the average degree, a delta so small that the bucket
+ * ring would pass DELTA_MAX_BUCKETS is raised. pool may be NULL to run on
+ * the calling thread only.
+ */
+int delta_stepping (GraphCSR *csr, int src, graph_dist_t delta, WorkerPool *pool,
+                    graph_dist_t *distance, int *prev_node)
+{
+  DeltaStepping ds;
+  DeltaWorker *worker;
+  graph_dist_t max_weight = 0;
+  int64_t next, width;
+  int i_src, t, e, pending, rv = -1;
+
+  if (! csr || ! csr->numVertices || ! distance || ! prev_node)
+    return -1;
+
+  i_src = graph_csr_get_vertex_by_id (csr, src);
+  if (i_src == UNKNOW_VETEX)
+  {
+    printf ("[%s,%d] Error: There is no edge with src %d in graph\n",
+           __func__, __LINE__, src);
+    return -1;
+  }
+
+  for (e = 0; e < csr->offsets[csr->numVertices]; ++e)
+  {
+    if (csr->weight[e] < 0)
+    {
+      printf ("[%s,%d] Error: Delta stepping does not take negative weight %d\n",
+              __func__, __LINE__, csr->weight[e]);
+      return -1;
+    }
+    if (csr->weight[e] > max_weight)
+      max_weight = csr->weight[e];
+  }
+
+  if (delta <= 0)
+  {
+    /* max_weight * numVertices easily overflows a 32-bit graph_dist_t */
+    width = (csr->offsets[csr->numVertices])
+            ? (int64_t)max_weight * csr->numVertices / csr->offsets[csr->numVertices] : 1;
+    if (width < 1)
+      width = 1;
+    if (width > GRAPH_DIST_INFINITY)
+      width = GRAPH_DIST_INFINITY;
+    delta = (graph_dist_t)width;
+  }
+
+  /* A narrow delta against heavy edges would need a huge bucket ring per worker */
+  if (max_weight / delta > DELTA_MAX_BUCKETS - 2)
+    delta = (graph_dist_t)(((int64_t)max_weight + DELTA_MAX_BUCKETS - 3) / (DELTA_MAX_BUCKETS - 2));
+
+  /* Live entries never sit more than max_weight / delta + 1 buckets above the current one */
+  memset (&ds, 0, sizeof (DeltaStepping));
+  ds.csr        = csr;
+  ds.delta      = delta;
+  ds.distance   = distance;
+  ds.prev_node  = prev_node;
+  ds.numBuckets = (int)(max_weight / delta) + 2;
+  ds.numWorkers = (pool) ? pool->numWorkers : 1;
+  ds.bucket     = (int64_t *)malloc(csr->numVertices * sizeof (int64_t));
+  ds.removed    = (char *)malloc(csr->numVertices * sizeof (char));
+  ds.workers    = (DeltaWorker *)calloc(ds.numWorkers, sizeof (DeltaWorker));
+  if (! ds.bucket || ! ds.removed || ! ds.workers)
+    goto ERR_EXIT;
+
+  for (t = 0; t < ds.numWorkers; ++t)
+  {
+    worker = &ds.workers[t];
+    worker->buckets     = (DeltaList *)calloc(ds.numBuckets, sizeof (DeltaList));
+    worker->requests    = (DeltaRequest **)calloc(ds.numWorkers, sizeof (DeltaRequest *));
+    worker->numRequests = (int *)calloc(ds.numWorkers, sizeof (int));
+    worker->capRequests = (int *)calloc(ds.numWorkers, sizeof (int));
+    if (! worker->buckets || ! worker->requests
+        || ! worker->numRequests || ! worker->capRequests)
+      goto ERR_EXIT;
+  }
+
+  if (delta_phase (&ds, pool, delta_init_task, csr->numVertices) != 0)
+    goto EXIT;
+
+  distance[i_src]   = 0;
+  ds.bucket[i_src]  = 0;
+  if (delta_list_push (&ds.workers[i_src % ds.numWorkers].buckets[0], i_src) != 0)
+    goto ERR_EXIT;
+
+  for (;;)
+  {
+    /* Light edges may refill the current bucket, repeat until it stays empty */
+    do
+    {
+      ds.heavy = 0;
+      if (delta_phase (&ds, pool, delta_request_task, delta_work (&ds, DELTA_WORK_BUCKET)) != 0
+          || delta_phase (&ds, pool, delta_relax_task, delta_work (&ds, DELTA_WORK_REQUESTS)) != 0)
+        goto EXIT;
+
+      pending = 0;
+      for (t = 0; t < ds.numWorkers; ++t)
+        pending += ds.workers[t].pending;
+    } while (pending);
+
+    ds.heavy = 1;
+    if (delta_phase (&ds, pool, delta_request_task, delta_work (&ds, DELTA_WORK_REMOVED)) != 0
+        || delta_phase (&ds, pool, delta_relax_task, delta_work (&ds, DELTA_WORK_REQUESTS)) != 0)
+      goto EXIT;
+
+    /* Next bucket with any entry, stale ones only cost an empty round */
+    for (next = ds.current + 1; next < ds.current + ds.numBuckets; ++next)
+    {
+      for (t = 0; t < ds.numWorkers; ++t)
+      {
+        if (ds.workers[t].buckets[next % ds.numBuckets].size)
+          break;
+      }
+      if (t < ds.numWorkers)
+        break;
+    }
+    if (next == ds.current + ds.numBuckets)
+      break;
+    ds.current = next;
+  }
+
+  rv = 0;
+  goto EXIT;
+
+ERR_EXIT:
+  printf ("[%s,%d] Fail to allocate memory for delta stepping\n", __func__, __LINE__);
+
+EXIT:
+  delta_stepping_deinit (&ds);
+  return rv;
+}
+
+int graph_csr_delta_stepping (GraphCSR *csr, int src, graph_dist_t delta, int num_workers)
+{
+  WorkerPool *pool = NULL;
+  graph_dist_t *distance;
+  int *prev_node, rv, i;
+
+  if (!csr || !csr->numVertices)
+    return -1;
+
+  distance = (graph_dist_t *)malloc(csr->numVertices * sizeof (graph_dist_t));
+  if (!distance)
+  {
+    printf ("[%s,%d] Fail to allocated memory for distance array!\n",
+            __func__, __LINE__);
+    return -1;
+  }
+
+  prev_node = (int *)malloc(csr->numVertices * sizeof (int));
+  if (!prev_node)
+  {
+    printf ("[%s,%d] Fail to allocated memory for distance array!\n",
+            __func__, __LINE__);
+    free (distance);
+    return -1;
+  }
+
+  if (num_workers > 1)
+    pool = wpool_create (num_workers);
+
+  rv = delta_stepping (csr, src, delta, pool, distance, prev_node);
+  if (rv == 0)
+  {
+    for (i = 0; i < csr->numVertices; i++)
+    {
+      if (csr->ids[i] != UNKNOW_VETEX
+          && csr->ids[i] != src)
+      {
+        if (distance[i] == GRAPH_DIST_INFINITY)
+          printf ("\nDistance from %d to %d: INF\n", src, csr->ids[i]);
+        else
+          printf ("\nDistance from %d to %d: %lld\n", src, csr->ids[i], (long long)distance[i]);
+        graph_csr_print_path (csr, prev_node, src, csr->ids[i]);
+      }
+    }
+  }
+
+  wpool_deinit (pool);
+  free (distance);
+  free (prev_node);
+
+  return rv;
+}
+
+int graph_delta_stepping (Graph *graph, int src, graph_dist_t delta, int num_workers)
+{
+  GraphCSR *csr = NULL;
+  int rv;
+
+  csr = graph_csr_build (graph);
+  if (! csr)
+  {
+    printf ("[%s,%d] Error, Fail to build CSR snapshot\n", __func__, __LINE__);
+    return -1;
+  }
+
+  rv = graph_csr_delta_stepping (csr, src, delta, num_workers);
+  graph_csr_deinit (csr);
+  return rv;
+}
+
+/* Gauss-Seidel passes in place, FULL always does V - 1 of them */
+static int bellman_ford_passes (GraphCSR *csr, int early_exit, graph_dist_t *distance, int *prev_node)
+{
+  int i, e, pass, updated = 1;
+  graph_dist_t temp_dist;
+
+  /* Relax every edge V - 1 times */
+  for (pass = 1; pass < csr->numVertices; ++pass)
+  {
+    updated = 0;
+    for (i = 0; i < csr->numVertices; ++i)
+    {
+      if (distance[i] == GRAPH_DIST_INFINITY)
+        continue;
+
+      for (e = csr->offsets[i]; e < csr->offsets[i + 1]; ++e)
+      {
+        temp_dist = distance[i] + csr->weight[e];
+        if (temp_dist < distance[csr->dest[e]])
+        {
+          distance[csr->dest[e]]  = temp_dist;
+          prev_node[csr->dest[e]] = i;
+          updated = 1;
+        }
+      }
+    }
+
+    if (early_exit && ! updated)
+      return 0;
+  }
+
+  if (! updated)
+    return 0;
+
+  /* Detect negative weight cycle */
+  for (i = 0; i < csr->numVertices; ++i)
+  {
+    if (distance[i] == GRAPH_DIST_INFINITY)
+      continue;
+
+    for (e = csr->offsets[i]; e < csr->offsets[i + 1]; ++e)
+    {
+      if (distance[i] + csr->weight[e] < distance[csr->dest[e]])
+        return 1;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * SPFA: a FIFO of the vertices whose distance dropped, only their edges are
+ * relaxed. A shortest path has at most V - 1 edges, a path that reaches V
+ * edges while still improving runs through a negative cycle.
+ */
+static int bellman_ford_spfa (GraphCSR *csr, int i_src, graph_dist_t *distance, int *prev_node)
+{
+  int *queue = NULL, *edges = NULL, head = 0, count = 0, u, v, e, rv = -1;
+  char *queued = NULL;
+  graph_dist_t temp_dist;
+
+  /* A vertex is queued at most once at a time, V entries are enough */
+  queue   = (int *)malloc(csr->numVertices * sizeof (int));
+  edges   = (int *)calloc(csr->numVertices, sizeof (int));
+  queued  = (char *)calloc(csr->numVertices, sizeof (char));
+  if (! queue || ! edges || ! queued)
+  {
+    printf ("[%s,%d] Fail to allocate memory for SPFA queue\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  queue[0]        = i_src;
+  queued[i_src]   = 1;
+  count           = 1;
+  rv              = 0;
+  while (count)
+  {
+    u = queue[head];
+    head = (head + 1) % csr->numVertices;
+    count--;
+    queued[u] = 0;
+
+    for (e = csr->offsets[u]; e < csr->offsets[u + 1]; ++e)
+    {
+      v = csr->dest[e];
+      temp_dist = distance[u] + csr->weight[e];
+      if (temp_dist >= distance[v])
+        continue;
+
+      distance[v]   = temp_dist;
+      prev_node[v]  = u;
+      edges[v]      = edges[u] + 1;
+      if (edges[v] >= csr->numVertices)
+      {
+        rv = 1;
+        goto EXIT;
+      }
+
+      if (! queued[v])
+      {
+        queue[(head + count) % csr->numVertices] = v;
+        queued[v] = 1;
+        count++;
+      }
+    }
+  }
+
+EXIT:
+  if (queue)  free (queue);
+  if (edges)  free (edges);
+  if (queued) free (queued);
+  return rv;
+}
+
+typedef struct BellmanFordPass
+{
+  GraphCSR *rcsr;
+  graph_dist_t *distance;   /* distances of the previous pass, read only */
+  graph_dist_t *next;       /* distances of this pass */
+  int *prev_node;
+  int *updated;             /* per worker */
+} BellmanFordPass;
+
+/* Pull over the incoming edges of a range of vertices, each vertex is written by one worker */
+static void bellman_ford_pass_task (int id, int num_workers, void *arg)
+{
+  BellmanFordPass *bf = (BellmanFordPass *)arg;
+  GraphCSR *rcsr = bf->rcsr;
+  graph_dist_t best, temp_dist;
+  int v, e, from, begin, end;
+
+  bf->updated[id] = 0;
+  wpool_range (id, num_workers, rcsr->numVertices, &begin, &end);
+  for (v = begin; v < end; ++v)
   {
-    printf ("[%s,%d] Error, Graph is NULL\n", __func__, __LINE__);
+    best = bf->distance[v];
+    from = UNKNOW_VETEX;
+    for (e = rcsr->offsets[v]; e < rcsr->offsets[v + 1]; ++e)
+    {
+      if (bf->distance[rcsr->dest[e]] == GRAPH_DIST_INFINITY)
+        continue;
+
+      temp_dist = bf->distance[rcsr->dest[e]] + rcsr->weight[e];
+      if (temp_dist < best)
+      {
+        best = temp_dist;
+        from = rcsr->dest[e];
+      }
+    }
+
+    bf->next[v] = best;
+    if (from != UNKNOW_VETEX)
+    {
+      bf->prev_node[v]  = from;
+      bf->updated[id]   = 1;
+    }
+  }
+}
+
+/*
+ * Jacobi passes split over the pool: every pass reads the distances of the
+ * previous one, so after k passes each vertex holds its best path of at
+ * most k edges. It converges within V - 1 passes unless a negative cycle is
+ * reachable, which is when pass V still finds an update.
+ */
+static int bellman_ford_parallel (GraphCSR *csr, WorkerPool *pool,
+                                  graph_dist_t *distance, int *prev_node)
+{
+  BellmanFordPass bf;
+  graph_dist_t *swap;
+  int pass, t, updated, num_workers, rv = -1;
+
+  num_workers = (pool) ? pool->numWorkers : 1;
+  memset (&bf, 0, sizeof (BellmanFordPass));
+  bf.rcsr       = graph_csr_reverse (csr);
+  bf.next       = (graph_dist_t *)malloc(csr->numVertices * sizeof (graph_dist_t));
+  bf.updated    = (int *)calloc(num_workers, sizeof (int));
+  bf.distance   = distance;
+  bf.prev_node  = prev_node;
+  if (! bf.rcsr || ! bf.next || ! bf.updated)
+  {
+    printf ("[%s,%d] Fail to allocate memory for parallel Bellman-Ford\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  rv = 0;
+  for (pass = 1; pass <= csr->numVertices; ++pass)
+  {
+    if (pool)
+      wpool_run (pool, bellman_ford_pass_task, &bf);
+    else
+      bellman_ford_pass_task (0, 1, &bf);
+
+    swap        = bf.distance;
+    bf.distance = bf.next;
+    bf.next     = swap;
+
+    updated = 0;
+    for (t = 0; t < num_workers; ++t)
+      updated |= bf.updated[t];
+    if (! updated)
+      break;
+  }
+
+  if (pass > csr->numVertices)
+    rv = 1;
+
+  /* The last pass may have left the result in the scratch array */
+  if (bf.distance != distance)
+  {
+    memcpy (distance, bf.distance, csr->numVertices * sizeof (graph_dist_t));
+    bf.next = bf.distance;
+  }
+
+EXIT:
+  if (bf.next)    free (bf.next);
+  if (bf.updated) free (bf.updated);
+  return rv;
+}
+
+/*
+ * Single source shortest paths that allow negative weights.
+ * Return -1 on error or when a negative cycle is reachable from src.
+ * pool is only used by BELLMAN_FORD_PARALLEL and may be NULL.
+ */
+int bellman_ford_mode (GraphCSR *csr, int src, BellmanFordMode mode, struct WorkerPool *pool,
+                       graph_dist_t *distance, int *prev_node)
+{
+  int i, i_src, rv;
+
+  if (!csr || !csr->numVertices
+      || !distance || !prev_node)
+    return -1;
+
+  i_src = graph_csr_get_vertex_by_id (csr, src);
+  if (i_src == UNKNOW_VETEX)
+  {
+    printf ("[%s,%d] Error: There is no edge with src %d in graph\n",
+           __func__, __LINE__, src);
     return -1;
   }
 
-  visited_vertices = (int *)calloc(graph->numVertices, sizeof(int));
-  if (! visited_vertices)
+  for (i = 0; i < csr->numVertices; ++i)
   {
-    printf ("[%s,%d] Error: Fail to allocate memory for visited array\n", __func__, __LINE__);
+    if (i != i_src)
+      distance[i]     = GRAPH_DIST_INFINITY;
+    else
+      distance[i]     = 0;
+
+    prev_node[i]  = UNKNOW_VETEX;
+  }
+
+  switch (mode)
+  {
+    case BELLMAN_FORD_FULL:
+      rv = bellman_ford_passes (csr, 0, distance, prev_node);
+      break;
+    case BELLMAN_FORD_EARLY_EXIT:
+      rv = bellman_ford_passes (csr, 1, distance, prev_node);
+      break;
+    case BELLMAN_FORD_SPFA:
+      rv = bellman_ford_spfa (csr, i_src, distance, prev_node);
+      break;
+    case BELLMAN_FORD_PARALLEL:
+      rv = bellman_ford_parallel (csr, pool, distance, prev_node);
+      break;
+    default:
+      printf ("[%s,%d] Error: Unknown Bellman-Ford mode %d\n", __func__, __LINE__, mode);
+      return -1;
+  }
+
+  if (rv == 1)
+  {
+    printf ("[%s,%d] Error: Detected negative weight cycles!\n", __func__, __LINE__);
     return -1;
   }
-  memset((void *)visited_vertices, 0, graph->numVertices * sizeof(int));
 
-  stack = stack_create (graph->numVertices);
-  if (! stack)
+  return rv;
+}
+
+int bellman_ford (GraphCSR *csr, int src, graph_dist_t *distance, int *prev_node)
+{
+  return bellman_ford_mode (csr, src, BELLMAN_FORD_EARLY_EXIT, NULL, distance, prev_node);
+}
+
+int graph_csr_bellman_ford (GraphCSR *csr, int src)
+{
+  graph_dist_t *distance;
+  int *prev_node, rv, i;
+
+  if (!csr || !csr->numVertices)
+    return -1;
+
+  distance = (graph_dist_t *)malloc(csr->numVertices * sizeof (graph_dist_t));
+  if (!distance)
   {
-    printf ("[%s,%d] Error: Fail to allocate memory for stack\n", __func__, __LINE__);
+    printf ("[%s,%d] Fail to allocated memory for distance array!\n",
+            __func__, __LINE__);
     return -1;
   }
 
-  /* Push the first vertex into the stack */
-  stack_push (stack, &start_vertex);
-  visited_vertices[start_vertex] = 1;
-  printf ("Visited ");
+  prev_node = (int *)malloc(csr->numVertices * sizeof (int));
+  if (!prev_node)
+  {
+    printf ("[%s,%d] Fail to allocated memory for distance array!\n",
+            __func__, __LINE__);
+    free (distance);
+    return -1;
+  }
 
-  while (! stack_is_empty (stack))
+  rv = bellman_ford (csr, src, distance, prev_node);
+  if (rv == 0)
   {
-    /* Pop the top of the stack */
-    top = (int *)stack_pop (stack);
-    if (top)
+    for (i = 0; i < csr->numVertices; i++)
     {
-      printf (" -> %d", *top);
-      i = graph_get_vertex_by_id (graph, *top);
-      if (i == UNKNOW_VETEX)
-        goto EXIT;
-
-      Vertex *temp = graph->vertices[i];
-      /* Push unvisited adjacencies into the stack */
-      while (temp)
+      if (csr->ids[i] != UNKNOW_VETEX
+          && csr->ids[i] != src)
       {
-        if (visited_vertices[temp->edge.dest] == 0)
-        {
-          visited_vertices[temp->edge.dest] = 1;
-          stack_push (stack, &temp->edge.dest);
-        }
-        temp = temp->next;
+        if (distance[i] == GRAPH_DIST_INFINITY)
+          printf ("\nDistance from %d to %d: INF\n", src, csr->ids[i]);
+        else
+          printf ("\nDistance from %d to %d: %lld\n", src, csr->ids[i], (long long)distance[i]);
+        graph_csr_print_path (csr, prev_node, src, csr->ids[i]);
       }
     }
   }
 
-EXIT:
-  printf ("\n");
+  free (distance);
+  free (prev_node);
 
-  /* Clean up */
-  stack_delete (stack);
-  free (visited_vertices);
-  return 0;
+  return rv;
 }
 
-int graph_BFS (Graph* graph, int start_vertex)
+int graph_bellman_ford (Graph *graph, int src)
 {
-  int *visited_vertices = NULL;
-  Queue *queue = NULL;
-  int *front, i;
+  GraphCSR *csr = NULL;
+  int rv;
 
-  if (! graph)
+  csr = graph_csr_build (graph);
+  if (! csr)
   {
-    printf ("[%s,%d] Error, Graph is NULL\n", __func__, __LINE__);
+    printf ("[%s,%d] Error, Fail to build CSR snapshot\n", __func__, __LINE__);
     return -1;
   }
 
-  visited_vertices = (int *)calloc(graph->numVertices, sizeof(int));
-  if (! visited_vertices)
+  rv = graph_csr_bellman_ford (csr, src);
+  graph_csr_deinit (csr);
+  return rv;
+}
+
+/*
+ * Single source paths on a DAG, one relaxation of every arc in topological
+ * order, negative weights are fine. DAG_LONGEST_PATH keeps the heaviest path
+ * instead, the critical path of a schedule. Same distance / prev_node
+ * contract as bellman_ford, unreachable slots stay at GRAPH_DIST_INFINITY in
+ * both modes. Return -1 on error or if the graph has a cycle.
+ */
+int dag_shortest_path (GraphCSR *csr, int src, DagPathMode mode,
+                       graph_dist_t *distance, int *prev_node)
+{
+  int *order = NULL, i, i_src, u, v, e, rv = -1;
+  graph_dist_t temp_dist;
+
+  if (!csr || !csr->numVertices
+      || !distance || !prev_node)
+    return -1;
+
+  i_src = graph_csr_get_vertex_by_id (csr, src);
+  if (i_src == UNKNOW_VETEX)
   {
-    printf ("[%s,%d] Error: Fail to allocate memory for visited array\n", __func__, __LINE__);
+    printf ("[%s,%d] Error: There is no edge with src %d in graph\n",
+           __func__, __LINE__, src);
     return -1;
   }
 
-  queue = queue_create (20);
-  if (! queue)
+  order = (int *)malloc(csr->numVertices * sizeof (int));
+  if (! order)
   {
-    printf ("[%s,%d] Error: Fail to allocate memory for queue\n", __func__, __LINE__);
+    printf ("[%s,%d] Fail to allocate memory for topological order\n", __func__, __LINE__);
     return -1;
   }
 
-  /* Push the first vertex into the stack */
-  queue_enqueue (queue, &start_vertex);
-  visited_vertices[start_vertex] = 1;
-  printf ("Visited ");
+  /* Fails on a cycle, which is also the acyclicity check */
+  if (topological_sort (csr, order) != 0)
+    goto EXIT;
 
-  while (! queue_is_empty (queue))
+  for (i = 0; i < csr->numVertices; ++i)
   {
-    /* Pop the top of the stack */
-    queue_dequeue (queue, (void **)&front);
-    if (front)
-    {
-      printf (" -> %d", *front);
-      i = graph_get_vertex_by_id (graph, *front);
-      if (i == UNKNOW_VETEX)
-        goto EXIT;
+    distance[i]   = GRAPH_DIST_INFINITY;
+    prev_node[i]  = UNKNOW_VETEX;
+  }
+  distance[i_src] = 0;
 
-      Vertex *temp = graph->vertices[i];
-      /* Push unvisited adjacencies into the stack */
-      while (temp)
+  /* Nothing before src in the order is reachable from it */
+  for (i = 0; order[i] != i_src; ++i)
+    ;
+
+  for (; i < csr->numVertices; ++i)
+  {
+    u = order[i];
+    if (distance[u] == GRAPH_DIST_INFINITY)
+      continue;
+
+    for (e = csr->offsets[u]; e < csr->offsets[u + 1]; ++e)
+    {
+      v         = csr->dest[e];
+      temp_dist = distance[u] + csr->weight[e];
+      if (distance[v] == GRAPH_DIST_INFINITY
+          || (mode == DAG_LONGEST_PATH && temp_dist > distance[v])
+          || (mode == DAG_SHORTEST_PATH && temp_dist < distance[v]))
       {
-        if (visited_vertices[temp->edge.dest] == 0)
-        {
-          visited_vertices[temp->edge.dest] = 1;
-          queue_enqueue (queue, &temp->edge.dest);
-        }
-        temp = temp->next;
+        distance[v]   = temp_dist;
+        prev_node[v]  = u;
       }
     }
   }
+  rv = 0;
 
 EXIT:
-  printf ("\n");
-
-  /* Clean up */
-  queue_delete (queue);
-  free (visited_vertices);
-  return 0;
+  free (order);
+  return rv;
 }
 
-int graph_path_node_cmp (void *p1, void *p2)
+int graph_csr_dag_shortest_path (GraphCSR *csr, int src, DagPathMode mode)
 {
-  PathNode *path1 = (PathNode *)p1;
-  PathNode *path2 = (PathNode *)p2;
-
-  if (!path1 && !path2)
-    return 0;
+  graph_dist_t *distance = NULL;
+  int *prev_node = NULL, rv = -1, i;
 
-  if (!path1 || !path2)
+  if (!csr || !csr->numVertices)
     return -1;
 
-  if (*(path1->dist) > *(path2->dist))
-    return 1;
-  else if (*(path1->dist) < *(path2->dist))
-    return -1;
-  else
+  distance  = (graph_dist_t *)malloc(csr->numVertices * sizeof (graph_dist_t));
+  prev_node = (int *)malloc(csr->numVertices * sizeof (int));
+  if (!distance || !prev_node)
   {
-    if (path1->V->edge.weight > path2->V->edge.weight)
-      return 1;
-    else if (path1->V->edge.weight < path2->V->edge.weight)
-      return -1;
-    else
+    printf ("[%s,%d] Fail to allocated memory for distance array!\n",
+            __func__, __LINE__);
+    goto EXIT;
+  }
+
+  rv = dag_shortest_path (csr, src, mode, distance, prev_node);
+  if (rv == 0)
+  {
+    for (i = 0; i < csr->numVertices; i++)
     {
-      if (path1->V->edge.dest > path2->V->edge.dest)
-        return 1;
-      else if (path1->V->edge.dest < path2->V->edge.dest)
-        return -1;
-      else
-        return 0;
+      if (csr->ids[i] != UNKNOW_VETEX
+          && csr->ids[i] != src)
+      {
+        if (distance[i] == GRAPH_DIST_INFINITY)
+          printf ("\nDistance from %d to %d: INF\n", src, csr->ids[i]);
+        else
+          printf ("\nDistance from %d to %d: %lld\n", src, csr->ids[i], (long long)distance[i]);
+        graph_csr_print_path (csr, prev_node, src, csr->ids[i]);
+      }
     }
   }
 
-  return 0;
+EXIT:
+  if (distance)   free (distance);
+  if (prev_node)  free (prev_node);
+  return rv;
 }
 
-int graph_path_node_dump (void *p)
+int graph_dag_shortest_path (Graph *graph, int src, DagPathMode mode)
 {
-  PathNode *path = (PathNode *)p;
-  if (! path)
+  GraphCSR *csr = NULL;
+  int rv;
+
+  csr = graph_csr_build (graph);
+  if (! csr)
+  {
+    printf ("[%s,%d] Error, Fail to build CSR snapshot\n", __func__, __LINE__);
     return -1;
+  }
 
-  printf ("(s:%d,d:%d,w:%d)", path->V->id, path->V->edge.dest, path->V->edge.weight);
+  rv = graph_csr_dag_shortest_path (csr, src, mode);
+  graph_csr_deinit (csr);
+  return rv;
 }
 
-static void stack_dump_int (void *data)
+/*
+ * Flat copy of the edges, each one once with src < dest (slots) in an
+ * undirected snapshot, every arc of a directed one. Return the array and
+ * its length in num_edges, NULL if there is no edge.
+ */
+GraphEdge* graph_csr_edge_array (GraphCSR *csr, int *num_edges)
 {
-  int *num = NULL;
+  GraphEdge *edges = NULL;
+  int i, e, n = 0;
 
-  if (! data)
-    return;
+  if (! csr || ! num_edges)
+    return NULL;
 
-  num = (int *)data;
-  printf ("-> %d ", *num);
-  return;
+  for (i = 0; i < csr->numVertices; ++i)
+  {
+    for (e = csr->offsets[i]; e < csr->offsets[i + 1]; ++e)
+    {
+      if (csr->directed || i < csr->dest[e])
+        n++;
+    }
+  }
+
+  /* num_edges is set even if the allocation fails, NULL with 0 edges is not an error */
+  *num_edges = n;
+  if (! n)
+    return NULL;
+
+  edges = (GraphEdge *)malloc(n * sizeof (GraphEdge));
+  if (! edges)
+  {
+    printf ("[%s,%d] Fail to allocate memory for edge array\n", __func__, __LINE__);
+    return NULL;
+  }
+
+  n = 0;
+  for (i = 0; i < csr->numVertices; ++i)
+  {
+    for (e = csr->offsets[i]; e < csr->offsets[i + 1]; ++e)
+    {
+      if (csr->directed || i < csr->dest[e])
+      {
+        edges[n].src    = i;
+        edges[n].dest   = csr->dest[e];
+        edges[n].weight = csr->weight[e];
+        n++;
+      }
+    }
+  }
+
+  return edges;
 }
 
-int graph_print_path_recursive (Graph *graph, int *prev_node, int i_src, int i_dest)
+/*
+ * Stable LSD radix sort by weight, 8 bits per pass. The sign bit is flipped
+ * so negative weights come first, and a pass is skipped when every key
+ * has the same byte there.
+ */
+int graph_edge_sort (GraphEdge *edges, int num_edges)
 {
-  if (! graph || ! prev_node)
+  GraphEdge *tmp = NULL, *from = edges, *to, *swap;
+  unsigned int key;
+  int count[256], shift, i, b, sum, pos;
+
+  if (! edges || num_edges < 0)
+    return -1;
+
+  if (num_edges < 2)
+    return 0;
+
+  tmp = (GraphEdge *)malloc(num_edges * sizeof (GraphEdge));
+  if (! tmp)
+  {
+    printf ("[%s,%d] Fail to allocate memory for radix sort\n", __func__, __LINE__);
     return -1;
+  }
+  to = tmp;
+
+  for (shift = 0; shift < 32; shift += 8)
+  {
+    memset (count, 0, sizeof (count));
+    for (i = 0; i < num_edges; ++i)
+    {
+      key = (unsigned int)from[i].weight ^ 0x80000000u;
+      count[(key >> shift) & 0xFF]++;
+    }
+
+    key = (unsigned int)from[0].weight ^ 0x80000000u;
+    if (count[(key >> shift) & 0xFF] == num_edges)
+      continue;
+
+    for (b = 0, sum = 0; b < 256; ++b)
+    {
+      pos       = count[b];
+      count[b]  = sum;
+      sum      += pos;
+    }
+
+    for (i = 0; i < num_edges; ++i)
+    {
+      key = (unsigned int)from[i].weight ^ 0x80000000u;
+      to[count[(key >> shift) & 0xFF]++] = from[i];
+    }
 
-  if (prev_node[i_dest] == i_src)
-    return i_dest;
+    swap  = from;
+    from  = to;
+    to    = swap;
+  }
+
+  if (from != edges)
+    memcpy (edges, from, num_edges * sizeof (GraphEdge));
 
-  if (graph->vertices[i_dest])
-    printf ("-> %d ", graph->vertices[graph_print_path_recursive (graph, prev_node, i_src, prev_node[i_dest])]->id);
+  free (tmp);
+  return 0;
 }
 
-int graph_print_path (Graph *graph, int *prev_node, int src, int dest)
+/* Add the sorted edges that join two trees, stop once the forest is a tree */
+static int kruskal_add_edges (GraphCSR *csr, Graph* minimum_span_tree, DisjointSet *set,
+                              GraphEdge *edges, int num_edges, int *tree_edges, int max_edges)
 {
-  int prev, i_dest, i_src, rv, *temp = NULL, i;
+  int e;
 
-  if (!graph || !prev_node)
-    return -1;
+  for (e = 0; e < num_edges && *tree_edges < max_edges; ++e)
+  {
+    if (dset_union (set, edges[e].src, edges[e].dest) != 1)
+      continue;
 
-  i_dest = graph_get_vertex_by_id (graph, dest);
-  if (i_dest == UNKNOW_VETEX)
+    if (graph_add_edge (minimum_span_tree, csr->ids[edges[e].src],
+                        csr->ids[edges[e].dest], edges[e].weight) != 0)
+      return -1;
+    (*tree_edges)++;
+  }
+
+  return 0;
+}
+
+/* A spanning forest has one edge less than vertices per component */
+static int kruskal_max_edges (GraphCSR *csr)
+{
+  int i, live = 0;
+
+  for (i = 0; i < csr->numVertices; ++i)
   {
-    printf ("[%s,%d] There no vertex %d in the graph!\n", __func__, __LINE__, dest);
-    return 0;
+    if (csr->ids[i] != UNKNOW_VETEX)
+      live++;
   }
 
-  i_src = graph_get_vertex_by_id (graph, src);
-  if (i_src == UNKNOW_VETEX)
+  return (live) ? live - 1 : 0;
+}
+
+int kruskal (GraphCSR *csr, Graph* minimum_span_tree)
+{
+  DisjointSet *set = NULL;
+  GraphEdge *edges = NULL;
+  int num_edges, tree_edges = 0, rv = -1;
+
+  if ((! csr) || (! minimum_span_tree)
+      || (! csr->numVertices)
+      || (! minimum_span_tree->vertices))
+    return -1;
+
+  if (csr->directed)
   {
-    printf ("[%s,%d] There no vertex %d in the graph!\n", __func__, __LINE__, src);
-    return 0;
+    printf ("[%s,%d] Spanning tree needs an undirected graph\n", __func__, __LINE__);
+    return -1;
   }
 
-  printf ("Path from %d to %d: %d ", src, dest, src);
-  graph_print_path_recursive (graph, prev_node, i_src, i_dest);
-  printf ("-> %d\n", dest);
+  edges = graph_csr_edge_array (csr, &num_edges);
+  if (! edges)
+    return (num_edges) ? -1 : 0;
+
+  set = dset_create (csr->numVertices);
+  if (! set || graph_edge_sort (edges, num_edges) != 0)
+    goto EXIT;
+
+  rv = kruskal_add_edges (csr, minimum_span_tree, set, edges, num_edges,
+                          &tree_edges, kruskal_max_edges (csr));
+
+EXIT:
+  dset_deinit (set);
+  free (edges);
+  return rv;
+}
+
+/*
+ * Filter-Kruskal
+ * Split the edges around a pivot weight, solve the light half, then drop
+ * the heavy edges whose ends are already connected before solving the
+ * rest. Both the split and the filter are stable compactions done in
+ * parallel: each worker counts its chunk, the counts are prefix summed and
+ * every worker scatters its chunk to its own place.
+ */
+#define KRUSKAL_FILTER_MIN_EDGES  4096
+#define KRUSKAL_SPLIT_PIVOT       0   /* weight <= pivot goes left */
+#define KRUSKAL_SPLIT_FILTER      1
+#define KRUSKAL_SPLIT_BELOW       2   /* weight < pivot goes left */
+
+typedef struct KruskalSplit
+{
+  DisjointSet *set;
+  GraphEdge *from;
+  GraphEdge *to;
+  int numEdges;
+  int pivot;
+  int mode;
+  int scatter;          /* 0 : count phase, 1 : scatter phase */
+  int *numLeft;         /* per worker, edges kept (filter) or not above the pivot (split) */
+  int *numRight;
+  int *posLeft;
+  int *posRight;
+} KruskalSplit;
+
+static int kruskal_split_left (KruskalSplit *split, GraphEdge *edge)
+{
+  if (split->mode == KRUSKAL_SPLIT_PIVOT)
+    return edge->weight <= split->pivot;
+  if (split->mode == KRUSKAL_SPLIT_BELOW)
+    return edge->weight < split->pivot;
 
-  return 0;
+  /* No union runs during the filter, the read only find is safe to share */
+  return dset_find_root (split->set, edge->src) != dset_find_root (split->set, edge->dest);
 }
 
-int dijkstra (Graph *graph, int src, int *distance, int *prev_node,
-              int (*pq_cmp)(void *, void *), int (*pq_node_dump)(void *))
+static void kruskal_split_task (int id, int num_workers, void *arg)
 {
-  int i, i_dest, temp_dist;
-  PriorityQueue *pq = NULL;
-  Vertex *min = NULL, *temp;
-  PathNode *path = NULL;
-
-  if (!graph || !graph->vertices || !graph->numVertices
-      || !distance || !prev_node)
-    return -1;
+  KruskalSplit *split = (KruskalSplit *)arg;
+  int e, begin, end, left, right;
 
-  pq = pq_create (graph->numVertices, pq_cmp, pq_node_dump);
-  if (! pq)
+  wpool_range (id, num_workers, split->numEdges, &begin, &end);
+  if (! split->scatter)
   {
-    printf ("[%s,%d] Fail to create priority queue!\n",
-            __func__, __LINE__);
-    return -1;
-  }
+    left = 0;
+    for (e = begin; e < end; ++e)
+      left += kruskal_split_left (split, &split->from[e]);
 
-  path = (PathNode *)calloc(graph->numVertices, sizeof(PathNode));
-  if (! path)
-  {
-    printf ("[%s,%d] Error: Can not allocate memory for path!\n", __func__, __LINE__);
-    return -1;
+    split->numLeft[id]  = left;
+    split->numRight[id] = (end - begin) - left;
+    return;
   }
 
-  for (i = 0; i < graph->numVertices; ++i)
+  left  = split->posLeft[id];
+  right = split->posRight[id];
+  for (e = begin; e < end; ++e)
   {
-    if (graph->vertices[i]
-        && graph->vertices[i]->id != src)
-      distance[i]     = INFINITY;
-    else
-      distance[i]     = 0;
-
-    prev_node[i]    = UNKNOW_VETEX;
+    if (kruskal_split_left (split, &split->from[e]))
+      split->to[left++] = split->from[e];
+    else if (split->mode != KRUSKAL_SPLIT_FILTER)
+      split->to[right++] = split->from[e];
   }
+}
 
-  /* Update distance for src's neighbors */
-  i = graph_get_vertex_by_id (graph, src);
-  if (i == UNKNOW_VETEX)
-  {
-    printf ("[%s,%d] Error: There is no edge with src %d in graph\n",
-           __func__, __LINE__, src);
-    goto EXIT;
-  }
+/* Stable split of from into to, return the number of edges that went left */
+static int kruskal_split (KruskalSplit *split, WorkerPool *pool, GraphEdge *from, GraphEdge *to,
+                          int num_edges, int mode, int pivot)
+{
+  int t, num_workers = (pool) ? pool->numWorkers : 1, left = 0, pos_left, pos_right;
 
-  temp = graph->vertices[i];
-  while (temp)
-  {
-    i = graph_get_vertex_by_id (graph, temp->edge.dest);
-    if (i != UNKNOW_VETEX)
-    {
-      distance[i]   = temp->edge.weight;
-      prev_node[i]  = graph_get_vertex_by_id (graph, src);
-    }
+  split->from     = from;
+  split->to       = to;
+  split->numEdges = num_edges;
+  split->mode     = mode;
+  split->pivot    = pivot;
 
-    temp = temp->next;
-  }
+  split->scatter = 0;
+  if (pool)
+    wpool_run (pool, kruskal_split_task, split);
+  else
+    kruskal_split_task (0, 1, split);
 
-  for (i = 0; i < graph->numVertices; ++i)
-  {
-    if (graph->vertices[i]
-        && graph->vertices[i]->id != src)
-    {
-      path[i].dist    = &distance[i];
-      path[i].V       = graph->vertices[i];
-      pq_add (pq, &path[i]);
-    }
-  }
+  for (t = 0; t < num_workers; ++t)
+    left += split->numLeft[t];
 
-  while (! pq_is_empty (pq))
+  pos_left  = 0;
+  pos_right = left;
+  for (t = 0; t < num_workers; ++t)
   {
-    /* Get the vertex with closest distance to src */
-    min = ((PathNode *)pq_extract_top(pq))->V;
-    while (min)
-    {
-      i = graph_get_vertex_by_id (graph, min->id);
-      if (i == UNKNOW_VETEX)
-        continue;
+    split->posLeft[t]   = pos_left;
+    split->posRight[t]  = pos_right;
+    pos_left           += split->numLeft[t];
+    pos_right          += split->numRight[t];
+  }
 
-      i_dest = graph_get_vertex_by_id (graph, min->edge.dest);
-      if (i_dest == UNKNOW_VETEX)
-        continue;
+  split->scatter = 1;
+  if (pool)
+    wpool_run (pool, kruskal_split_task, split);
+  else
+    kruskal_split_task (0, 1, split);
 
-      temp_dist = distance[i] + min->edge.weight;
-      if (temp_dist < distance[i_dest])
-      {
-        distance[i_dest]  = temp_dist;
-        prev_node[i_dest] = i;
-      }
-      min = min->next;
-    }
-  }
+  return left;
+}
 
-EXIT:
-  free (path);
-  pq_deinit (pq);
+/* Median of the first, middle and last weights */
+static int kruskal_pivot (GraphEdge *edges, int num_edges)
+{
+  int a = edges[0].weight, b = edges[num_edges / 2].weight, c = edges[num_edges - 1].weight;
 
-  return 0;
+  if ((a <= b && b <= c) || (c <= b && b <= a))
+    return b;
+  if ((b <= a && a <= c) || (c <= a && a <= b))
+    return a;
+  return c;
 }
 
-int graph_dijkstra (Graph *graph, int src)
+static int kruskal_filter_rec (GraphCSR *csr, Graph* minimum_span_tree, DisjointSet *set,
+                               KruskalSplit *split, WorkerPool *pool, GraphEdge *edges,
+                               GraphEdge *scratch, int num_edges, int *tree_edges, int max_edges)
 {
-  int *distance, *prev_node, rv, i;
+  int left, kept, pivot;
 
-  if (!graph || !graph->vertices || !graph->numVertices)
-    return -1;
+  if (! num_edges || *tree_edges == max_edges)
+    return 0;
 
-  distance = (int *)malloc(graph->numVertices * sizeof (int));
-  if (!distance)
+  if (num_edges > KRUSKAL_FILTER_MIN_EDGES)
   {
-    printf ("[%s,%d] Fail to allocated memory for distance array!\n",
-            __func__, __LINE__);
-    return -1;
+    pivot = kruskal_pivot (edges, num_edges);
+    left  = kruskal_split (split, pool, edges, scratch, num_edges, KRUSKAL_SPLIT_PIVOT, pivot);
+
+    /*
+     * Every weight is at most the pivot, so the pivot is the largest one.
+     * The split is stable and left edges untouched, split them again with
+     * the pivot weight on the right.
+     */
+    if (left == num_edges)
+      left = kruskal_split (split, pool, edges, scratch, num_edges, KRUSKAL_SPLIT_BELOW, pivot);
+
+    /* Every weight equal to the pivot, already in order */
+    if (! left)
+      return kruskal_add_edges (csr, minimum_span_tree, set, edges, num_edges,
+                                tree_edges, max_edges);
+
+    if (kruskal_filter_rec (csr, minimum_span_tree, set, split, pool, scratch, edges,
+                            left, tree_edges, max_edges) != 0)
+      return -1;
+
+    kept = kruskal_split (split, pool, scratch + left, edges + left, num_edges - left,
+                          KRUSKAL_SPLIT_FILTER, 0);
+    return kruskal_filter_rec (csr, minimum_span_tree, set, split, pool, edges + left,
+                               scratch + left, kept, tree_edges, max_edges);
   }
 
-  prev_node = (int *)malloc(graph->numVertices * sizeof (int));
-  if (!prev_node)
+  if (graph_edge_sort (edges, num_edges) != 0)
+    return -1;
+
+  return kruskal_add_edges (csr, minimum_span_tree, set, edges, num_edges,
+                            tree_edges, max_edges);
+}
+
+/* Same result as kruskal(), pool may be NULL to run on the calling thread only */
+int kruskal_filter (GraphCSR *csr, Graph* minimum_span_tree, struct WorkerPool *pool)
+{
+  KruskalSplit split;
+  DisjointSet *set = NULL;
+  GraphEdge *edges = NULL, *scratch = NULL;
+  int num_edges, num_workers, tree_edges = 0, rv = -1;
+
+  if ((! csr) || (! minimum_span_tree)
+      || (! csr->numVertices)
+      || (! minimum_span_tree->vertices))
+    return -1;
+
+  if (csr->directed)
   {
-    printf ("[%s,%d] Fail to allocated memory for distance array!\n",
-            __func__, __LINE__);
+    printf ("[%s,%d] Spanning tree needs an undirected graph\n", __func__, __LINE__);
     return -1;
   }
 
-  rv = dijkstra (graph, src, distance, prev_node, graph_path_node_cmp, graph_path_node_dump);
-  if (rv != 0)
-    return rv;
-
-  for (i = 0; i < graph->numVertices; i++)
+  edges = graph_csr_edge_array (csr, &num_edges);
+  if (! edges)
+    return (num_edges) ? -1 : 0;
+
+  num_workers = (pool) ? pool->numWorkers : 1;
+  memset (&split, 0, sizeof (KruskalSplit));
+  set             = dset_create (csr->numVertices);
+  scratch         = (GraphEdge *)malloc(num_edges * sizeof (GraphEdge));
+  split.numLeft   = (int *)malloc(num_workers * sizeof (int));
+  split.numRight  = (int *)malloc(num_workers * sizeof (int));
+  split.posLeft   = (int *)malloc(num_workers * sizeof (int));
+  split.posRight  = (int *)malloc(num_workers * sizeof (int));
+  split.set       = set;
+  if (! set || ! scratch || ! split.numLeft || ! split.numRight
+      || ! split.posLeft || ! split.posRight)
   {
-    if (graph->vertices[i]
-        && graph->vertices[i]->id != src)
-    {
-      printf ("\nDistance from %d to %d: %d\n", src, graph->vertices[i]->id, distance[i]);
-      graph_print_path (graph, prev_node, src, graph->vertices[i]->id);
-    }
+    printf ("[%s,%d] Fail to allocate memory for Filter-Kruskal\n", __func__, __LINE__);
+    goto EXIT;
   }
 
-  free (distance);
-  free (prev_node);
+  rv = kruskal_filter_rec (csr, minimum_span_tree, set, &split, pool, edges, scratch,
+                           num_edges, &tree_edges, kruskal_max_edges (csr));
 
-  return 0;
+EXIT:
+  if (split.numLeft)  free (split.numLeft);
+  if (split.numRight) free (split.numRight);
+  if (split.posLeft)  free (split.posLeft);
+  if (split.posRight) free (split.posRight);
+  if (scratch)        free (scratch);
+  dset_deinit (set);
+  free (edges);
+  return rv;
 }
 
-int bellman_ford (Graph *graph, int src, int *distance, int *prev_node)
+int graph_csr_kruskal (GraphCSR *csr)
 {
-  int i, i_dest, temp_dist;
-  Vertex *temp = NULL;
+  Graph *minimum_span_tree = NULL;
+  int rv = -1;
 
-  if (!graph || !graph->vertices || !graph->numVertices
-      || !distance || !prev_node)
+  if (! csr)
     return -1;
 
-  if (src >= graph->numVertices)
+  minimum_span_tree = graph_init (csr->numVertices);
+  if (! minimum_span_tree)
   {
-    printf ("Error: src % larger then number of vertices %d\n",
-            src, graph->numVertices);
-    return -1;
+    printf ("[%s,%d] Fail to create minimum spanning tree!\n", __func__, __LINE__);
+    goto EXIT;
   }
-
-  for (i = 0; i < graph->numVertices; ++i)
+  rv = kruskal (csr, minimum_span_tree);
+  if (rv != 0)
   {
-    if (graph->vertices[i]
-        && graph->vertices[i]->id != src)
-      distance[i]     = INFINITY;
-    else
-      distance[i]     = 0;
-
-    prev_node[i]  = UNKNOW_VETEX;
+    printf ("[%s,%d] Fail to perform kruskal algorithm\n", __func__, __LINE__);
+    goto EXIT;
   }
 
-  /* Update distance for src's neighbors */
-  i = graph_get_vertex_by_id (graph, src);
-  if (i == UNKNOW_VETEX)
-  {
-    printf ("[%s,%d] Error: There is no edge with src %d in graph\n",
-           __func__, __LINE__, src);
-    return -1;
-  }
+  printf ("Minimum Spanning Tree:\n");
+  graph_print (minimum_span_tree);
 
-  temp = graph->vertices[i];
-  while (temp)
-  {
-    i_dest = graph_get_vertex_by_id (graph, temp->edge.dest);
-    if (i_dest != UNKNOW_VETEX)
-    {
-      distance[i_dest]   = temp->edge.weight;
-      prev_node[i_dest]  = i;
-    }
+EXIT:
+  if (minimum_span_tree)
+    graph_deinit (minimum_span_tree);
+  minimum_span_tree = NULL;
+  return rv;
+}
 
-    temp = temp->next;
-  }
+int graph_kruskal (Graph *graph)
+{
+  GraphCSR *csr = NULL;
+  int rv;
 
-  for (i = 0; i < graph->numVertices; ++i)
+  csr = graph_csr_build (graph);
+  if (! csr)
   {
-    temp = graph->vertices[i];
-    while (temp)
-    {
-      i = graph_get_vertex_by_id (graph, temp->id);
-      if (i == UNKNOW_VETEX)
-        continue;
-
-      i_dest = graph_get_vertex_by_id (graph, temp->edge.dest);
-      if (i_dest == UNKNOW_VETEX)
-        continue;
-
-      temp_dist = distance[i] + temp->edge.weight;
-      if (temp_dist < distance[i_dest])
-      {
-        distance[i_dest]  = temp_dist;
-        prev_node[i_dest] = i;
-      }
-      temp = temp->next;
-    }
+    printf ("[%s,%d] Error, Fail to build CSR snapshot\n", __func__, __LINE__);
+    return -1;
   }
 
-  /* Detect negative weight cycle */
-  for (i = 0; i < graph->numVertices; ++i)
-  {
-    temp = graph->vertices[i];
-    while (temp)
-    {
-      i = graph_get_vertex_by_id (graph, temp->id);
-      if (i == UNKNOW_VETEX)
-        continue;
-
-      i_dest = graph_get_vertex_by_id (graph, temp->edge.dest);
-      if (i_dest == UNKNOW_VETEX)
-        continue;
+  rv = graph_csr_kruskal (csr);
+  graph_csr_deinit (csr);
+  return rv;
+}
 
-      temp_dist = distance[i] + temp->edge.weight;
-      if (temp_dist < distance[i_dest])
-      {
-        printf ("[%s,%d] Error: Detected negative weight cycles!\n", __func__, __LINE__);
-        return -1;
-      }
-      temp = temp->next;
-    }
-  }
+/*
+ * Boruvka MST
+ * Every round each component picks its lightest outgoing edge, with ties
+ * broken by edge index so the picks never close a cycle, and all picks are
+ * merged through the lock-free union-find. The edges are kept in a fixed
+ * array and the edges still crossing components in a compacted index list,
+ * so tree edges can be flagged by their index and added in a stable order.
+ */
+#define BORUVKA_NO_EDGE   UINT64_MAX
+
+typedef struct Boruvka
+{
+  GraphEdge *edges;
+  DisjointSet *set;
+  int numVertices;
+  int *comp;            /* component of each vertex during the round */
+  uint64_t *best;       /* lightest edge key per component */
+  char *inTree;
+  int *alive;           /* indexes of the edges that may still cross */
+  int *next;            /* compacted alive list for the next round */
+  char *keep;
+  int numAlive;
+  int *numKept;         /* per worker */
+  int *posKept;
+  int *numUnions;
+} Boruvka;
+
+static void boruvka_pick (uint64_t *best, uint64_t key)
+{
+  uint64_t current = __atomic_load_n (best, __ATOMIC_RELAXED);
 
-  return 0;
+  while (key < current
+         && ! __atomic_compare_exchange_n (best, &current, key, 1,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
 }
 
-int graph_bellman_ford (Graph *graph, int src)
+/* Lightest edge per component, and mark the edges that still cross */
+static void boruvka_min_task (int id, int num_workers, void *arg)
 {
-  int *distance, *prev_node, rv, i;
-
-  if (!graph || !graph->vertices || !graph->numVertices)
-    return -1;
+  Boruvka *b = (Boruvka *)arg;
+  GraphEdge *edge;
+  uint64_t key;
+  int i, begin, end, kept = 0, comp_src, comp_dest;
 
-  distance = (int *)malloc(graph->numVertices * sizeof (int));
-  if (!distance)
+  wpool_range (id, num_workers, b->numAlive, &begin, &end);
+  for (i = begin; i < end; ++i)
   {
-    printf ("[%s,%d] Fail to allocated memory for distance array!\n",
-            __func__, __LINE__);
-    return -1;
+    edge      = &b->edges[b->alive[i]];
+    comp_src  = b->comp[edge->src];
+    comp_dest = b->comp[edge->dest];
+    b->keep[i] = (comp_src != comp_dest);
+    if (! b->keep[i])
+      continue;
+
+    kept++;
+    key = ((uint64_t)((unsigned int)edge->weight ^ 0x80000000u) << 32) | (unsigned int)b->alive[i];
+    boruvka_pick (&b->best[comp_src], key);
+    boruvka_pick (&b->best[comp_dest], key);
   }
 
-  prev_node = (int *)malloc(graph->numVertices * sizeof (int));
-  if (!prev_node)
-  {
-    printf ("[%s,%d] Fail to allocated memory for distance array!\n",
-            __func__, __LINE__);
-    return -1;
-  }
+  b->numKept[id] = kept;
+}
 
-  rv = bellman_ford (graph, src, distance, prev_node);
-  if (rv != 0)
-    return rv;
+static void boruvka_union_task (int id, int num_workers, void *arg)
+{
+  Boruvka *b = (Boruvka *)arg;
+  GraphEdge *edge;
+  int v, e, begin, end, unions = 0;
 
-  for (i = 0; i < graph->numVertices; i++)
+  wpool_range (id, num_workers, b->numVertices, &begin, &end);
+  for (v = begin; v < end; ++v)
   {
-    if (graph->vertices[i]
-        && graph->vertices[i]->id != src)
+    if (b->best[v] == BORUVKA_NO_EDGE)
+      continue;
+
+    /* Both ends may pick the same edge, only the union that links adds it */
+    e = (int)(b->best[v] & 0xFFFFFFFFu);
+    edge = &b->edges[e];
+    if (dset_union_concurrent (b->set, edge->src, edge->dest) == 1)
     {
-      printf ("\nDistance from %d to %d: %d\n", src, graph->vertices[i]->id, distance[i]);
-      graph_print_path (graph, prev_node, src, graph->vertices[i]->id);
+      b->inTree[e] = 1;
+      unions++;
     }
+    b->best[v] = BORUVKA_NO_EDGE;
   }
 
-  free (distance);
-  free (prev_node);
-
-  return 0;
+  b->numUnions[id] = unions;
 }
 
-int graph_edge_cmp (void *v1, void *v2)
+/* New component labels, and the crossing edges packed for the next round */
+static void boruvka_label_task (int id, int num_workers, void *arg)
 {
-  Vertex *vertex_1 = (Vertex *)v1;
-  Vertex *vertex_2 = (Vertex *)v2;
-
-  if (!vertex_1 && !vertex_2)
-    return 0;
+  Boruvka *b = (Boruvka *)arg;
+  int v, i, pos, begin, end;
 
-  if (!vertex_1 || !vertex_2)
-    return 1;
+  wpool_range (id, num_workers, b->numVertices, &begin, &end);
+  for (v = begin; v < end; ++v)
+    b->comp[v] = dset_find_concurrent (b->set, v);
 
-  if ((vertex_1->edge.weight) > (vertex_2->edge.weight))
-    return 1;
-  else if ((vertex_1->edge.weight) < (vertex_2->edge.weight))
-    return -1;
-  else
+  wpool_range (id, num_workers, b->numAlive, &begin, &end);
+  pos = b->posKept[id];
+  for (i = begin; i < end; ++i)
   {
-    if ((vertex_1->edge.dest) > (vertex_2->edge.dest))
-      return 1;
-    else if ((vertex_1->edge.dest) < (vertex_2->edge.dest))
-      return -1;
-    else
-    {
-      if (vertex_1->id > vertex_2->id)
-        return 1;
-      else if (vertex_1->id < vertex_2->id)
-        return -1;
-      else
-        return 0;
-    }
+    if (b->keep[i])
+      b->next[pos++] = b->alive[i];
   }
+}
 
-  return 0;
+static void boruvka_phase (WorkerPool *pool, WorkerTask task, Boruvka *b)
+{
+  if (pool)
+    wpool_run (pool, task, b);
+  else
+    task (0, 1, b);
 }
 
-int kruskal (Graph *graph, Graph* minimum_span_tree)
+/* Same tree as kruskal(), pool may be NULL to run on the calling thread only */
+int boruvka (GraphCSR *csr, Graph* minimum_span_tree, struct WorkerPool *pool)
 {
-  int *visited = NULL;
-  int graph_max_edges = 0, i, rv = 0, i_src, i_dest;
-  PriorityQueue *pq = NULL;
-  Vertex *temp = NULL;
+  Boruvka b;
+  int num_edges, num_workers, i, t, unions, pos, *swap, rv = -1;
 
-  if ((! graph) || (! minimum_span_tree)
-      || (! graph->numVertices) || (! graph->vertices)
-      || (! minimum_span_tree->numVertices) || (! minimum_span_tree->vertices))
+  if ((! csr) || (! minimum_span_tree)
+      || (! csr->numVertices)
+      || (! minimum_span_tree->vertices))
     return -1;
 
-  visited = (int *)malloc(graph->numVertices * sizeof (int));
-  if (! visited)
+  if (csr->directed)
   {
-    printf ("[%s,%d] Fail to allocate memory for visited array\n", __func__, __LINE__);
+    printf ("[%s,%d] Spanning tree needs an undirected graph\n", __func__, __LINE__);
     return -1;
   }
-  memset (visited, 0, graph->numVertices * sizeof (int));
 
-  graph_max_edges = ((graph->numVertices) * (graph->numVertices - 1));
-  pq = pq_create (graph_max_edges, graph_edge_cmp, NULL);
-  if (! pq)
+  memset (&b, 0, sizeof (Boruvka));
+  b.edges = graph_csr_edge_array (csr, &num_edges);
+  if (! b.edges)
+    return (num_edges) ? -1 : 0;
+
+  num_workers   = (pool) ? pool->numWorkers : 1;
+  b.numVertices = csr->numVertices;
+  b.numAlive    = num_edges;
+  b.set         = dset_create (csr->numVertices);
+  b.comp        = (int *)malloc(csr->numVertices * sizeof (int));
+  b.best        = (uint64_t *)malloc(csr->numVertices * sizeof (uint64_t));
+  b.inTree      = (char *)calloc(num_edges, sizeof (char));
+  b.alive       = (int *)malloc(num_edges * sizeof (int));
+  b.next        = (int *)malloc(num_edges * sizeof (int));
+  b.keep        = (char *)malloc(num_edges * sizeof (char));
+  b.numKept     = (int *)malloc(num_workers * sizeof (int));
+  b.posKept     = (int *)malloc(num_workers * sizeof (int));
+  b.numUnions   = (int *)malloc(num_workers * sizeof (int));
+  if (! b.set || ! b.comp || ! b.best || ! b.inTree || ! b.alive || ! b.next
+      || ! b.keep || ! b.numKept || ! b.posKept || ! b.numUnions)
   {
-    printf ("[%s,%d] Fail to create priority queue!\n", __func__, __LINE__);
-    return -1;
+    printf ("[%s,%d] Fail to allocate memory for Boruvka\n", __func__, __LINE__);
+    goto EXIT;
   }
 
-  /* Add all edges into the priority queue */
-  for (i = 0; i < graph->numVertices; ++i)
+  for (i = 0; i < csr->numVertices; ++i)
   {
-    if (graph->vertices[i])
-    {
-      temp = graph->vertices[i];
-      while (temp)
-      {
-        pq_add (pq, (void *)temp);
-
-        temp = temp->next;
-      }
-    }
+    b.comp[i] = i;
+    b.best[i] = BORUVKA_NO_EDGE;
   }
+  for (i = 0; i < num_edges; ++i)
+    b.alive[i] = i;
 
-  temp = NULL;
-  while (! pq_is_empty (pq))
+  while (b.numAlive)
   {
-    temp = (Vertex *)pq_extract_top(pq);
-    if (temp)
-    {
-      i_src   = graph_get_vertex_by_id (graph, temp->id);
-      i_dest  = graph_get_vertex_by_id (graph, temp->edge.dest);
-      if (i_src != UNKNOW_VETEX
-          && i_dest != UNKNOW_VETEX
-          && ! (visited[i_src] == 1
-                && visited[i_dest] == 1))
-      {
-        graph_add_edge (minimum_span_tree, temp->id, temp->edge.dest, temp->edge.weight);
+    boruvka_phase (pool, boruvka_min_task, &b);
+    boruvka_phase (pool, boruvka_union_task, &b);
 
-        visited[i_src]  = 1;
-        visited[i_dest] = 1;
-      }
+    unions = 0;
+    for (t = 0, pos = 0; t < num_workers; ++t)
+    {
+      unions       += b.numUnions[t];
+      b.posKept[t]  = pos;
+      pos          += b.numKept[t];
     }
+    if (! unions)
+      break;
+
+    boruvka_phase (pool, boruvka_label_task, &b);
+    b.numAlive  = pos;
+    swap        = b.alive;
+    b.alive     = b.next;
+    b.next      = swap;
   }
 
-  pq_deinit (pq);
-  if (visited)
-    free (visited);
-  visited = NULL;
-  return 0;
+  for (i = 0; i < num_edges; ++i)
+  {
+    if (b.inTree[i]
+        && graph_add_edge (minimum_span_tree, csr->ids[b.edges[i].src],
+                           csr->ids[b.edges[i].dest], b.edges[i].weight) != 0)
+      goto EXIT;
+  }
+  rv = 0;
 
-ERR_EXIT:
-  pq_deinit (pq);
-  if (visited)
-    free (visited);
-  visited = NULL;
-  return -1;
+EXIT:
+  if (b.comp)       free (b.comp);
+  if (b.best)       free (b.best);
+  if (b.inTree)     free (b.inTree);
+  if (b.alive)      free (b.alive);
+  if (b.next)       free (b.next);
+  if (b.keep)       free (b.keep);
+  if (b.numKept)    free (b.numKept);
+  if (b.posKept)    free (b.posKept);
+  if (b.numUnions)  free (b.numUnions);
+  dset_deinit (b.set);
+  free (b.edges);
+  return rv;
 }
 
-int graph_kruskal (Graph *graph)
+int graph_csr_boruvka (GraphCSR *csr, int num_workers)
 {
   Graph *minimum_span_tree = NULL;
-  int rv = 0;
+  WorkerPool *pool = NULL;
+  int rv = -1;
 
-  if (! graph)
+  if (! csr)
     return -1;
 
-  minimum_span_tree = graph_init (graph->numVertices);
+  if (num_workers > 1)
+    pool = wpool_create (num_workers);
+
+  minimum_span_tree = graph_init (csr->numVertices);
   if (! minimum_span_tree)
   {
     printf ("[%s,%d] Fail to create minimum spanning tree!\n", __func__, __LINE__);
     goto EXIT;
   }
-  rv = kruskal (graph, minimum_span_tree);
+  rv = boruvka (csr, minimum_span_tree, pool);
   if (rv != 0)
   {
-    printf ("[%s,%d] Fail to perform kruskal algorithm\n", __func__, __LINE__);
+    printf ("[%s,%d] Fail to perform boruvka algorithm\n", __func__, __LINE__);
     goto EXIT;
   }
 
@@ -941,107 +4924,125 @@ int graph_kruskal (Graph *graph)
 
 EXIT:
   if (minimum_span_tree)
-    free (minimum_span_tree);
+    graph_deinit (minimum_span_tree);
   minimum_span_tree = NULL;
+  wpool_deinit (pool);
   return rv;
 }
 
-int prim (Graph *graph, Graph* minimum_span_tree, int start)
+int graph_boruvka (Graph *graph, int num_workers)
 {
-  int *visited = NULL;
-  int graph_max_edges = 0, i, rv = 0, i_src, i_dest, i_start;
-  PriorityQueue *pq = NULL;
-  Vertex *temp = NULL, *top = NULL;
+  GraphCSR *csr = NULL;
+  int rv;
 
-  if ((! graph) || (! minimum_span_tree)
-      || (! graph->numVertices) || (! graph->vertices)
-      || (! minimum_span_tree->numVertices) || (! minimum_span_tree->vertices))
-    return -1;
-
-  i_start = graph_get_vertex_by_id (graph, start);
-  if (i_start == UNKNOW_VETEX)
+  csr = graph_csr_build (graph);
+  if (! csr)
   {
-    printf ("[%s,%d] Start vertex %d is not in the graph\n", __func__, __LINE__, start);
+    printf ("[%s,%d] Error, Fail to build CSR snapshot\n", __func__, __LINE__);
     return -1;
   }
 
-  visited = (int *)malloc(graph->numVertices * sizeof (int));
-  if (! visited)
+  rv = graph_csr_boruvka (csr, num_workers);
+  graph_csr_deinit (csr);
+  return rv;
+}
+
+/*
+ * Prim on the indexed heap: every vertex outside the tree is in the heap at
+ * most once, keyed by its lightest edge to the tree, and the key only
+ * goes down. O(E log V), spans the component of start.
+ */
+int prim (GraphCSR *csr, Graph* minimum_span_tree, int start)
+{
+  IndexedHeap *heap = NULL;
+  int *parent = NULL, *weight = NULL;
+  char *in_tree = NULL;
+  int e, u, v, i_start, rv = -1;
+
+  if ((! csr) || (! minimum_span_tree)
+      || (! csr->numVertices)
+      || (! minimum_span_tree->vertices))
+    return -1;
+
+  if (csr->directed)
   {
-    printf ("[%s,%d] Fail to allocate memory for visited array\n", __func__, __LINE__);
+    printf ("[%s,%d] Spanning tree needs an undirected graph\n", __func__, __LINE__);
     return -1;
   }
-  memset (visited, 0, graph->numVertices * sizeof (int));
 
-  graph_max_edges = graph->numVertices - 1;
-  pq = pq_create (graph_max_edges, graph_edge_cmp, NULL);
-  if (! pq)
+  i_start = graph_csr_get_vertex_by_id (csr, start);
+  if (i_start == UNKNOW_VETEX)
   {
-    printf ("[%s,%d] Fail to create priority queue!\n", __func__, __LINE__);
-    goto ERR_EXIT;
+    printf ("[%s,%d] Start vertex %d is not in the graph\n", __func__, __LINE__, start);
+    return -1;
   }
 
-  while (i_start != UNKNOW_VETEX && visited[i_start] == 0 && graph->vertices[i_start])
-  {
-    visited[i_start] = 1;
-    temp = graph->vertices[i_start];
-    while (temp)
-    {
-      pq_add (pq, (void *)temp);
+  if (! csr->numEdges)
+    return 0;
 
-      temp = temp->next;
-    }
+  heap    = iheap_create (csr->numVertices);
+  parent  = (int *)malloc(csr->numVertices * sizeof (int));
+  weight  = (int *)malloc(csr->numVertices * sizeof (int));
+  in_tree = (char *)calloc(csr->numVertices, sizeof (char));
+  if (! heap || ! parent || ! weight || ! in_tree)
+  {
+    printf ("[%s,%d] Fail to allocate memory for Prim\n", __func__, __LINE__);
+    goto EXIT;
+  }
 
-    do
+  parent[i_start] = UNKNOW_VETEX;
+  iheap_push (heap, i_start, 0);
+  while ((u = iheap_pop (heap, NULL)) != -1)
+  {
+    in_tree[u] = 1;
+    if (parent[u] != UNKNOW_VETEX
+        && graph_add_edge (minimum_span_tree, csr->ids[parent[u]], csr->ids[u], weight[u]) != 0)
+      goto EXIT;
+
+    for (e = csr->offsets[u]; e < csr->offsets[u + 1]; ++e)
     {
-      top = (Vertex *) pq_extract_top (pq);
-      if (top)
+      v = csr->dest[e];
+      if (in_tree[v])
+        continue;
+
+      /* Insert or decrease, 0 means the heap took the lighter edge */
+      if (iheap_push (heap, v, csr->weight[e]) == 0)
       {
-        i_start = graph_get_vertex_by_id (graph, top->edge.dest);
-        if (i_start != UNKNOW_VETEX
-            && visited[i_start] == 0)
-        {
-          graph_add_edge (minimum_span_tree, top->id, top->edge.dest, top->edge.weight);
-          break;
-        }
+        parent[v] = u;
+        weight[v] = csr->weight[e];
       }
-    } while (! pq_is_empty (pq));
-
-    pq_flush (pq);
+    }
   }
+  rv = 0;
 
-  pq_deinit (pq);
-  if (visited)
-    free (visited);
-  visited = NULL;
-  return 0;
-
-ERR_EXIT:
-  if (visited)
-    free (visited);
-  visited = NULL;
-  return -1;
+EXIT:
+  iheap_deinit (heap);
+  if (parent)   free (parent);
+  if (weight)   free (weight);
+  if (in_tree)  free (in_tree);
+  return rv;
 }
 
-int graph_prim (Graph *graph, int start)
+
+int graph_csr_prim (GraphCSR *csr, int start)
 {
   Graph *minimum_span_tree = NULL;
-  int rv = 0;
+  int rv = -1;
 
-  if (! graph)
+  if (! csr)
     return -1;
 
-  minimum_span_tree = graph_init (graph->numVertices);
+  minimum_span_tree = graph_init (csr->numVertices);
   if (! minimum_span_tree)
   {
     printf ("[%s,%d] Fail to create minimum spanning tree!\n", __func__, __LINE__);
     goto EXIT;
   }
 
-  rv = prim (graph, minimum_span_tree, start);
+  rv = prim (csr, minimum_span_tree, start);
   if (rv != 0)
   {
-    printf ("[%s,%d] Fail to perform kruskal algorithm\n", __func__, __LINE__);
+    printf ("[%s,%d] Fail to perform prim algorithm\n", __func__, __LINE__);
     goto EXIT;
   }
 
@@ -1050,11 +5051,28 @@ int graph_prim (Graph *graph, int start)
 
 EXIT:
   if (minimum_span_tree)
-    free (minimum_span_tree);
+    graph_deinit (minimum_span_tree);
   minimum_span_tree = NULL;
   return rv;
 }
 
+int graph_prim (Graph *graph, int start)
+{
+  GraphCSR *csr = NULL;
+  int rv;
+
+  csr = graph_csr_build (graph);
+  if (! csr)
+  {
+    printf ("[%s,%d] Error, Fail to build CSR snapshot\n", __func__, __LINE__);
+    return -1;
+  }
+
+  rv = graph_csr_prim (csr, start);
+  graph_csr_deinit (csr);
+  return rv;
+}
+
 int bfs_util (Graph *graph, int s, int t, int *parent)
 {
   int *visited = NULL, *front = NULL, i_s, i_t, i_src, i_dest;
@@ -1073,7 +5091,7 @@ int bfs_util (Graph *graph, int s, int t, int *parent)
   }
   memset (visited, 0, graph->numVertices * sizeof(int));
 
-  queue = queue_create (20);
+  queue = queue_create (graph->numVertices);
   if (! queue)
   {
     printf ("[%s,%d] Fail to create queue for BFS algorithm\n", __func__, __LINE__);
@@ -1220,6 +5238,46 @@ void graph_add_weight (Graph *graph, int src, int dest, int weight)
   }
 }
 
+static Vertex* graph_find_arc (Graph *graph, int src, int dest)
+{
+  Vertex *temp;
+  int i;
+
+  i = graph_get_vertex_by_id (graph, src);
+  if (i == UNKNOW_VETEX)
+    return NULL;
+
+  for (temp = graph->vertices[i]; temp; temp = temp->next)
+    if (temp->edge.dest == dest)
+      return temp;
+  return NULL;
+}
+
+/*
+ * Add capacity to the residual graph, parallel edges are merged so the arc
+ * bfs_util follows is the one the path capacity is read from. A directed
+ * arc gets an empty arc back if there is none yet.
+ */
+static int graph_residual_add (Graph *rgraph, int src, int dest, int weight)
+{
+  Vertex *arc;
+
+  arc = graph_find_arc (rgraph, src, dest);
+  if (! arc)
+  {
+    if (graph_add_edge (rgraph, src, dest, weight) != 0)
+      return -1;
+    if (rgraph->directed && ! graph_find_arc (rgraph, dest, src))
+      return graph_add_edge (rgraph, dest, src, 0);
+    return 0;
+  }
+
+  arc->edge.weight += weight;
+  if (! rgraph->directed)
+    graph_find_arc (rgraph, dest, src)->edge.weight += weight;
+  return 0;
+}
+
 int graph_ford_fulkerson (Graph *graph, int s, int t)
 {
   Graph *rgraph = NULL;
@@ -1243,13 +5301,30 @@ int graph_ford_fulkerson (Graph *graph, int s, int t)
     return -1;
   }
 
-  rgraph = graph_init (graph->numVertices);
+  rgraph = graph_init_flags (graph->numVertices, graph->directed ? GRAPH_DIRECTED : 0);
   if (! rgraph)
   {
     printf ("[%s,%d] Fail to create the residual graph\n", __func__, __LINE__);
     return -1;
   }
-  graph_copy (rgraph, graph);
+
+  /* Both arcs of an undirected edge are in graph, only one goes to rgraph */
+  for (i = 0; i < graph->numVertices; ++i)
+  {
+    for (temp = graph->vertices[i]; temp; temp = temp->next)
+    {
+      if ((graph->directed || temp->id < temp->edge.dest)
+          && graph_residual_add (rgraph, temp->id, temp->edge.dest, temp->edge.weight) != 0)
+      {
+        printf ("[%s,%d] Fail to build the residual graph\n", __func__, __LINE__);
+        goto ERR_EXIT;
+      }
+    }
+  }
+
+  /* bfs_util hands back slots of the residual graph */
+  i_s = graph_get_vertex_by_id (rgraph, s);
+  i_t = graph_get_vertex_by_id (rgraph, t);
 
   parent = (int *)malloc(graph->numVertices * sizeof (int));
   if (! parent)
@@ -1262,19 +5337,19 @@ int graph_ford_fulkerson (Graph *graph, int s, int t)
 
   while (bfs_util (rgraph, s, t, parent))
   {
-    path_flow = INFINITY;
+    path_flow = INT_MAX;
     for (i = i_t; i != i_s; i = parent[i])
     {
       i_parent = parent[i];
       if (i_parent == UNKNOW_VETEX)
         break;
 
-      if (rgraph->vertices[i_parent] && rgraph->vertices[i])
+      if (rgraph->vertices[i_parent])
       {
         temp = rgraph->vertices[i_parent];
         while (temp)
         {
-          if (temp->edge.dest == rgraph->vertices[i]->id)
+          if (temp->edge.dest == rgraph->slotIds[i])
             break;
 
           temp = temp->next;
@@ -1291,10 +5366,8 @@ int graph_ford_fulkerson (Graph *graph, int s, int t)
       if (i_parent == UNKNOW_VETEX)
         break;
 
-      if (rgraph->vertices[i_parent] && rgraph->vertices[i])
-      {
-        graph_add_weight (rgraph, rgraph->vertices[i_parent]->id, rgraph->vertices[i]->id, path_flow);
-      }
+      /* The path uses up capacity on parent -> i and frees as much on i -> parent */
+      graph_add_weight (rgraph, rgraph->slotIds[i], rgraph->slotIds[i_parent], path_flow);
     }
 
     max_flow += path_flow;
@@ -1314,89 +5387,228 @@ ERR_EXIT:
   return -1;
 }
 
+/*
+ * Floyd-Warshall works on FW_BLOCK x FW_BLOCK tiles of the matrix. Rows are
+ * padded to a whole number of tiles and start on a GRAPH_MAT_ALIGN boundary,
+ * so every tile row can be loaded with aligned vector instructions.
+ */
+#define GRAPH_MAT_ALIGN   64
+#define FW_BLOCK          64
+
+/*
+ * Largest b for which d + b is a real distance: a sum that would pass
+ * GRAPH_DIST_INFINITY saturates to it instead of wrapping around, and
+ * nothing shortens a path through an unreachable b.
+ */
+#define FW_SUM_LIMIT(d)   (((d) >= 0) ? GRAPH_DIST_INFINITY - (d) : GRAPH_DIST_INFINITY - 1)
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FW_SIMD
+#include <immintrin.h>
+#endif
+
+typedef void (*FwKernel)(graph_dist_t *c, const graph_dist_t *a, const graph_dist_t *b, int stride);
+
+typedef struct FloydWarshall
+{
+  GraphMat *mat;
+  FwKernel kernel;
+  int numBlocks;
+  int kb;             /* tile row and column of the current round */
+} FloydWarshall;
+
+typedef struct FwNextHops
+{
+  GraphMat *mat;
+  GraphCSR *rcsr;
+  int *queue;         /* numVertices entries per worker */
+} FwNextHops;
+
+static void* graph_mat_alloc (size_t size)
+{
+  void *ptr = NULL;
+
+#ifdef _WIN32
+  ptr = _aligned_malloc (size, GRAPH_MAT_ALIGN);
+#else
+  if (posix_memalign (&ptr, GRAPH_MAT_ALIGN, size) != 0)
+    ptr = NULL;
+#endif
+  return ptr;
+}
+
+static void graph_mat_free (void *ptr)
+{
+#ifdef _WIN32
+  _aligned_free (ptr);
+#else
+  free (ptr);
+#endif
+}
+
 GraphMat *graph_matrix_init (int numVertices)
 {
-	int i = 0;
   GraphMat *g = NULL;
+  size_t size;
 
-	if (! numVertices)
-		return NULL;
+  if (numVertices <= 0)
+    return NULL;
 
   g = (GraphMat *)malloc(sizeof (GraphMat));
   if (! g)
     return NULL;
 
-  g->numVertices = numVertices;
-	g->vertices = (int **)calloc(numVertices, sizeof (int *));
-	if (! g->vertices)
-		return NULL;
-
-	for (i = 0; i < numVertices; ++i)
-	{
-		*(g->vertices + i) = calloc (numVertices, sizeof(int));
-		if (! *(g->vertices + i))
-			goto ERR;
-	}
-	return g;
-
-ERR:
-	for (i; i >= 0; i--)
-	{
-		free (*(g->vertices + i));
-	}
-	free (g->vertices);
-  return NULL;
+  g->numVertices  = numVertices;
+  g->stride       = (numVertices + FW_BLOCK - 1) / FW_BLOCK * FW_BLOCK;
+  g->next         = NULL;
+  g->nextWidth    = 0;
+  size            = (size_t)g->stride * g->stride * sizeof (graph_dist_t);
+  g->dist         = (graph_dist_t *)graph_mat_alloc (size);
+  if (! g->dist)
+  {
+    free (g);
+    return NULL;
+  }
+
+  memset (g->dist, 0, size);
+  return g;
 }
 
 void graph_matrix_deinit (GraphMat *g)
 {
-  int i = 0;
-
   if (! g)
     return;
 
-  if (g->vertices)
-  {
-    for (i = 0; i < g->numVertices; ++i)
-      free (*(g->vertices + i));
-
-    free (g->vertices);
-  }
-  g->vertices = NULL;
+  if (g->dist)  graph_mat_free (g->dist);
+  if (g->next)  graph_mat_free (g->next);
+  g->dist = NULL;
+  g->next = NULL;
   g->numVertices = 0;
   free (g);
   g = NULL;
 }
 
-int graph_convert_list_to_matrix (Graph *graph, GraphMat **g_mat)
+static void graph_matrix_set_next (GraphMat *g_mat, size_t index, int hop)
 {
-  int i = 0, j = 0;
-  Vertex *temp = NULL;
+  switch (g_mat->nextWidth)
+  {
+    case 1:
+      ((uint8_t *)g_mat->next)[index] = (hop == UNKNOW_VETEX) ? UINT8_MAX : (uint8_t)hop;
+      break;
+    case 2:
+      ((uint16_t *)g_mat->next)[index] = (hop == UNKNOW_VETEX) ? UINT16_MAX : (uint16_t)hop;
+      break;
+    default:
+      ((uint32_t *)g_mat->next)[index] = (hop == UNKNOW_VETEX) ? UINT32_MAX : (uint32_t)hop;
+      break;
+  }
+}
 
-  if (! graph || ! graph->numVertices || ! graph->vertices)
+/* Slot after i_src on the shortest path to i_dest, UNKNOW_VETEX if there is none */
+static int graph_matrix_next (GraphMat *g_mat, int i_src, int i_dest)
+{
+  size_t index = (size_t)i_src * g_mat->stride + i_dest;
+  uint32_t hop;
+
+  switch (g_mat->nextWidth)
+  {
+    case 1:
+      hop = ((uint8_t *)g_mat->next)[index];
+      return (hop == UINT8_MAX) ? UNKNOW_VETEX : (int)hop;
+    case 2:
+      hop = ((uint16_t *)g_mat->next)[index];
+      return (hop == UINT16_MAX) ? UNKNOW_VETEX : (int)hop;
+    default:
+      hop = ((uint32_t *)g_mat->next)[index];
+      return (hop == UINT32_MAX) ? UNKNOW_VETEX : (int)hop;
+  }
+}
+
+/*
+ * Follow the next hops from i_src to i_dest and store the slots of the path,
+ * both ends included. Return the number of slots on the path, 0 if i_dest is
+ * not reachable or the path does not fit into path_len slots
+ */
+int graph_matrix_get_path (GraphMat *g_mat, int i_src, int i_dest, int *path, int path_len)
+{
+  int i, len = 0;
+
+  if (! g_mat || ! g_mat->next || ! path || path_len <= 0
+      || i_src < 0 || i_src >= g_mat->numVertices
+      || i_dest < 0 || i_dest >= g_mat->numVertices)
+    return 0;
+
+  for (i = i_src; i != i_dest; i = graph_matrix_next (g_mat, i, i_dest))
+  {
+    if (i == UNKNOW_VETEX || len == path_len - 1)
+      return 0;
+
+    path[len++] = i;
+  }
+  path[len++] = i_dest;
+
+  return len;
+}
+
+/*
+ * The matrix is indexed by CSR slot, not by vertex id. The padding rows and
+ * columns hold GRAPH_DIST_INFINITY and never shorten a path.
+ */
+int graph_csr_to_matrix (GraphCSR *csr, GraphMat **g_mat)
+{
+  graph_dist_t *row;
+  size_t i, size;
+  int j, e;
+
+  if (! csr || ! csr->numVertices || ! g_mat)
     return -1;
 
-  *g_mat = graph_matrix_init (graph->numVertices);
-  if (! g_mat)
+  *g_mat = graph_matrix_init (csr->numVertices);
+  if (! *g_mat)
   {
     printf ("[%s,%d] Fail to create graph matrix\n", __func__, __LINE__);
     return -1;
   }
 
-  for (i = 0; i < (*g_mat)->numVertices; ++i)
-    for (j = 0; j < (*g_mat)->numVertices; ++j)
-      (*g_mat)->vertices[i][j] = INFINITY;
+  size = (size_t)(*g_mat)->stride * (*g_mat)->stride;
+  for (i = 0; i < size; ++i)
+    (*g_mat)->dist[i] = GRAPH_DIST_INFINITY;
 
-  for (i = 0; i < graph->numVertices; ++i)
+  for (j = 0; j < csr->numVertices; ++j)
+  {
+    row = &GRAPH_MAT_AT(*g_mat, j, 0);
+    row[j] = 0;
+    for (e = csr->offsets[j]; e < csr->offsets[j + 1]; ++e)
+      row[csr->dest[e]] = MIN(row[csr->dest[e]], (graph_dist_t)csr->weight[e]);
+  }
+
+  return 0;
+}
+
+/* Plain triple loop over the matrix, kept as the reference for the blocked version */
+int floyd_warshall_naive (GraphMat *g_mat)
+{
+  graph_dist_t d, limit, *row, *row_k;
+  int i, j, k;
+
+  if (! g_mat || ! g_mat->dist)
+    return -1;
+
+  for (k = 0; k < g_mat->numVertices; ++k)
   {
-    if (graph->vertices[i])
+    row_k = &GRAPH_MAT_AT(g_mat, k, 0);
+    for (i = 0; i < g_mat->numVertices; ++i)
     {
-      temp = graph->vertices[i];
-      while (temp)
-      {
-        (*g_mat)->vertices[temp->id][temp->edge.dest] = temp->edge.weight;
+      row = &GRAPH_MAT_AT(g_mat, i, 0);
+      d = row[k];
+      if (d == GRAPH_DIST_INFINITY)
+        continue;
 
-        temp = temp->next;
+      limit = FW_SUM_LIMIT(d);
+      for (j = 0; j < g_mat->numVertices; ++j)
+      {
+        if (row_k[j] <= limit && d + row_k[j] < row[j])
+          row[j] = d + row_k[j];
       }
     }
   }
@@ -1404,44 +5616,358 @@ int graph_convert_list_to_matrix (Graph *graph, GraphMat **g_mat)
   return 0;
 }
 
-int floyd_warshall (Graph *graph, GraphMat **g_mat)
+/*
+ * Relax tile c through tile a (same rows) and tile b (same columns):
+ *    c[i][j] = min (c[i][j], a[i][k] + b[k][j])
+ * c may be a or b, k runs in order so the in-place rounds stay correct.
+ */
+static void fw_tile_scalar (graph_dist_t *c, const graph_dist_t *a, const graph_dist_t *b, int stride)
 {
+  const graph_dist_t *row_k;
+  graph_dist_t d, limit, *row;
   int i, j, k;
 
-  if (! graph || ! graph->numVertices || ! graph->vertices)
-    return -1;
+  for (k = 0; k < FW_BLOCK; ++k)
+  {
+    row_k = b + (size_t)k * stride;
+    for (i = 0; i < FW_BLOCK; ++i)
+    {
+      d = a[(size_t)i * stride + k];
+      if (d == GRAPH_DIST_INFINITY)
+        continue;
 
-  graph_convert_list_to_matrix (graph, g_mat);
-  if (! (*g_mat))
+      row   = c + (size_t)i * stride;
+      limit = FW_SUM_LIMIT(d);
+      for (j = 0; j < FW_BLOCK; ++j)
+      {
+        if (row_k[j] <= limit && d + row_k[j] < row[j])
+          row[j] = d + row_k[j];
+      }
+    }
+  }
+}
+
+#ifdef FW_SIMD
+/*
+ * Same rule as FW_SUM_LIMIT without a per lane compare against the limit:
+ * with d >= 0 the sum overflowed exactly when it came out below b, with
+ * d < 0 it can only go wrong for b = GRAPH_DIST_INFINITY. Either way the
+ * lane is forced to GRAPH_DIST_INFINITY before taking the minimum.
+ */
+__attribute__ ((target ("avx2")))
+static void fw_tile_avx2 (graph_dist_t *c, const graph_dist_t *a, const graph_dist_t *b, int stride)
+{
+  const graph_dist_t *row_k;
+  graph_dist_t d, *row;
+  __m256i inf, vd, vb, vc, vs, over;
+  int i, j, k;
+
+#if GRAPH_DIST_WIDTH == 64
+  inf = _mm256_set1_epi64x (GRAPH_DIST_INFINITY);
+#else
+  inf = _mm256_set1_epi32 (GRAPH_DIST_INFINITY);
+#endif
+
+  for (k = 0; k < FW_BLOCK; ++k)
   {
-    printf ("[%s,%d] Fail to create graph matrix\n", __func__, __LINE__);
-    return -1;
+    row_k = b + (size_t)k * stride;
+    for (i = 0; i < FW_BLOCK; ++i)
+    {
+      d = a[(size_t)i * stride + k];
+      if (d == GRAPH_DIST_INFINITY)
+        continue;
+
+      row = c + (size_t)i * stride;
+      for (j = 0; j < FW_BLOCK; j += 32 / sizeof (graph_dist_t))
+      {
+        vb = _mm256_load_si256 ((const __m256i *)(row_k + j));
+        vc = _mm256_load_si256 ((const __m256i *)(row + j));
+#if GRAPH_DIST_WIDTH == 64
+        vd    = _mm256_set1_epi64x (d);
+        vs    = _mm256_add_epi64 (vd, vb);
+        over  = (d >= 0) ? _mm256_cmpgt_epi64 (vb, vs) : _mm256_cmpeq_epi64 (vb, inf);
+        vs    = _mm256_blendv_epi8 (vs, inf, over);
+        vc    = _mm256_blendv_epi8 (vc, vs, _mm256_cmpgt_epi64 (vc, vs));
+#else
+        vd    = _mm256_set1_epi32 (d);
+        vs    = _mm256_add_epi32 (vd, vb);
+        over  = (d >= 0) ? _mm256_cmpgt_epi32 (vb, vs) : _mm256_cmpeq_epi32 (vb, inf);
+        vs    = _mm256_blendv_epi8 (vs, inf, over);
+        vc    = _mm256_min_epi32 (vc, vs);
+#endif
+        _mm256_store_si256 ((__m256i *)(row + j), vc);
+      }
+    }
   }
+}
+
+__attribute__ ((target ("sse4.2")))
+static void fw_tile_sse (graph_dist_t *c, const graph_dist_t *a, const graph_dist_t *b, int stride)
+{
+  const graph_dist_t *row_k;
+  graph_dist_t d, *row;
+  __m128i inf, vd, vb, vc, vs, over;
+  int i, j, k;
+
+#if GRAPH_DIST_WIDTH == 64
+  inf = _mm_set1_epi64x (GRAPH_DIST_INFINITY);
+#else
+  inf = _mm_set1_epi32 (GRAPH_DIST_INFINITY);
+#endif
 
-  for (k = 0; k < (*g_mat)->numVertices; ++k)
+  for (k = 0; k < FW_BLOCK; ++k)
   {
-    for (i = 0; i < (*g_mat)->numVertices; ++i)
+    row_k = b + (size_t)k * stride;
+    for (i = 0; i < FW_BLOCK; ++i)
     {
-      for (j = 0; j < (*g_mat)->numVertices; ++j)
+      d = a[(size_t)i * stride + k];
+      if (d == GRAPH_DIST_INFINITY)
+        continue;
+
+      row = c + (size_t)i * stride;
+      for (j = 0; j < FW_BLOCK; j += 16 / sizeof (graph_dist_t))
       {
-        if ((*g_mat)->vertices[i][k] + (*g_mat)->vertices[k][j] < (*g_mat)->vertices[i][j])
-          (*g_mat)->vertices[i][j] = (*g_mat)->vertices[i][k] + (*g_mat)->vertices[k][j];
+        vb = _mm_load_si128 ((const __m128i *)(row_k + j));
+        vc = _mm_load_si128 ((const __m128i *)(row + j));
+#if GRAPH_DIST_WIDTH == 64
+        vd    = _mm_set1_epi64x (d);
+        vs    = _mm_add_epi64 (vd, vb);
+        over  = (d >= 0) ? _mm_cmpgt_epi64 (vb, vs) : _mm_cmpeq_epi64 (vb, inf);
+        vs    = _mm_blendv_epi8 (vs, inf, over);
+        vc    = _mm_blendv_epi8 (vc, vs, _mm_cmpgt_epi64 (vc, vs));
+#else
+        vd    = _mm_set1_epi32 (d);
+        vs    = _mm_add_epi32 (vd, vb);
+        over  = (d >= 0) ? _mm_cmpgt_epi32 (vb, vs) : _mm_cmpeq_epi32 (vb, inf);
+        vs    = _mm_blendv_epi8 (vs, inf, over);
+        vc    = _mm_min_epi32 (vc, vs);
+#endif
+        _mm_store_si128 ((__m128i *)(row + j), vc);
       }
     }
   }
+}
+#endif /* FW_SIMD */
+
+/* Widest kernel the running CPU supports */
+static FwKernel fw_kernel (void)
+{
+#ifdef FW_SIMD
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+    return fw_tile_avx2;
+  if (__builtin_cpu_supports ("sse4.2"))
+    return fw_tile_sse;
+#endif
+  return fw_tile_scalar;
+}
+
+static graph_dist_t* fw_tile (GraphMat *mat, int ib, int jb)
+{
+  return mat->dist + (size_t)ib * FW_BLOCK * mat->stride + (size_t)jb * FW_BLOCK;
+}
+
+/* Tile (ib, jb) through tiles (ib, kb) and (kb, jb) */
+static void fw_relax (FloydWarshall *fw, int ib, int jb, int kb)
+{
+  fw->kernel (fw_tile (fw->mat, ib, jb), fw_tile (fw->mat, ib, kb), fw_tile (fw->mat, kb, jb),
+              fw->mat->stride);
+}
+
+/* Phase 2, the other tiles of row kb and column kb through the diagonal tile */
+static void fw_cross_task (int worker, int num_workers, void *arg)
+{
+  FloydWarshall *fw = (FloydWarshall *)arg;
+  int t, b, begin, end;
+
+  wpool_range (worker, num_workers, 2 * (fw->numBlocks - 1), &begin, &end);
+  for (t = begin; t < end; ++t)
+  {
+    b = t / 2;
+    if (b >= fw->kb)
+      b++;
+
+    if (t % 2)
+      fw_relax (fw, fw->kb, b, fw->kb);
+    else
+      fw_relax (fw, b, fw->kb, fw->kb);
+  }
+}
+
+/* Phase 3, every remaining tile through its row and column tile of round kb */
+static void fw_rest_task (int worker, int num_workers, void *arg)
+{
+  FloydWarshall *fw = (FloydWarshall *)arg;
+  int t, ib, jb, begin, end, n = fw->numBlocks - 1;
+
+  wpool_range (worker, num_workers, n * n, &begin, &end);
+  for (t = begin; t < end; ++t)
+  {
+    ib = t / n;
+    jb = t % n;
+    if (ib >= fw->kb)
+      ib++;
+    if (jb >= fw->kb)
+      jb++;
+
+    fw_relax (fw, ib, jb, fw->kb);
+  }
+}
+
+static void fw_phase (WorkerPool *pool, WorkerTask task, FloydWarshall *fw)
+{
+  if (pool)
+    wpool_run (pool, task, fw);
+  else
+    task (0, 1, fw);
+}
+
+/*
+ * Blocked Floyd-Warshall in place. Round kb first closes the diagonal tile,
+ * then the tiles sharing its row or column, then all the others; the tiles
+ * of the last two phases are independent and split over the pool, which
+ * may be NULL to run on the calling thread only.
+ */
+int floyd_warshall_blocked (GraphMat *g_mat, struct WorkerPool *pool)
+{
+  FloydWarshall fw;
+
+  if (! g_mat || ! g_mat->dist)
+    return -1;
+
+  fw.mat        = g_mat;
+  fw.kernel     = fw_kernel ();
+  fw.numBlocks  = g_mat->stride / FW_BLOCK;
+
+  for (fw.kb = 0; fw.kb < fw.numBlocks; ++fw.kb)
+  {
+    fw_relax (&fw, fw.kb, fw.kb, fw.kb);
+
+    if (fw.numBlocks == 1)
+      break;
+    fw_phase (pool, fw_cross_task, &fw);
+    fw_phase (pool, fw_rest_task, &fw);
+  }
 
   return 0;
 }
 
-int graph_floyd_warshall (Graph *graph)
+/*
+ * Destinations split over the workers. For destination j a BFS from j walks
+ * the arcs i -> x backwards that are tight, d[i][j] = w + d[x][j], and the
+ * first x to reach i becomes its next hop. Every hop points to a vertex found
+ * earlier, so the hops into j form a tree even across zero weight cycles.
+ */
+static void fw_next_hop_task (int worker, int num_workers, void *arg)
+{
+  FwNextHops *nh = (FwNextHops *)arg;
+  GraphMat *mat = nh->mat;
+  GraphCSR *rcsr = nh->rcsr;
+  graph_dist_t d;
+  int *queue, head, tail, begin, end, i, j, x, e;
+
+  queue = nh->queue + (size_t)worker * mat->numVertices;
+  wpool_range (worker, num_workers, mat->numVertices, &begin, &end);
+  for (j = begin; j < end; ++j)
+  {
+    graph_matrix_set_next (mat, (size_t)j * mat->stride + j, j);
+    head = 0;
+    tail = 0;
+    queue[tail++] = j;
+    while (head < tail)
+    {
+      x = queue[head++];
+      d = GRAPH_MAT_AT(mat, x, j);
+      for (e = rcsr->offsets[x]; e < rcsr->offsets[x + 1]; ++e)
+      {
+        i = rcsr->dest[e];
+        if (graph_matrix_next (mat, i, j) != UNKNOW_VETEX
+            || rcsr->weight[e] > FW_SUM_LIMIT(d)
+            || d + rcsr->weight[e] != GRAPH_MAT_AT(mat, i, j))
+          continue;
+
+        graph_matrix_set_next (mat, (size_t)i * mat->stride + j, x);
+        queue[tail++] = i;
+      }
+    }
+  }
+}
+
+/*
+ * Next hops of every pair from a finished distance matrix of csr, stored at
+ * the narrowest width whose largest value is free to mean "no path".
+ */
+int floyd_warshall_next_hops (GraphCSR *csr, struct WorkerPool *pool, GraphMat *g_mat)
+{
+  FwNextHops nh;
+  size_t size;
+  int rv = -1;
+
+  if (! csr || ! g_mat || ! g_mat->dist || csr->numVertices != g_mat->numVertices)
+    return -1;
+
+  if (g_mat->numVertices < UINT8_MAX)
+    g_mat->nextWidth = 1;
+  else if (g_mat->numVertices < UINT16_MAX)
+    g_mat->nextWidth = 2;
+  else
+    g_mat->nextWidth = 4;
+
+  size = (size_t)g_mat->stride * g_mat->stride * g_mat->nextWidth;
+  if (! g_mat->next)
+    g_mat->next = graph_mat_alloc (size);
+
+  nh.mat    = g_mat;
+  nh.rcsr   = graph_csr_reverse (csr);
+  nh.queue  = (int *)malloc((size_t)(pool ? pool->numWorkers : 1) * g_mat->numVertices * sizeof (int));
+  if (! g_mat->next || ! nh.rcsr || ! nh.queue)
+  {
+    printf ("[%s,%d] Fail to allocate memory for next hop matrix\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  /* All ones is the "no path" value of every width */
+  memset (g_mat->next, 0xFF, size);
+  if (pool)
+    wpool_run (pool, fw_next_hop_task, &nh);
+  else
+    fw_next_hop_task (0, 1, &nh);
+  rv = 0;
+
+EXIT:
+  if (nh.queue)
+    free (nh.queue);
+  return rv;
+}
+
+/* All pairs distances and next hops, paths come out of graph_matrix_get_path */
+int floyd_warshall (GraphCSR *csr, struct WorkerPool *pool, GraphMat **g_mat)
+{
+  if (! csr || ! csr->numVertices || ! g_mat)
+    return -1;
+
+  graph_csr_to_matrix (csr, g_mat);
+  if (! (*g_mat))
+  {
+    printf ("[%s,%d] Fail to create graph matrix\n", __func__, __LINE__);
+    return -1;
+  }
+
+  if (floyd_warshall_blocked (*g_mat, pool) != 0)
+    return -1;
+
+  return floyd_warshall_next_hops (csr, pool, *g_mat);
+}
+
+int graph_csr_floyd_warshall (GraphCSR *csr)
 {
   GraphMat *g_mat = NULL;
   int rv = 0, i, j;
 
-  if (! graph || ! graph->numVertices || ! graph->vertices)
+  if (! csr || ! csr->numVertices)
     return -1;
 
-  rv = floyd_warshall (graph, &g_mat);
+  rv = floyd_warshall (csr, NULL, &g_mat);
   if (rv != 0)
   {
     printf ("[%s,%d] Fail to perform the floyd warshall algorithm\n", __func__, __LINE__);
@@ -1451,13 +5977,19 @@ int graph_floyd_warshall (Graph *graph)
   if (g_mat)
   {
     printf ("The shortest path matrix: \n");
+    printf ("%4s ", "");
+    for (j = 0; j < g_mat->numVertices; ++j)
+      printf ("%4d ", csr->ids[j]);
+    printf ("\n");
+
     for (i = 0; i < g_mat->numVertices; ++i)
     {
+      printf ("%4d ", csr->ids[i]);
       for (j = 0; j < g_mat->numVertices; ++j)
-        if (g_mat->vertices[i][j] == INFINITY)
+        if (GRAPH_MAT_AT(g_mat, i, j) == GRAPH_DIST_INFINITY)
           printf ("%4s ", "INF");
         else
-          printf ("%4d ", g_mat->vertices[i][j]);
+          printf ("%4lld ", (long long)GRAPH_MAT_AT(g_mat, i, j));
       printf ("\n");
     }
     printf ("\n");
@@ -1467,4 +5999,21 @@ int graph_floyd_warshall (Graph *graph)
     graph_matrix_deinit (g_mat);
 
   return 0;
-}
\ No newline at end of file
+}
+
+int graph_floyd_warshall (Graph *graph)
+{
+  GraphCSR *csr = NULL;
+  int rv;
+
+  csr = graph_csr_build (graph);
+  if (! csr)
+  {
+    printf ("[%s,%d] Error, Fail to build CSR snapshot\n", __func__, __LINE__);
+    return -1;
+  }
+
+  rv = graph_csr_floyd_warshall (csr);
+  graph_csr_deinit (csr);
+  return rv;
+}
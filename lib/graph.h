@@ -1,6 +1,31 @@
 #ifndef __GRAPH_H__
 #define __GRAPH_H__
 
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Width of the distance type used by the shortest path algorithms,
+ * build with -DGRAPH_DIST_WIDTH=64 for graphs whose path lengths do not
+ * fit in 32 bits. Unreachable vertices hold GRAPH_DIST_INFINITY.
+ */
+#ifndef GRAPH_DIST_WIDTH
+#define GRAPH_DIST_WIDTH 32
+#endif
+
+#if GRAPH_DIST_WIDTH == 64
+typedef int64_t graph_dist_t;
+#define GRAPH_DIST_INFINITY INT64_MAX
+#else
+typedef int32_t graph_dist_t;
+#define GRAPH_DIST_INFINITY INT32_MAX
+#endif
+
+#define UNKNOW_VETEX -1
+
+/* Flags of graph_init_flags */
+#define GRAPH_DIRECTED      0x1   /* graph_add_edge inserts src -> dest only */
+
 typedef struct Edge
 {
   int dest;
@@ -15,38 +40,269 @@ typedef struct Vertex
   struct Vertex* prev;
 } Vertex;
 
-typedef struct PathNode
-{
-  Vertex* V;
-  int* dist;
-} PathNode;
-
 typedef struct Graph
 {
   int numVertices;
+  int capacity;
+  int numEdges;
+  int directed;
   Vertex** vertices;
+  Vertex** tails;           /* last node of each adjacency list */
+  int *inDegree;            /* arcs into each slot, only kept when directed */
+
+  /* Vertex id <-> slot index */
+  int *slotIds;
+  int *denseIndex;
+  int denseSize;
+  int *hashKeys;
+  int *hashSlots;
+  int hashCapacity;
+  int hashSize;
+  int hashUsed;
+  int *freeSlots;
+  int numFree;
+
+  /* Edge node slabs */
+  struct VertexSlab *slabs; /* newest first, only the head still hands out nodes */
+  Vertex *freeNodes;        /* removed nodes, linked through next */
+  int numFreeNodes;
+  int slabNodes;            /* size of the next slab, doubles up to GRAPH_SLAB_MAX_NODES */
 } Graph;
 
+/* Edge node allocator of a graph, filled in by graph_alloc_stats */
+typedef struct GraphAllocStats
+{
+  size_t numSlabs;
+  size_t slabBytes;         /* slab memory including headers */
+  size_t nodesCapacity;     /* nodes the slabs can hold */
+  size_t nodesInUse;        /* nodes linked into adjacency lists */
+  size_t nodesFree;         /* nodes on the free list */
+  size_t nodesUntouched;    /* tail of the newest slab never handed out */
+} GraphAllocStats;
+
+/* Flat edge record between CSR slots, or vertex ids for graph_add_edges */
+typedef struct GraphEdge
+{
+  int src;
+  int dest;
+  int weight;
+} GraphEdge;
+
+typedef struct GraphCSR
+{
+  int numVertices;
+  int numEdges;
+  int *ids;
+  int *offsets;
+  int *dest;
+  int *weight;
+  int directed;             /* every edge is stored once, at its source */
+  struct GraphCSR *reverse; /* incoming arcs, built by graph_csr_reverse */
+
+  /* Vertex id -> slot index, built by graph_csr_index_build */
+  int *denseIndex;
+  int denseSize;
+  int *hashKeys;
+  int *hashSlots;
+  int hashCapacity;
+} GraphCSR;
+
+/* Flags of graph_csr_from_edges */
+#define GRAPH_CSR_SORTED    0x1   /* every adjacency range ordered by dest */
+#define GRAPH_CSR_DEDUP     0x2   /* sorted, only the lightest of parallel arcs kept */
+#define GRAPH_CSR_DIRECTED  0x4   /* one arc src -> dest per edge */
+
+typedef struct DijkstraSearch
+{
+  GraphCSR *csr;
+  struct IndexedHeap *heap;
+  graph_dist_t *distance;
+  int *prev_node;
+  int settled;
+} DijkstraSearch;
+
+/* Array stack entry of the iterative DFS, cursor is the next arc to follow */
+typedef struct DfsFrame
+{
+  int vertex;
+  int cursor;
+} DfsFrame;
+
+typedef enum DfsEvent
+{
+  DFS_DISCOVER,             /* tree arc u -> v, v is visited for the first time */
+  DFS_NONTREE,              /* arc u -> v to a vertex visited before */
+  DFS_FINISH,               /* every arc out of v is done, u is its parent */
+  DFS_DONE                  /* stack is empty */
+} DfsEvent;
+
+typedef struct DfsSearch
+{
+  GraphCSR *csr;
+  DfsFrame *stack;
+  int depth;
+  int *order;               /* discovery index of each slot, -1 if not visited */
+  int numVisited;
+  int rootPending;
+  int u;                    /* endpoints and arc of the last event */
+  int v;
+  int edge;
+} DfsSearch;
+
+/* Lower bound of the distance from slot i_vertex to slot i_dest */
+typedef graph_dist_t (*GraphHeuristic)(int i_vertex, int i_dest, void *arg);
+
+typedef struct GraphALT
+{
+  int numLandmarks;
+  int numVertices;
+  int *landmarks;
+  graph_dist_t *distFrom;   /* distFrom[k * numVertices + v] = d(landmark k, v) */
+  graph_dist_t *distTo;     /* distTo[k * numVertices + v]   = d(v, landmark k) */
+} GraphALT;
+
+typedef enum BellmanFordMode
+{
+  BELLMAN_FORD_FULL,        /* V - 1 passes over every edge */
+  BELLMAN_FORD_EARLY_EXIT,  /* stop after the first pass without update */
+  BELLMAN_FORD_SPFA,        /* relax only the edges out of vertices that changed */
+  BELLMAN_FORD_PARALLEL     /* early exit passes split over a worker pool */
+} BellmanFordMode;
+
+typedef enum DagPathMode
+{
+  DAG_SHORTEST_PATH,        /* lightest path from src */
+  DAG_LONGEST_PATH          /* heaviest path from src, the critical path */
+} DagPathMode;
+
+typedef enum BfsMode
+{
+  BFS_TOP_DOWN,             /* expand the frontier queue on every level */
+  BFS_DIRECTION_OPTIMIZING  /* bottom-up steps while the frontier is large */
+} BfsMode;
+
+/*
+ * Dense distance matrix indexed by CSR slot, kept in one aligned row-major
+ * buffer. Rows are stride entries long, the padding past numVertices holds
+ * GRAPH_DIST_INFINITY. next, when paths are tracked, has the same layout and
+ * holds the slot after i on the shortest path i -> j in nextWidth bytes
+ * (1, 2 or 4), the largest value of that width meaning no path.
+ */
 typedef struct GraphMat
 {
   int numVertices;
-  int **vertices;
+  int stride;
+  graph_dist_t *dist;
+  void *next;
+  int nextWidth;
 } GraphMat;
 
+#define GRAPH_MAT_AT(g, i, j)   ((g)->dist[(size_t)(i) * (g)->stride + (j)])
+
+struct WorkerPool;
+
 Graph* graph_init(int numVertices);
+Graph* graph_init_flags (int numVertices, int flags);
 void graph_deinit (Graph* graph);
 
 int graph_add_edge(Graph* graph, int src, int dest, int weight);
+int graph_add_edges (Graph* graph, const GraphEdge *edges, int num_edges);
 int graph_remove_edge(Graph* graph, int src, int dest);
+int graph_get_vertex_by_id (Graph* graph, int id);
 void graph_print(Graph* graph);
+size_t graph_memory_usage (Graph* graph, size_t *vertex_bytes, size_t *edge_bytes);
+int graph_alloc_stats (Graph* graph, GraphAllocStats *stats);
+void graph_alloc_stats_print (Graph* graph);
 
 int graph_DFS (Graph* graph, int start_vertex);
 int graph_BFS (Graph* graph, int start_vertex);
+int graph_bfs_parallel (Graph *graph, int src, int num_workers);
 int graph_dijkstra (Graph *graph, int src);
 int graph_bellman_ford (Graph *graph, int src);
+int graph_dag_shortest_path (Graph *graph, int src, DagPathMode mode);
+int graph_delta_stepping (Graph *graph, int src, graph_dist_t delta, int num_workers);
 int graph_kruskal (Graph *graph);
+int graph_boruvka (Graph *graph, int num_workers);
 int graph_prim (Graph *graph, int start);
 int graph_ford_fulkerson (Graph *graph, int s, int t);
 int graph_floyd_warshall (Graph *graph);
+int graph_shortest_path (Graph *graph, int src, int dest,
+                         graph_dist_t *distance, int *path, int path_len);
+
+GraphCSR* graph_csr_build (Graph* graph);
+void graph_csr_deinit (GraphCSR* csr);
+int graph_csr_index_build (GraphCSR* csr);
+int graph_csr_get_vertex_by_id (GraphCSR* csr, int id);
+GraphCSR* graph_csr_transpose (GraphCSR* csr);
+GraphCSR* graph_csr_reverse (GraphCSR* csr);
+GraphCSR* graph_csr_from_edges (const GraphEdge *edges, int num_edges, int num_vertices,
+                                int flags, struct WorkerPool *pool);
+GraphEdge* graph_csr_edge_array (GraphCSR *csr, int *num_edges);
+int graph_edge_sort (GraphEdge *edges, int num_edges);
+int graph_csr_get_path (GraphCSR *csr, int *prev_node, int i_src, int i_dest,
+                        int *path, int path_len);
+int graph_csr_print_path (GraphCSR *csr, int *prev_node, int src, int dest);
+GraphMat* graph_matrix_init (int numVertices);
+void graph_matrix_deinit (GraphMat *g);
+int graph_csr_to_matrix (GraphCSR *csr, GraphMat **g_mat);
+int graph_matrix_get_path (GraphMat *g_mat, int i_src, int i_dest, int *path, int path_len);
+
+int graph_csr_DFS (GraphCSR* csr, int start_vertex);
+int graph_csr_BFS (GraphCSR* csr, int start_vertex);
+int graph_csr_bfs_parallel (GraphCSR *csr, int src, int num_workers);
+int graph_csr_dijkstra (GraphCSR *csr, int src);
+int graph_csr_bellman_ford (GraphCSR *csr, int src);
+int graph_csr_dag_shortest_path (GraphCSR *csr, int src, DagPathMode mode);
+int graph_csr_delta_stepping (GraphCSR *csr, int src, graph_dist_t delta, int num_workers);
+int graph_csr_kruskal (GraphCSR *csr);
+int graph_csr_boruvka (GraphCSR *csr, int num_workers);
+int graph_csr_prim (GraphCSR *csr, int start);
+int graph_csr_floyd_warshall (GraphCSR *csr);
+int graph_csr_shortest_path (GraphCSR *csr, int src, int dest,
+                             graph_dist_t *distance, int *path, int path_len);
+
+/* Engines on CSR slots, results go to caller-provided arrays of numVertices entries */
+int dfs_search_init (DfsSearch *search, GraphCSR *csr);
+void dfs_search_deinit (DfsSearch *search);
+int dfs_search_root (DfsSearch *search, int i_root);
+DfsEvent dfs_search_next (DfsSearch *search);
+int tarjan_scc (GraphCSR *csr, int *component);
+int topological_sort (GraphCSR *csr, int *order);
+int articulation_points (GraphCSR *csr, char *is_cut, char *is_bridge);
+int bfs (GraphCSR *csr, GraphCSR *rcsr, int src, int *parent, int *depth);
+int bfs_mode (GraphCSR *csr, GraphCSR *rcsr, int src, BfsMode mode, int *parent, int *depth);
+int bfs_parallel (GraphCSR *csr, int src, struct WorkerPool *pool, int *parent, int *depth);
+int ms_bfs (GraphCSR *csr, const int *sources, int num_src, int *depth);
+int dijkstra_search_init (DijkstraSearch *search, GraphCSR *csr, int i_src,
+                          graph_dist_t *distance, int *prev_node);
+void dijkstra_search_deinit (DijkstraSearch *search);
+graph_dist_t dijkstra_search_peek (DijkstraSearch *search);
+int dijkstra_search_settle (DijkstraSearch *search);
+int dijkstra (GraphCSR *csr, int src, int dest, graph_dist_t *distance, int *prev_node);
+int dijkstra_bidirectional (GraphCSR *csr, GraphCSR *rcsr, int i_src, int i_dest,
+                            graph_dist_t *dist_fwd, int *prev_fwd,
+                            graph_dist_t *dist_bwd, int *prev_bwd,
+                            graph_dist_t *distance);
+int delta_stepping (GraphCSR *csr, int src, graph_dist_t delta, struct WorkerPool *pool,
+                    graph_dist_t *distance, int *prev_node);
+int bellman_ford (GraphCSR *csr, int src, graph_dist_t *distance, int *prev_node);
+int bellman_ford_mode (GraphCSR *csr, int src, BellmanFordMode mode, struct WorkerPool *pool,
+                       graph_dist_t *distance, int *prev_node);
+int dag_shortest_path (GraphCSR *csr, int src, DagPathMode mode,
+                       graph_dist_t *distance, int *prev_node);
+int kruskal (GraphCSR *csr, Graph* minimum_span_tree);
+int kruskal_filter (GraphCSR *csr, Graph* minimum_span_tree, struct WorkerPool *pool);
+int boruvka (GraphCSR *csr, Graph* minimum_span_tree, struct WorkerPool *pool);
+int prim (GraphCSR *csr, Graph* minimum_span_tree, int start);
+int floyd_warshall (GraphCSR *csr, struct WorkerPool *pool, GraphMat **g_mat);
+int floyd_warshall_blocked (GraphMat *g_mat, struct WorkerPool *pool);
+int floyd_warshall_naive (GraphMat *g_mat);
+int floyd_warshall_next_hops (GraphCSR *csr, struct WorkerPool *pool, GraphMat *g_mat);
+int astar (GraphCSR *csr, int i_src, int i_dest, GraphHeuristic heuristic, void *arg,
+           graph_dist_t *distance, int *prev_node);
+
+GraphALT* graph_alt_build (GraphCSR *csr, GraphCSR *rcsr, int num_landmarks);
+void graph_alt_deinit (GraphALT *alt);
+graph_dist_t graph_alt_heuristic (int i_vertex, int i_dest, void *arg);
 
 #endif /* __GRAPH_H__ */
\ No newline at end of file
@@ -0,0 +1,648 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "graph.h"
+#include "graph_ch.h"
+#include "indexed_heap.h"
+
+/*
+ * Witness searches give up after this many settled vertices, a missed
+ * witness only costs a shortcut. The priority estimate runs far more often
+ * than the real contraction and gets the tighter limit.
+ */
+#define CH_WITNESS_SETTLE_LIMIT   128
+#define CH_SIMULATE_SETTLE_LIMIT  16
+
+typedef struct ChArcs
+{
+  int size;
+  int capacity;
+  int *vertex;
+  int *mid;
+  graph_dist_t *weight;
+} ChArcs;
+
+typedef struct ChBuilder
+{
+  int numVertices;
+  ChArcs *out;
+  ChArcs *in;
+  int *deleted_neighbors;
+  int *updates;         /* neighbors waiting for a new priority */
+
+  /* Witness search workspace */
+  IndexedHeap *heap;
+  graph_dist_t *dist;
+  int *touched;
+  int numTouched;
+  int *target;          /* search stamp of the vertices the current witness search looks for */
+  int stamp;
+} ChBuilder;
+
+static int ch_arcs_add (ChArcs *arcs, int vertex, graph_dist_t weight, int mid)
+{
+  graph_dist_t *new_weight;
+  int i, capacity, *new_vertex, *new_mid;
+
+  /* Keep a single arc per neighbor, the lighter one wins */
+  for (i = 0; i < arcs->size; ++i)
+  {
+    if (arcs->vertex[i] == vertex)
+    {
+      if (weight < arcs->weight[i])
+      {
+        arcs->weight[i] = weight;
+        arcs->mid[i]    = mid;
+      }
+      return 0;
+    }
+  }
+
+  if (arcs->size == arcs->capacity)
+  {
+    /* Each array keeps its old buffer until all three have grown */
+    capacity = (arcs->capacity) ? arcs->capacity * 2 : 4;
+    new_vertex = (int *)realloc(arcs->vertex, capacity * sizeof (int));
+    if (new_vertex)
+      arcs->vertex = new_vertex;
+    new_mid = (int *)realloc(arcs->mid, capacity * sizeof (int));
+    if (new_mid)
+      arcs->mid = new_mid;
+    new_weight = (graph_dist_t *)realloc(arcs->weight, capacity * sizeof (graph_dist_t));
+    if (new_weight)
+      arcs->weight = new_weight;
+    if (! new_vertex || ! new_mid || ! new_weight)
+    {
+      printf ("[%s,%d] Fail to grow the arc list\n", __func__, __LINE__);
+      return -1;
+    }
+    arcs->capacity = capacity;
+  }
+
+  arcs->vertex[arcs->size]  = vertex;
+  arcs->weight[arcs->size]  = weight;
+  arcs->mid[arcs->size]     = mid;
+  arcs->size++;
+  return 0;
+}
+
+static void ch_arcs_remove (ChArcs *arcs, int vertex)
+{
+  int i;
+
+  for (i = 0; i < arcs->size; ++i)
+  {
+    if (arcs->vertex[i] == vertex)
+    {
+      arcs->size--;
+      arcs->vertex[i] = arcs->vertex[arcs->size];
+      arcs->weight[i] = arcs->weight[arcs->size];
+      arcs->mid[i]    = arcs->mid[arcs->size];
+      return;
+    }
+  }
+}
+
+static void ch_builder_deinit (ChBuilder *b)
+{
+  int i;
+
+  if (b->out)
+  {
+    for (i = 0; i < b->numVertices; ++i)
+    {
+      free (b->out[i].vertex);
+      free (b->out[i].mid);
+      free (b->out[i].weight);
+    }
+    free (b->out);
+  }
+
+  if (b->in)
+  {
+    for (i = 0; i < b->numVertices; ++i)
+    {
+      free (b->in[i].vertex);
+      free (b->in[i].mid);
+      free (b->in[i].weight);
+    }
+    free (b->in);
+  }
+
+  if (b->deleted_neighbors) free (b->deleted_neighbors);
+  if (b->updates)           free (b->updates);
+  if (b->dist)              free (b->dist);
+  if (b->touched)           free (b->touched);
+  if (b->target)            free (b->target);
+  iheap_deinit (b->heap);
+}
+
+static int ch_builder_init (ChBuilder *b, GraphCSR *csr, GraphCSR *rcsr)
+{
+  int i, e;
+
+  memset (b, 0, sizeof (ChBuilder));
+  b->numVertices        = csr->numVertices;
+  b->out                = (ChArcs *)calloc(csr->numVertices, sizeof (ChArcs));
+  b->in                 = (ChArcs *)calloc(csr->numVertices, sizeof (ChArcs));
+  b->deleted_neighbors  = (int *)calloc(csr->numVertices, sizeof (int));
+  b->updates            = (int *)malloc(csr->numVertices * sizeof (int));
+  b->dist               = (graph_dist_t *)malloc(csr->numVertices * sizeof (graph_dist_t));
+  b->touched            = (int *)malloc(csr->numVertices * sizeof (int));
+  b->target             = (int *)calloc(csr->numVertices, sizeof (int));
+  b->heap               = iheap_create (csr->numVertices);
+  if (! b->out || ! b->in || ! b->deleted_neighbors || ! b->updates
+      || ! b->dist || ! b->touched || ! b->target || ! b->heap)
+  {
+    printf ("[%s,%d] Fail to allocate memory for CH builder\n", __func__, __LINE__);
+    return -1;
+  }
+
+  for (i = 0; i < csr->numVertices; ++i)
+  {
+    b->dist[i] = GRAPH_DIST_INFINITY;
+
+    for (e = csr->offsets[i]; e < csr->offsets[i + 1]; ++e)
+    {
+      if (csr->dest[e] != i
+          && ch_arcs_add (&b->out[i], csr->dest[e], csr->weight[e], UNKNOW_VETEX) != 0)
+        return -1;
+    }
+
+    for (e = rcsr->offsets[i]; e < rcsr->offsets[i + 1]; ++e)
+    {
+      if (rcsr->dest[e] != i
+          && ch_arcs_add (&b->in[i], rcsr->dest[e], rcsr->weight[e], UNKNOW_VETEX) != 0)
+        return -1;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Bounded Dijkstra from src over the remaining graph without the vertex skip,
+ * it stops once the num_targets vertices stamped in target are settled
+ */
+static void ch_witness_search (ChBuilder *b, int src, int skip, graph_dist_t limit,
+                               int num_targets, int settle_limit)
+{
+  int64_t key, temp_dist;
+  int u, v, i, settled = 0;
+
+  b->dist[src] = 0;
+  b->touched[b->numTouched++] = src;
+  iheap_push (b->heap, src, 0);
+
+  while ((u = iheap_pop (b->heap, &key)) != -1)
+  {
+    if (key > limit || ++settled > settle_limit)
+      break;
+    if (b->target[u] == b->stamp && --num_targets == 0)
+      break;
+
+    for (i = 0; i < b->out[u].size; ++i)
+    {
+      v = b->out[u].vertex[i];
+      if (v == skip)
+        continue;
+
+      temp_dist = (int64_t)b->dist[u] + b->out[u].weight[i];
+      if (temp_dist < b->dist[v])
+      {
+        if (b->dist[v] == GRAPH_DIST_INFINITY)
+          b->touched[b->numTouched++] = v;
+        b->dist[v] = (graph_dist_t)temp_dist;
+        iheap_push (b->heap, v, temp_dist);
+      }
+    }
+  }
+
+  iheap_clear (b->heap);
+}
+
+static void ch_witness_reset (ChBuilder *b)
+{
+  while (b->numTouched)
+    b->dist[b->touched[--b->numTouched]] = GRAPH_DIST_INFINITY;
+}
+
+/*
+ * Count the shortcuts needed to contract v, and add them unless simulate
+ * is set. A shortcut u -> w is needed when no witness path avoiding v is
+ * as short as u -> v -> w. Return -1 if a shortcut could not be stored.
+ */
+static int ch_contract (ChBuilder *b, int v, int simulate)
+{
+  ChArcs *in = &b->in[v], *out = &b->out[v];
+  int64_t limit, via;
+  int i, j, u, w, num_targets, shortcuts = 0;
+
+  for (i = 0; i < in->size; ++i)
+  {
+    u = in->vertex[i];
+
+    limit = 0;
+    num_targets = 0;
+    b->stamp++;
+    for (j = 0; j < out->size; ++j)
+    {
+      if (out->vertex[j] == u)
+        continue;
+
+      b->target[out->vertex[j]] = b->stamp;
+      num_targets++;
+      if (out->weight[j] > limit)
+        limit = out->weight[j];
+    }
+    if (! num_targets)
+      continue;
+    limit += in->weight[i];
+    if (limit > GRAPH_DIST_INFINITY)
+      limit = GRAPH_DIST_INFINITY;
+
+    ch_witness_search (b, u, v, (graph_dist_t)limit, num_targets,
+                       (simulate) ? CH_SIMULATE_SETTLE_LIMIT : CH_WITNESS_SETTLE_LIMIT);
+    for (j = 0; j < out->size; ++j)
+    {
+      w = out->vertex[j];
+      if (w == u)
+        continue;
+
+      /* A shortcut longer than any distance the type holds is never on a shortest path */
+      via = (int64_t)in->weight[i] + out->weight[j];
+      if (b->dist[w] <= via || via >= GRAPH_DIST_INFINITY)
+        continue;
+
+      shortcuts++;
+      if (! simulate
+          && (ch_arcs_add (&b->out[u], w, via, v) != 0
+              || ch_arcs_add (&b->in[w], u, via, v) != 0))
+      {
+        ch_witness_reset (b);
+        return -1;
+      }
+    }
+    ch_witness_reset (b);
+  }
+
+  return shortcuts;
+}
+
+/* Edge difference, plus the contracted neighbors to spread the contraction evenly */
+static int64_t ch_priority (ChBuilder *b, int v)
+{
+  return (int64_t)ch_contract (b, v, 1) - b->in[v].size - b->out[v].size
+         + b->deleted_neighbors[v];
+}
+
+static int ch_build_arcs (int numVertices, ChArcs *arcs, int **offsets, int **vertex,
+                          int **mid, graph_dist_t **weight)
+{
+  int i, j, n = 0;
+
+  for (i = 0; i < numVertices; ++i)
+    n += arcs[i].size;
+
+  *offsets  = (int *)malloc((numVertices + 1) * sizeof (int));
+  *vertex   = (int *)malloc((n ? n : 1) * sizeof (int));
+  *mid      = (int *)malloc((n ? n : 1) * sizeof (int));
+  *weight   = (graph_dist_t *)malloc((n ? n : 1) * sizeof (graph_dist_t));
+  if (! *offsets || ! *vertex || ! *mid || ! *weight)
+  {
+    printf ("[%s,%d] Fail to allocate memory for CH arcs\n", __func__, __LINE__);
+    return -1;
+  }
+
+  n = 0;
+  for (i = 0; i < numVertices; ++i)
+  {
+    (*offsets)[i] = n;
+    for (j = 0; j < arcs[i].size; ++j, ++n)
+    {
+      (*vertex)[n]  = arcs[i].vertex[j];
+      (*mid)[n]     = arcs[i].mid[j];
+      (*weight)[n]  = arcs[i].weight[j];
+    }
+  }
+  (*offsets)[numVertices] = n;
+
+  return 0;
+}
+
+/*
+ * Contract the vertices one by one in edge difference order (with lazy
+ * updates), then freeze the upward and downward arcs into CSR arrays.
+ * rcsr holds the reversed edges, pass csr again for an undirected graph.
+ */
+GraphCH* graph_ch_build (GraphCSR *csr, GraphCSR *rcsr)
+{
+  GraphCH *ch = NULL;
+  ChBuilder b;
+  IndexedHeap *order = NULL;
+  int64_t priority, top;
+  int i, v, w, next_rank = 0, side, num_updates, shortcuts;
+
+  if (! csr || ! rcsr || ! csr->numVertices
+      || rcsr->numVertices != csr->numVertices)
+    return NULL;
+
+  ch = (GraphCH *)calloc(1, sizeof (GraphCH));
+  if (! ch)
+  {
+    printf ("[%s,%d] Fail to allocate memory for CH\n", __func__, __LINE__);
+    return NULL;
+  }
+  ch->numVertices = csr->numVertices;
+
+  order     = iheap_create (csr->numVertices);
+  ch->rank  = (int *)malloc(csr->numVertices * sizeof (int));
+  if (ch_builder_init (&b, csr, rcsr) != 0 || ! order || ! ch->rank)
+    goto ERR_EXIT;
+
+  for (v = 0; v < csr->numVertices; ++v)
+    iheap_push (order, v, ch_priority (&b, v));
+
+  while ((v = iheap_pop (order, NULL)) != -1)
+  {
+    /* Lazy update: contract only if v is still the cheapest */
+    priority = ch_priority (&b, v);
+    if (iheap_peek (order, &top) != -1 && priority > top)
+    {
+      iheap_push (order, v, priority);
+      continue;
+    }
+
+    shortcuts = ch_contract (&b, v, 0);
+    if (shortcuts < 0)
+      goto ERR_EXIT;
+    ch->numShortcuts += shortcuts;
+    ch->rank[v] = next_rank++;
+
+    /* v keeps its arcs to the remaining vertices, they are its upward/downward arcs */
+    for (i = 0; i < b.out[v].size; ++i)
+    {
+      w = b.out[v].vertex[i];
+      ch_arcs_remove (&b.in[w], v);
+      b.deleted_neighbors[w]++;
+    }
+    for (i = 0; i < b.in[v].size; ++i)
+    {
+      w = b.in[v].vertex[i];
+      ch_arcs_remove (&b.out[w], v);
+      b.deleted_neighbors[w]++;
+    }
+
+    /* Take the neighbors out first so a vertex on both lists is updated once */
+    num_updates = 0;
+    for (side = 0; side < 2; ++side)
+    {
+      ChArcs *arcs = (side) ? &b.in[v] : &b.out[v];
+      for (i = 0; i < arcs->size; ++i)
+      {
+        if (iheap_remove (order, arcs->vertex[i]) == 0)
+          b.updates[num_updates++] = arcs->vertex[i];
+      }
+    }
+    for (i = 0; i < num_updates; ++i)
+      iheap_push (order, b.updates[i], ch_priority (&b, b.updates[i]));
+  }
+
+  if (ch_build_arcs (ch->numVertices, b.out, &ch->upOffsets, &ch->upDest,
+                     &ch->upMid, &ch->upWeight) != 0
+      || ch_build_arcs (ch->numVertices, b.in, &ch->downOffsets, &ch->downSrc,
+                        &ch->downMid, &ch->downWeight) != 0)
+    goto ERR_EXIT;
+
+  for (side = 0; side < 2; ++side)
+  {
+    ch->heap[side]    = iheap_create (ch->numVertices);
+    ch->dist[side]    = (graph_dist_t *)malloc(ch->numVertices * sizeof (graph_dist_t));
+    ch->prev[side]    = (int *)malloc(ch->numVertices * sizeof (int));
+    ch->prevArc[side] = (int *)malloc(ch->numVertices * sizeof (int));
+    if (! ch->heap[side] || ! ch->dist[side] || ! ch->prev[side] || ! ch->prevArc[side])
+      goto ERR_EXIT;
+
+    for (v = 0; v < ch->numVertices; ++v)
+      ch->dist[side][v] = GRAPH_DIST_INFINITY;
+  }
+  ch->touched = (int *)malloc(ch->numVertices * sizeof (int));
+  if (! ch->touched)
+    goto ERR_EXIT;
+
+  iheap_deinit (order);
+  ch_builder_deinit (&b);
+  return ch;
+
+ERR_EXIT:
+  printf ("[%s,%d] Fail to build the contraction hierarchy\n", __func__, __LINE__);
+  iheap_deinit (order);
+  ch_builder_deinit (&b);
+  graph_ch_deinit (ch);
+  return NULL;
+}
+
+void graph_ch_deinit (GraphCH *ch)
+{
+  int side;
+
+  if (! ch)
+    return;
+
+  if (ch->rank)         free (ch->rank);
+  if (ch->upOffsets)    free (ch->upOffsets);
+  if (ch->upDest)       free (ch->upDest);
+  if (ch->upMid)        free (ch->upMid);
+  if (ch->upWeight)     free (ch->upWeight);
+  if (ch->downOffsets)  free (ch->downOffsets);
+  if (ch->downSrc)      free (ch->downSrc);
+  if (ch->downMid)      free (ch->downMid);
+  if (ch->downWeight)   free (ch->downWeight);
+  for (side = 0; side < 2; ++side)
+  {
+    iheap_deinit (ch->heap[side]);
+    if (ch->dist[side])     free (ch->dist[side]);
+    if (ch->prev[side])     free (ch->prev[side]);
+    if (ch->prevArc[side])  free (ch->prevArc[side]);
+  }
+  if (ch->touched)      free (ch->touched);
+  free (ch);
+  ch = NULL;
+}
+
+/*
+ * Append the vertices of arc u -> w after u, expanding shortcuts through
+ * their middle vertex. The middle vertex was contracted before u and w, so
+ * u -> mid is a downward arc stored at mid and mid -> w an upward arc of mid.
+ */
+static int graph_ch_unpack (GraphCH *ch, int u, int w, int mid,
+                            int *path, int *len, int path_len)
+{
+  int a, inner_mid;
+
+  if (mid == UNKNOW_VETEX)
+  {
+    if (*len == path_len)
+      return -1;
+    path[(*len)++] = w;
+    return 0;
+  }
+
+  inner_mid = UNKNOW_VETEX;
+  for (a = ch->downOffsets[mid]; a < ch->downOffsets[mid + 1]; ++a)
+  {
+    if (ch->downSrc[a] == u)
+    {
+      inner_mid = ch->downMid[a];
+      break;
+    }
+  }
+  if (graph_ch_unpack (ch, u, mid, inner_mid, path, len, path_len) != 0)
+    return -1;
+
+  inner_mid = UNKNOW_VETEX;
+  for (a = ch->upOffsets[mid]; a < ch->upOffsets[mid + 1]; ++a)
+  {
+    if (ch->upDest[a] == w)
+    {
+      inner_mid = ch->upMid[a];
+      break;
+    }
+  }
+  return graph_ch_unpack (ch, mid, w, inner_mid, path, len, path_len);
+}
+
+/* Unpack the forward search tree from i_src down to v, source first */
+static int graph_ch_unpack_up (GraphCH *ch, int v, int *path, int *len, int path_len)
+{
+  int u = ch->prev[0][v];
+
+  if (u == UNKNOW_VETEX)
+    return 0;
+
+  if (graph_ch_unpack_up (ch, u, path, len, path_len) != 0)
+    return -1;
+  return graph_ch_unpack (ch, u, v, ch->upMid[ch->prevArc[0][v]], path, len, path_len);
+}
+
+static void graph_ch_reset (GraphCH *ch)
+{
+  int v;
+
+  while (ch->numTouched)
+  {
+    v = ch->touched[--ch->numTouched];
+    ch->dist[0][v] = GRAPH_DIST_INFINITY;
+    ch->dist[1][v] = GRAPH_DIST_INFINITY;
+  }
+  iheap_clear (ch->heap[0]);
+  iheap_clear (ch->heap[1]);
+}
+
+static void graph_ch_reach (GraphCH *ch, int side, int v, graph_dist_t dist, int from, int arc)
+{
+  if (ch->dist[0][v] == GRAPH_DIST_INFINITY && ch->dist[1][v] == GRAPH_DIST_INFINITY)
+    ch->touched[ch->numTouched++] = v;
+
+  ch->dist[side][v]     = dist;
+  ch->prev[side][v]     = from;
+  ch->prevArc[side][v]  = arc;
+  iheap_push (ch->heap[side], v, dist);
+}
+
+/*
+ * Shortest path between slots i_src and i_dest: a forward search on the
+ * upward arcs and a backward search on the downward arcs, each side stops
+ * once its next key can not beat the best meeting point.
+ * The unpacked path (slots, i_src and i_dest included) goes to path if it is
+ * not NULL. Return the number of vertices on the path (1 when path is NULL
+ * and i_dest is reachable), 0 if i_dest is not reachable or the path does
+ * not fit into path_len entries, -1 on error.
+ */
+int graph_ch_query (GraphCH *ch, int i_src, int i_dest, graph_dist_t *distance,
+                    int *path, int path_len)
+{
+  graph_dist_t best = GRAPH_DIST_INFINITY;
+  int64_t key, sum;
+  int side = 0, u, v, a, meet = UNKNOW_VETEX, len, *offsets, *vertex;
+  graph_dist_t *weight;
+
+  if (! ch || ! distance
+      || i_src < 0 || i_src >= ch->numVertices
+      || i_dest < 0 || i_dest >= ch->numVertices)
+    return -1;
+
+  graph_ch_reach (ch, 0, i_src, 0, UNKNOW_VETEX, UNKNOW_VETEX);
+  graph_ch_reach (ch, 1, i_dest, 0, UNKNOW_VETEX, UNKNOW_VETEX);
+
+  while (! iheap_is_empty (ch->heap[0]) || ! iheap_is_empty (ch->heap[1]))
+  {
+    if (iheap_peek (ch->heap[side], &key) == -1 || key >= best)
+    {
+      /* This side can not improve the result any more */
+      iheap_clear (ch->heap[side]);
+      side = 1 - side;
+      continue;
+    }
+
+    u = iheap_pop (ch->heap[side], NULL);
+    if (ch->dist[1 - side][u] != GRAPH_DIST_INFINITY)
+    {
+      /* Both halves are finite, their sum may still not fit a 32-bit graph_dist_t */
+      sum = (int64_t)ch->dist[0][u] + ch->dist[1][u];
+      if (sum < best)
+      {
+        best = (graph_dist_t)sum;
+        meet = u;
+      }
+    }
+
+    offsets = (side) ? ch->downOffsets : ch->upOffsets;
+    vertex  = (side) ? ch->downSrc : ch->upDest;
+    weight  = (side) ? ch->downWeight : ch->upWeight;
+    for (a = offsets[u]; a < offsets[u + 1]; ++a)
+    {
+      v = vertex[a];
+      sum = (int64_t)ch->dist[side][u] + weight[a];
+      if (sum < ch->dist[side][v])
+        graph_ch_reach (ch, side, v, (graph_dist_t)sum, u, a);
+    }
+
+    side = 1 - side;
+  }
+
+  *distance = best;
+  len = 0;
+  if (meet == UNKNOW_VETEX)
+    goto EXIT;
+
+  if (! path)
+  {
+    len = 1;
+    goto EXIT;
+  }
+
+  /* Upward part: i_src .. meet */
+  if (path_len < 1)
+    goto OVERFLOW;
+  path[len++] = i_src;
+  if (graph_ch_unpack_up (ch, meet, path, &len, path_len) != 0)
+    goto OVERFLOW;
+
+  /* Downward part: meet .. i_dest */
+  for (v = meet; v != i_dest; v = ch->prev[1][v])
+  {
+    if (graph_ch_unpack (ch, v, ch->prev[1][v], ch->downMid[ch->prevArc[1][v]],
+                         path, &len, path_len) != 0)
+      goto OVERFLOW;
+  }
+  goto EXIT;
+
+OVERFLOW:
+  len = 0;
+
+EXIT:
+  graph_ch_reset (ch);
+  return len;
+}
@@ -0,0 +1,44 @@
+#ifndef __GRAPH_CH_H__
+#define __GRAPH_CH_H__
+
+#include "graph.h"
+
+/*
+ * Contraction Hierarchy over a frozen CSR snapshot, all vertices are CSR
+ * slots. Every arc goes from a lower ranked to a higher ranked vertex:
+ *    up[v]   : arcs v -> w with rank[w] > rank[v]
+ *    down[v] : arcs u -> v with rank[u] > rank[v], stored at v
+ * mid is the contracted vertex a shortcut bypasses, UNKNOW_VETEX for an
+ * original edge.
+ */
+typedef struct GraphCH
+{
+  int numVertices;
+  int numShortcuts;
+  int *rank;
+
+  int *upOffsets;
+  int *upDest;
+  int *upMid;
+  graph_dist_t *upWeight;
+
+  int *downOffsets;
+  int *downSrc;
+  int *downMid;
+  graph_dist_t *downWeight;
+
+  /* Query workspace, a GraphCH serves one query at a time */
+  struct IndexedHeap *heap[2];
+  graph_dist_t *dist[2];
+  int *prev[2];
+  int *prevArc[2];
+  int *touched;
+  int numTouched;
+} GraphCH;
+
+GraphCH* graph_ch_build (GraphCSR *csr, GraphCSR *rcsr);
+void graph_ch_deinit (GraphCH *ch);
+int graph_ch_query (GraphCH *ch, int i_src, int i_dest, graph_dist_t *distance,
+                    int *path, int path_len);
+
+#endif /* __GRAPH_CH_H__ */
@@ -0,0 +1,568 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "graph.h"
+#include "graph_flow.h"
+
+/*
+ * Push-relabel recomputes the exact heights with a BFS from the sink once
+ * the relabel work passes FACTOR * numVertices + numArcs, every relabel
+ * costs the degree of the vertex plus FLOW_RELABEL_WORK.
+ */
+#define FLOW_GLOBAL_RELABEL_FACTOR  6
+#define FLOW_RELABEL_WORK           12
+
+typedef struct PushRelabel
+{
+  GraphFlow *flow;
+  int *height;          /* numVertices means cut off from the sink */
+  int64_t *excess;
+  int *cur;
+  int *activeHead;      /* per height, vertices with excess */
+  int *activeNext;
+  int *bucketHead;      /* per height, every vertex below numVertices */
+  int *bucketNext;
+  int *bucketPrev;
+  int *queue;
+  int maxActive;
+  int maxHeight;
+  long long work;
+} PushRelabel;
+
+GraphFlow* graph_flow_build (GraphCSR *csr)
+{
+  GraphFlow *flow = NULL;
+  int *fill = NULL;
+  int u, v, e, a, b, num_arcs = 0;
+
+  if (! csr || ! csr->numVertices)
+    return NULL;
+
+  flow = (GraphFlow *)calloc(1, sizeof (GraphFlow));
+  if (! flow)
+  {
+    printf ("[%s,%d] Fail to allocate memory for residual network\n", __func__, __LINE__);
+    return NULL;
+  }
+  flow->numVertices = csr->numVertices;
+
+  flow->offsets = (int *)calloc(csr->numVertices + 1, sizeof (int));
+  if (! flow->offsets)
+    goto ERR_EXIT;
+
+  for (u = 0; u < csr->numVertices; ++u)
+  {
+    for (e = csr->offsets[u]; e < csr->offsets[u + 1]; ++e)
+    {
+      if (csr->weight[e] <= 0)
+        continue;
+      flow->offsets[u + 1]++;
+      flow->offsets[csr->dest[e] + 1]++;
+      num_arcs += 2;
+    }
+  }
+  for (u = 0; u < csr->numVertices; ++u)
+    flow->offsets[u + 1] += flow->offsets[u];
+  flow->numArcs = num_arcs;
+
+  flow->head      = (int *)malloc((num_arcs + 1) * sizeof (int));
+  flow->rev       = (int *)malloc((num_arcs + 1) * sizeof (int));
+  flow->capacity  = (int64_t *)malloc((num_arcs + 1) * sizeof (int64_t));
+  flow->residual  = (int64_t *)malloc((num_arcs + 1) * sizeof (int64_t));
+  fill            = (int *)malloc(csr->numVertices * sizeof (int));
+  if (! flow->head || ! flow->rev || ! flow->capacity || ! flow->residual || ! fill)
+    goto ERR_EXIT;
+
+  memcpy (fill, flow->offsets, csr->numVertices * sizeof (int));
+  for (u = 0; u < csr->numVertices; ++u)
+  {
+    for (e = csr->offsets[u]; e < csr->offsets[u + 1]; ++e)
+    {
+      if (csr->weight[e] <= 0)
+        continue;
+
+      v = csr->dest[e];
+      a = fill[u]++;
+      b = fill[v]++;
+      flow->head[a]     = v;
+      flow->head[b]     = u;
+      flow->rev[a]      = b;
+      flow->rev[b]      = a;
+      flow->capacity[a] = csr->weight[e];
+      flow->capacity[b] = 0;
+    }
+  }
+  memcpy (flow->residual, flow->capacity, num_arcs * sizeof (int64_t));
+
+  free (fill);
+  return flow;
+
+ERR_EXIT:
+  printf ("[%s,%d] Fail to allocate memory for residual arcs\n", __func__, __LINE__);
+  if (fill)
+    free (fill);
+  graph_flow_deinit (flow);
+  return NULL;
+}
+
+void graph_flow_deinit (GraphFlow *flow)
+{
+  if (! flow)
+    return;
+
+  if (flow->offsets)    free (flow->offsets);
+  if (flow->head)       free (flow->head);
+  if (flow->rev)        free (flow->rev);
+  if (flow->capacity)   free (flow->capacity);
+  if (flow->residual)   free (flow->residual);
+  free (flow);
+}
+
+/*
+ * Hops from every vertex to i_t along arcs with residual capacity, -1 if
+ * i_t can not be reached. i_skip is neither labeled nor walked through.
+ */
+static void flow_sink_distance (GraphFlow *flow, int i_t, int i_skip, int *dist, int *queue)
+{
+  int head = 0, tail = 0, v, w, e;
+
+  for (v = 0; v < flow->numVertices; ++v)
+    dist[v] = -1;
+
+  dist[i_t] = 0;
+  queue[tail++] = i_t;
+  while (head < tail)
+  {
+    v = queue[head++];
+    for (e = flow->offsets[v]; e < flow->offsets[v + 1]; ++e)
+    {
+      /* w can push into v through the arc paired with e */
+      w = flow->head[e];
+      if (dist[w] != -1 || w == i_skip || flow->residual[flow->rev[e]] <= 0)
+        continue;
+
+      dist[w] = dist[v] + 1;
+      queue[tail++] = w;
+    }
+  }
+}
+
+static int64_t flow_dinic (GraphFlow *flow, int i_s, int i_t)
+{
+  int *level = NULL, *queue = NULL, *cur = NULL, *path = NULL;
+  int head, tail, v, w, e, i, depth, cut;
+  int64_t total = 0, push;
+
+  level = (int *)malloc(flow->numVertices * sizeof (int));
+  queue = (int *)malloc(flow->numVertices * sizeof (int));
+  cur   = (int *)malloc(flow->numVertices * sizeof (int));
+  path  = (int *)malloc(flow->numVertices * sizeof (int));
+  if (! level || ! queue || ! cur || ! path)
+  {
+    printf ("[%s,%d] Fail to allocate memory for Dinic\n", __func__, __LINE__);
+    total = -1;
+    goto EXIT;
+  }
+
+  for (;;)
+  {
+    /* Level graph, every vertex closer to the source than the sink is expanded */
+    for (v = 0; v < flow->numVertices; ++v)
+      level[v] = -1;
+    level[i_s] = 0;
+    queue[0] = i_s;
+    head = 0;
+    tail = 1;
+    while (head < tail)
+    {
+      v = queue[head++];
+      if (v == i_t)
+        break;
+
+      for (e = flow->offsets[v]; e < flow->offsets[v + 1]; ++e)
+      {
+        w = flow->head[e];
+        if (level[w] == -1 && flow->residual[e] > 0)
+        {
+          level[w] = level[v] + 1;
+          queue[tail++] = w;
+        }
+      }
+    }
+    if (level[i_t] == -1)
+      break;
+
+    /* Blocking flow, path holds the arcs from the source to v */
+    memcpy (cur, flow->offsets, flow->numVertices * sizeof (int));
+    v = i_s;
+    depth = 0;
+    for (;;)
+    {
+      if (v == i_t)
+      {
+        push = INT64_MAX;
+        for (i = 0; i < depth; ++i)
+          if (flow->residual[path[i]] < push)
+            push = flow->residual[path[i]];
+
+        /* Retreat to the tail of the first saturated arc */
+        cut = depth;
+        for (i = 0; i < depth; ++i)
+        {
+          flow->residual[path[i]] -= push;
+          flow->residual[flow->rev[path[i]]] += push;
+          if (cut == depth && flow->residual[path[i]] == 0)
+            cut = i;
+        }
+        total += push;
+
+        depth = cut;
+        v = flow->head[flow->rev[path[cut]]];
+        continue;
+      }
+
+      for (; cur[v] < flow->offsets[v + 1]; ++cur[v])
+      {
+        e = cur[v];
+        if (flow->residual[e] > 0 && level[flow->head[e]] == level[v] + 1)
+          break;
+      }
+
+      if (cur[v] < flow->offsets[v + 1])
+      {
+        path[depth++] = cur[v];
+        v = flow->head[cur[v]];
+        continue;
+      }
+
+      /* Dead end, no more flow goes through v in this phase */
+      if (v == i_s)
+        break;
+      level[v] = -1;
+      v = flow->head[flow->rev[path[--depth]]];
+      cur[v]++;
+    }
+  }
+
+EXIT:
+  if (level)  free (level);
+  if (queue)  free (queue);
+  if (cur)    free (cur);
+  if (path)   free (path);
+  return total;
+}
+
+static void pr_bucket_add (PushRelabel *pr, int v, int h)
+{
+  pr->bucketPrev[v] = -1;
+  pr->bucketNext[v] = pr->bucketHead[h];
+  if (pr->bucketHead[h] != -1)
+    pr->bucketPrev[pr->bucketHead[h]] = v;
+  pr->bucketHead[h] = v;
+
+  if (h > pr->maxHeight)
+    pr->maxHeight = h;
+}
+
+static void pr_bucket_remove (PushRelabel *pr, int v)
+{
+  if (pr->bucketPrev[v] != -1)
+    pr->bucketNext[pr->bucketPrev[v]] = pr->bucketNext[v];
+  else
+    pr->bucketHead[pr->height[v]] = pr->bucketNext[v];
+
+  if (pr->bucketNext[v] != -1)
+    pr->bucketPrev[pr->bucketNext[v]] = pr->bucketPrev[v];
+}
+
+static void pr_active_add (PushRelabel *pr, int v)
+{
+  int h = pr->height[v];
+
+  pr->activeNext[v] = pr->activeHead[h];
+  pr->activeHead[h] = v;
+  if (h > pr->maxActive)
+    pr->maxActive = h;
+}
+
+/* Exact heights from the sink, vertices that can not reach it drop out */
+static void pr_global_relabel (PushRelabel *pr, int i_s, int i_t)
+{
+  GraphFlow *flow = pr->flow;
+  int n = flow->numVertices, v;
+
+  flow_sink_distance (flow, i_t, i_s, pr->height, pr->queue);
+
+  for (v = 0; v <= n; ++v)
+  {
+    pr->activeHead[v] = -1;
+    pr->bucketHead[v] = -1;
+  }
+  pr->maxActive = -1;
+  pr->maxHeight = -1;
+
+  for (v = 0; v < n; ++v)
+  {
+    pr->cur[v] = flow->offsets[v];
+    if (v == i_s || pr->height[v] == -1)
+    {
+      pr->height[v] = n;
+      continue;
+    }
+
+    pr_bucket_add (pr, v, pr->height[v]);
+    if (v != i_t && pr->excess[v] > 0)
+      pr_active_add (pr, v);
+  }
+  pr->work = 0;
+}
+
+/* Nothing is left at height h, nothing above it can reach the sink anymore */
+static void pr_gap (PushRelabel *pr, int h)
+{
+  int n = pr->flow->numVertices, k, v;
+
+  for (k = h + 1; k <= pr->maxHeight; ++k)
+  {
+    for (v = pr->bucketHead[k]; v != -1; v = pr->bucketNext[v])
+      pr->height[v] = n;
+    pr->bucketHead[k] = -1;
+    pr->activeHead[k] = -1;
+  }
+  pr->maxHeight = h - 1;
+}
+
+static void pr_discharge (PushRelabel *pr, int v, int i_t)
+{
+  GraphFlow *flow = pr->flow;
+  int n = flow->numVertices, e, w, h, end;
+  int64_t delta;
+
+  while (pr->excess[v] > 0)
+  {
+    end = flow->offsets[v + 1];
+    for (e = pr->cur[v]; e < end; ++e)
+    {
+      w = flow->head[e];
+      if (flow->residual[e] <= 0 || pr->height[w] + 1 != pr->height[v])
+        continue;
+
+      delta = (pr->excess[v] < flow->residual[e]) ? pr->excess[v] : flow->residual[e];
+      flow->residual[e] -= delta;
+      flow->residual[flow->rev[e]] += delta;
+      if (pr->excess[w] == 0 && w != i_t)
+        pr_active_add (pr, w);
+      pr->excess[w] += delta;
+      pr->excess[v] -= delta;
+      if (pr->excess[v] == 0)
+        break;
+    }
+    pr->cur[v] = e;
+    if (pr->excess[v] == 0)
+      return;
+
+    /* Relabel, v was the last vertex at its height if the bucket runs empty */
+    h = pr->height[v];
+    pr_bucket_remove (pr, v);
+    if (pr->bucketHead[h] == -1)
+    {
+      pr->height[v] = n;
+      pr_gap (pr, h);
+      return;
+    }
+
+    h = n;
+    for (e = flow->offsets[v]; e < end; ++e)
+    {
+      if (flow->residual[e] > 0 && pr->height[flow->head[e]] + 1 < h)
+      {
+        h = pr->height[flow->head[e]] + 1;
+        pr->cur[v] = e;
+      }
+    }
+    pr->work += end - flow->offsets[v] + FLOW_RELABEL_WORK;
+
+    pr->height[v] = h;
+    if (h >= n)
+      return;
+    pr_bucket_add (pr, v, h);
+  }
+}
+
+/*
+ * First phase of push-relabel only: the excess left on vertices that can
+ * not reach the sink never changes the flow value or the cut.
+ */
+static int64_t flow_push_relabel (GraphFlow *flow, int i_s, int i_t)
+{
+  PushRelabel pr;
+  int n = flow->numVertices, v, e;
+  int64_t total = -1;
+
+  memset (&pr, 0, sizeof (pr));
+  pr.flow       = flow;
+  pr.height     = (int *)malloc(n * sizeof (int));
+  pr.excess     = (int64_t *)calloc(n, sizeof (int64_t));
+  pr.cur        = (int *)malloc(n * sizeof (int));
+  pr.activeHead = (int *)malloc((n + 1) * sizeof (int));
+  pr.activeNext = (int *)malloc(n * sizeof (int));
+  pr.bucketHead = (int *)malloc((n + 1) * sizeof (int));
+  pr.bucketNext = (int *)malloc(n * sizeof (int));
+  pr.bucketPrev = (int *)malloc(n * sizeof (int));
+  pr.queue      = (int *)malloc(n * sizeof (int));
+  if (! pr.height || ! pr.excess || ! pr.cur || ! pr.activeHead || ! pr.activeNext
+      || ! pr.bucketHead || ! pr.bucketNext || ! pr.bucketPrev || ! pr.queue)
+  {
+    printf ("[%s,%d] Fail to allocate memory for push-relabel\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  /* Saturate every arc out of the source */
+  for (e = flow->offsets[i_s]; e < flow->offsets[i_s + 1]; ++e)
+  {
+    if (flow->residual[e] <= 0)
+      continue;
+    pr.excess[flow->head[e]] += flow->residual[e];
+    flow->residual[flow->rev[e]] += flow->residual[e];
+    flow->residual[e] = 0;
+  }
+
+  pr_global_relabel (&pr, i_s, i_t);
+  for (;;)
+  {
+    while (pr.maxActive >= 0 && pr.activeHead[pr.maxActive] == -1)
+      pr.maxActive--;
+    if (pr.maxActive < 0)
+      break;
+
+    v = pr.activeHead[pr.maxActive];
+    pr.activeHead[pr.maxActive] = pr.activeNext[v];
+    pr_discharge (&pr, v, i_t);
+
+    if (pr.work > (long long)FLOW_GLOBAL_RELABEL_FACTOR * n + flow->numArcs)
+      pr_global_relabel (&pr, i_s, i_t);
+  }
+  total = pr.excess[i_t];
+
+EXIT:
+  if (pr.height)      free (pr.height);
+  if (pr.excess)      free (pr.excess);
+  if (pr.cur)         free (pr.cur);
+  if (pr.activeHead)  free (pr.activeHead);
+  if (pr.activeNext)  free (pr.activeNext);
+  if (pr.bucketHead)  free (pr.bucketHead);
+  if (pr.bucketNext)  free (pr.bucketNext);
+  if (pr.bucketPrev)  free (pr.bucketPrev);
+  if (pr.queue)       free (pr.queue);
+  return total;
+}
+
+/*
+ * Maximum flow from slot i_s to slot i_t, -1 on error. The residual
+ * capacities start over on every call. source_side, when given, gets
+ * numVertices entries and marks the source side of a minimum cut: the
+ * vertices that can no longer reach i_t.
+ */
+int64_t graph_flow_max (GraphFlow *flow, int i_s, int i_t, GraphFlowMode mode,
+                        char *source_side)
+{
+  int *dist = NULL, *queue = NULL, v;
+  int64_t total;
+
+  if (! flow
+      || i_s < 0 || i_s >= flow->numVertices
+      || i_t < 0 || i_t >= flow->numVertices
+      || i_s == i_t)
+    return -1;
+
+  memcpy (flow->residual, flow->capacity, flow->numArcs * sizeof (int64_t));
+
+  switch (mode)
+  {
+    case GRAPH_FLOW_DINIC:
+      total = flow_dinic (flow, i_s, i_t);
+      break;
+    case GRAPH_FLOW_PUSH_RELABEL:
+      total = flow_push_relabel (flow, i_s, i_t);
+      break;
+    default:
+      printf ("[%s,%d] Unknown max flow mode %d\n", __func__, __LINE__, mode);
+      return -1;
+  }
+
+  if (total < 0 || ! source_side)
+    return total;
+
+  dist  = (int *)malloc(flow->numVertices * sizeof (int));
+  queue = (int *)malloc(flow->numVertices * sizeof (int));
+  if (! dist || ! queue)
+  {
+    printf ("[%s,%d] Fail to allocate memory for minimum cut\n", __func__, __LINE__);
+    total = -1;
+    goto EXIT;
+  }
+
+  flow_sink_distance (flow, i_t, -1, dist, queue);
+  for (v = 0; v < flow->numVertices; ++v)
+    source_side[v] = (dist[v] == -1);
+
+EXIT:
+  if (dist)   free (dist);
+  if (queue)  free (queue);
+  return total;
+}
+
+int graph_max_flow (Graph *graph, int s, int t, GraphFlowMode mode)
+{
+  GraphCSR *csr = NULL;
+  GraphFlow *flow = NULL;
+  char *source_side = NULL;
+  int i_s, i_t, v, rv = -1;
+  int64_t max_flow;
+
+  csr = graph_csr_build (graph);
+  if (! csr)
+  {
+    printf ("[%s,%d] Error, Fail to build CSR snapshot\n", __func__, __LINE__);
+    return -1;
+  }
+
+  i_s = graph_csr_get_vertex_by_id (csr, s);
+  if (i_s == UNKNOW_VETEX)
+  {
+    printf ("[%s,%d] Source vertex %d is not in the graph\n", __func__, __LINE__, s);
+    goto EXIT;
+  }
+
+  i_t = graph_csr_get_vertex_by_id (csr, t);
+  if (i_t == UNKNOW_VETEX)
+  {
+    printf ("[%s,%d] Sink vertex %d is not in the graph\n", __func__, __LINE__, t);
+    goto EXIT;
+  }
+
+  flow        = graph_flow_build (csr);
+  source_side = (char *)malloc(csr->numVertices * sizeof (char));
+  if (! flow || ! source_side)
+    goto EXIT;
+
+  max_flow = graph_flow_max (flow, i_s, i_t, mode, source_side);
+  if (max_flow < 0)
+    goto EXIT;
+
+  printf ("Max Flow of the network is: %lld\n", (long long)max_flow);
+  printf ("Min Cut source side:");
+  for (v = 0; v < csr->numVertices; ++v)
+    if (source_side[v])
+      printf (" %d", csr->ids[v]);
+  printf ("\n");
+  rv = 0;
+
+EXIT:
+  if (source_side)
+    free (source_side);
+  graph_flow_deinit (flow);
+  graph_csr_deinit (csr);
+  return rv;
+}
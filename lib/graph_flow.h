@@ -0,0 +1,39 @@
+#ifndef __GRAPH_FLOW_H__
+#define __GRAPH_FLOW_H__
+
+#include <stdint.h>
+#include "graph.h"
+
+/*
+ * Residual network over a frozen CSR snapshot, all vertices are CSR slots.
+ * Every CSR edge u -> v with weight c > 0 becomes an arc u -> v of capacity
+ * c stored at u, paired with an arc v -> u of capacity 0 stored at v:
+ *    rev[e]      : index of the arc paired with e
+ *    residual[e] : capacity left on e, the flow on e is capacity[e] - residual[e]
+ * An undirected edge shows up twice in the CSR, so it carries c each way.
+ */
+typedef struct GraphFlow
+{
+  int numVertices;
+  int numArcs;
+  int *offsets;
+  int *head;
+  int *rev;
+  int64_t *capacity;
+  int64_t *residual;
+} GraphFlow;
+
+typedef enum GraphFlowMode
+{
+  GRAPH_FLOW_DINIC,         /* level graph and blocking flow with current arcs */
+  GRAPH_FLOW_PUSH_RELABEL   /* highest label preflow with gap and global relabeling */
+} GraphFlowMode;
+
+GraphFlow* graph_flow_build (GraphCSR *csr);
+void graph_flow_deinit (GraphFlow *flow);
+int64_t graph_flow_max (GraphFlow *flow, int i_s, int i_t, GraphFlowMode mode,
+                        char *source_side);
+
+int graph_max_flow (Graph *graph, int s, int t, GraphFlowMode mode);
+
+#endif /* __GRAPH_FLOW_H__ */
@@ -0,0 +1,379 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <ctype.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "graph.h"
+#include "graph_io.h"
+
+#define GRAPH_IO_LINE_MAX       512
+#define GRAPH_IO_INIT_VERTICES  1024
+#define GRAPH_IO_EDGE_BATCH     65536
+
+/* Parse one int field, skip the blanks in front of it */
+static int graph_io_parse_int (char **pos, int *value)
+{
+  char *end;
+  long number;
+
+  errno   = 0;
+  number  = strtol (*pos, &end, 10);
+  if (end == *pos || errno || number < INT_MIN || number > INT_MAX)
+    return -1;
+
+  *value  = (int)number;
+  *pos    = end;
+  return 0;
+}
+
+/*
+ * Load a whitespace separated edge list, one "src dest [weight]" per line,
+ * the weight defaults to 1. Lines starting with '#' or '%' (SNAP, Matrix
+ * Market) and 'c' or 'p' (DIMACS) are skipped, the 'a' / 'e' tag of DIMACS
+ * arc and edge lines is dropped. After a %%MatrixMarket banner the first
+ * data line is the "rows cols entries" size line and is skipped too. flags go to graph_init_flags, so every
+ * line adds an undirected edge unless GRAPH_DIRECTED is set. Self loops are
+ * ignored, the edges go to graph_add_edges in batches. Return NULL on error.
+ */
+Graph* graph_load_edge_list (const char *path, int flags)
+{
+  FILE *fp = NULL;
+  Graph *graph = NULL;
+  GraphEdge *batch = NULL;
+  char line[GRAPH_IO_LINE_MAX], *pos;
+  long long line_no = 0;
+  int src, dest, weight, num_batch = 0, size_line = 0;
+
+  if (! path)
+    return NULL;
+
+  fp = fopen (path, "r");
+  if (! fp)
+  {
+    printf ("[%s,%d] Fail to open %s: %s\n", __func__, __LINE__, path, strerror (errno));
+    return NULL;
+  }
+
+  graph = graph_init_flags (GRAPH_IO_INIT_VERTICES, flags);
+  batch = (GraphEdge *)malloc(GRAPH_IO_EDGE_BATCH * sizeof (GraphEdge));
+  if (! graph || ! batch)
+    goto ERR_EXIT;
+
+  while (fgets (line, sizeof (line), fp))
+  {
+    line_no++;
+    for (pos = line; isspace ((unsigned char)*pos); ++pos)
+      ;
+
+    if (strncmp (pos, "%%MatrixMarket", 14) == 0)
+      size_line = 1;
+    if (*pos == '\0' || *pos == '#' || *pos == '%' || *pos == 'c' || *pos == 'p')
+      continue;
+    if (size_line)
+    {
+      size_line = 0;
+      continue;
+    }
+    if (*pos == 'a' || *pos == 'e')
+      pos++;
+
+    if (graph_io_parse_int (&pos, &src) != 0 || graph_io_parse_int (&pos, &dest) != 0
+        || src < 0 || dest < 0)
+    {
+      printf ("[%s,%d] %s:%lld: expected two vertex ids\n", __func__, __LINE__, path, line_no);
+      goto ERR_EXIT;
+    }
+
+    weight = 1;
+    while (*pos == ' ' || *pos == '\t')
+      pos++;
+    if (*pos != '\0' && *pos != '\n' && *pos != '\r'
+        && graph_io_parse_int (&pos, &weight) != 0)
+    {
+      printf ("[%s,%d] %s:%lld: bad edge weight\n", __func__, __LINE__, path, line_no);
+      goto ERR_EXIT;
+    }
+
+    if (src == dest)
+      continue;
+
+    batch[num_batch].src    = src;
+    batch[num_batch].dest   = dest;
+    batch[num_batch].weight = weight;
+    if (++num_batch == GRAPH_IO_EDGE_BATCH)
+    {
+      if (graph_add_edges (graph, batch, num_batch) != 0)
+        goto ERR_EXIT;
+      num_batch = 0;
+    }
+  }
+
+  if (ferror (fp))
+  {
+    printf ("[%s,%d] Fail to read %s\n", __func__, __LINE__, path);
+    goto ERR_EXIT;
+  }
+
+  if (graph_add_edges (graph, batch, num_batch) != 0)
+    goto ERR_EXIT;
+
+  free (batch);
+  fclose (fp);
+  return graph;
+
+ERR_EXIT:
+  if (batch)
+    free (batch);
+  if (graph)
+    graph_deinit (graph);
+  fclose (fp);
+  return NULL;
+}
+
+static uint64_t graph_file_align (uint64_t offset)
+{
+  return (offset + GRAPH_FILE_ALIGN - 1) / GRAPH_FILE_ALIGN * GRAPH_FILE_ALIGN;
+}
+
+/* Write bytes at offset, zero filling the gap from the current position */
+static int graph_file_write_section (FILE *fp, uint64_t *pos, uint64_t offset,
+                                     const void *data, size_t bytes)
+{
+  static const char zero[GRAPH_FILE_ALIGN];
+
+  if (offset - *pos > sizeof (zero)
+      || fwrite (zero, 1, offset - *pos, fp) != offset - *pos
+      || fwrite (data, 1, bytes, fp) != bytes)
+    return -1;
+
+  *pos = offset + bytes;
+  return 0;
+}
+
+/* Save csr in the binary format, return 0 on success, -1 on error */
+int graph_csr_save (GraphCSR *csr, const char *path)
+{
+  GraphFileHeader header;
+  FILE *fp = NULL;
+  uint64_t pos = 0;
+  int rv = -1;
+
+  if (! csr || ! csr->numVertices || ! path)
+    return -1;
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, GRAPH_FILE_MAGIC, sizeof (header.magic));
+  header.version        = GRAPH_FILE_VERSION;
+  header.byteOrder      = GRAPH_FILE_BYTE_ORDER;
+  header.flags          = (csr->directed) ? GRAPH_FILE_DIRECTED : 0;
+  header.numVertices    = csr->numVertices;
+  header.numEdges       = csr->numEdges;
+  header.idsOffset      = graph_file_align (sizeof (header));
+  header.offsetsOffset  = graph_file_align (header.idsOffset + (uint64_t)csr->numVertices * sizeof (int32_t));
+  header.destOffset     = graph_file_align (header.offsetsOffset + ((uint64_t)csr->numVertices + 1) * sizeof (int32_t));
+  header.weightOffset   = graph_file_align (header.destOffset + (uint64_t)csr->numEdges * sizeof (int32_t));
+
+  fp = fopen (path, "wb");
+  if (! fp)
+  {
+    printf ("[%s,%d] Fail to open %s: %s\n", __func__, __LINE__, path, strerror (errno));
+    return -1;
+  }
+
+  if (graph_file_write_section (fp, &pos, 0, &header, sizeof (header)) != 0
+      || graph_file_write_section (fp, &pos, header.idsOffset, csr->ids,
+                                   csr->numVertices * sizeof (int32_t)) != 0
+      || graph_file_write_section (fp, &pos, header.offsetsOffset, csr->offsets,
+                                   (csr->numVertices + 1) * sizeof (int32_t)) != 0
+      || graph_file_write_section (fp, &pos, header.destOffset, csr->dest,
+                                   csr->numEdges * sizeof (int32_t)) != 0
+      || graph_file_write_section (fp, &pos, header.weightOffset, csr->weight,
+                                   csr->numEdges * sizeof (int32_t)) != 0)
+  {
+    printf ("[%s,%d] Fail to write %s\n", __func__, __LINE__, path);
+    goto EXIT;
+  }
+  rv = 0;
+
+EXIT:
+  if (fclose (fp) != 0)
+    rv = -1;
+  return rv;
+}
+
+#ifdef _WIN32
+static int graph_file_map (GraphMapped *mapped, const char *path)
+{
+  LARGE_INTEGER size;
+
+  mapped->file = CreateFileA (path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+  if (mapped->file == INVALID_HANDLE_VALUE)
+  {
+    mapped->file = NULL;
+    return -1;
+  }
+
+  if (! GetFileSizeEx (mapped->file, &size) || size.QuadPart == 0)
+    return -1;
+  mapped->size = (size_t)size.QuadPart;
+
+  mapped->mapping = CreateFileMappingA (mapped->file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+  if (! mapped->mapping)
+    return -1;
+
+  mapped->base = MapViewOfFile (mapped->mapping, FILE_MAP_COPY, 0, 0, 0);
+  return (mapped->base) ? 0 : -1;
+}
+
+static void graph_file_unmap (GraphMapped *mapped)
+{
+  if (mapped->base)     UnmapViewOfFile (mapped->base);
+  if (mapped->mapping)  CloseHandle (mapped->mapping);
+  if (mapped->file)     CloseHandle (mapped->file);
+}
+#else
+static int graph_file_map (GraphMapped *mapped, const char *path)
+{
+  struct stat st;
+  void *base;
+  int fd;
+
+  fd = open (path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  if (fstat (fd, &st) != 0 || st.st_size == 0)
+  {
+    close (fd);
+    return -1;
+  }
+
+  /* Private mapping, a write by mistake stays in this process */
+  base = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (base == MAP_FAILED)
+    return -1;
+
+  mapped->base = base;
+  mapped->size = st.st_size;
+  return 0;
+}
+
+static void graph_file_unmap (GraphMapped *mapped)
+{
+  if (mapped->base)
+    munmap (mapped->base, mapped->size);
+}
+#endif
+
+static int graph_file_section_fits (GraphMapped *mapped, uint64_t offset, uint64_t count)
+{
+  return offset % GRAPH_FILE_ALIGN == 0
+         && offset <= mapped->size
+         && count <= (mapped->size - offset) / sizeof (int32_t);
+}
+
+/*
+ * Map a file written by graph_csr_save. Only the header and the bounds of
+ * the offsets are checked, the arrays themselves are trusted as written.
+ * Return NULL on error.
+ */
+GraphMapped* graph_csr_map (const char *path)
+{
+  GraphMapped *mapped = NULL;
+  GraphFileHeader *header;
+  char *base;
+
+  if (! path)
+    return NULL;
+
+  mapped = (GraphMapped *)calloc(1, sizeof (GraphMapped));
+  if (! mapped)
+  {
+    printf ("[%s,%d] Fail to allocate memory for mapped graph\n", __func__, __LINE__);
+    return NULL;
+  }
+
+  if (graph_file_map (mapped, path) != 0)
+  {
+    printf ("[%s,%d] Fail to map %s\n", __func__, __LINE__, path);
+    goto ERR_EXIT;
+  }
+
+  base    = (char *)mapped->base;
+  header  = (GraphFileHeader *)base;
+  if (mapped->size < sizeof (GraphFileHeader)
+      || memcmp (header->magic, GRAPH_FILE_MAGIC, sizeof (header->magic)) != 0)
+  {
+    printf ("[%s,%d] %s is not a graph file\n", __func__, __LINE__, path);
+    goto ERR_EXIT;
+  }
+
+  if (header->version != GRAPH_FILE_VERSION || header->byteOrder != GRAPH_FILE_BYTE_ORDER)
+  {
+    printf ("[%s,%d] %s has version %u and byte order 0x%08x, expected %u and 0x%08x\n",
+            __func__, __LINE__, path, header->version, header->byteOrder,
+            GRAPH_FILE_VERSION, GRAPH_FILE_BYTE_ORDER);
+    goto ERR_EXIT;
+  }
+
+  if (header->numVertices <= 0 || header->numVertices >= INT_MAX
+      || header->numEdges < 0 || header->numEdges > INT_MAX
+      || ! graph_file_section_fits (mapped, header->idsOffset, header->numVertices)
+      || ! graph_file_section_fits (mapped, header->offsetsOffset, header->numVertices + 1)
+      || ! graph_file_section_fits (mapped, header->destOffset, header->numEdges)
+      || ! graph_file_section_fits (mapped, header->weightOffset, header->numEdges))
+  {
+    printf ("[%s,%d] %s is truncated or corrupt\n", __func__, __LINE__, path);
+    goto ERR_EXIT;
+  }
+
+  mapped->csr.numVertices = (int)header->numVertices;
+  mapped->csr.numEdges    = (int)header->numEdges;
+  mapped->csr.ids         = (int *)(base + header->idsOffset);
+  mapped->csr.offsets     = (int *)(base + header->offsetsOffset);
+  mapped->csr.dest        = (int *)(base + header->destOffset);
+  mapped->csr.weight      = (int *)(base + header->weightOffset);
+  mapped->csr.directed    = (header->flags & GRAPH_FILE_DIRECTED) ? 1 : 0;
+  if (mapped->csr.offsets[0] != 0
+      || mapped->csr.offsets[mapped->csr.numVertices] != mapped->csr.numEdges)
+  {
+    printf ("[%s,%d] %s has inconsistent offsets\n", __func__, __LINE__, path);
+    goto ERR_EXIT;
+  }
+
+  /* The id index is not part of the file, it is rebuilt on the heap */
+  if (graph_csr_index_build (&mapped->csr) != 0)
+    goto ERR_EXIT;
+
+  return mapped;
+
+ERR_EXIT:
+  graph_csr_unmap (mapped);
+  return NULL;
+}
+
+void graph_csr_unmap (GraphMapped *mapped)
+{
+  if (! mapped)
+    return;
+
+  /* The id index and a reverse built by graph_csr_reverse are on the heap */
+  graph_csr_deinit (mapped->csr.reverse);
+  if (mapped->csr.denseIndex) free (mapped->csr.denseIndex);
+  if (mapped->csr.hashKeys)   free (mapped->csr.hashKeys);
+  if (mapped->csr.hashSlots)  free (mapped->csr.hashSlots);
+  graph_file_unmap (mapped);
+  free (mapped);
+}
@@ -0,0 +1,57 @@
+#ifndef __GRAPH_IO_H__
+#define __GRAPH_IO_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "graph.h"
+
+/*
+ * Binary CSR file, version GRAPH_FILE_VERSION, written in the byte order of
+ * the host that saved it. The header is followed by the ids, offsets, dest
+ * and weight arrays of the CSR as int32, each section starting at a multiple
+ * of GRAPH_FILE_ALIGN bytes so the arrays can be used in place once mapped.
+ */
+#define GRAPH_FILE_MAGIC        "GRAPHCSR"
+#define GRAPH_FILE_VERSION      2
+#define GRAPH_FILE_BYTE_ORDER   0x01020304
+#define GRAPH_FILE_ALIGN        64
+
+/* Header flags */
+#define GRAPH_FILE_DIRECTED     0x1
+
+typedef struct GraphFileHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;       /* reads back as GRAPH_FILE_BYTE_ORDER on a host of the same order */
+  uint32_t flags;
+  uint32_t reserved;
+  int64_t numVertices;
+  int64_t numEdges;
+  uint64_t idsOffset;       /* byte offsets of the sections from the start of the file */
+  uint64_t offsetsOffset;
+  uint64_t destOffset;
+  uint64_t weightOffset;
+} GraphFileHeader;
+
+/*
+ * CSR whose arrays point into a private copy-on-write mapping of the file,
+ * nothing is read before an engine touches the pages. Release it with
+ * graph_csr_unmap, never graph_csr_deinit.
+ */
+typedef struct GraphMapped
+{
+  GraphCSR csr;
+  void *base;
+  size_t size;
+  void *file;               /* file and mapping handles on _WIN32 */
+  void *mapping;
+} GraphMapped;
+
+Graph* graph_load_edge_list (const char *path, int flags);
+
+int graph_csr_save (GraphCSR *csr, const char *path);
+GraphMapped* graph_csr_map (const char *path);
+void graph_csr_unmap (GraphMapped *mapped);
+
+#endif /* __GRAPH_IO_H__ */
@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "indexed_heap.h"
+
+#define IHEAP_ARITY         4
+#define IHEAP_PARENT(i)     (((i) - 1) / IHEAP_ARITY)
+#define IHEAP_CHILD(i)      (IHEAP_ARITY * (i) + 1)
+
+IndexedHeap* iheap_create (int capacity)
+{
+  IndexedHeap *heap = NULL;
+  int i;
+
+  if (capacity <= 0)
+    return NULL;
+
+  heap = (IndexedHeap *)calloc(1, sizeof (IndexedHeap));
+  if (! heap)
+  {
+    printf ("[%s,%d] Fail to allocate memory for indexed heap\n", __func__, __LINE__);
+    return NULL;
+  }
+
+  heap->heap  = (int *)malloc(capacity * sizeof (int));
+  heap->pos   = (int *)malloc(capacity * sizeof (int));
+  heap->key   = (int64_t *)malloc(capacity * sizeof (int64_t));
+  if (! heap->heap || ! heap->pos || ! heap->key)
+  {
+    printf ("[%s,%d] Fail to allocate memory for indexed heap arrays\n", __func__, __LINE__);
+    iheap_deinit (heap);
+    return NULL;
+  }
+
+  for (i = 0; i < capacity; ++i)
+    heap->pos[i] = -1;
+
+  heap->capacity  = capacity;
+  heap->size      = 0;
+  return heap;
+}
+
+void iheap_deinit (IndexedHeap *heap)
+{
+  if (! heap)
+    return;
+
+  if (heap->heap) free (heap->heap);
+  if (heap->pos)  free (heap->pos);
+  if (heap->key)  free (heap->key);
+  free (heap);
+  heap = NULL;
+}
+
+int iheap_is_empty (IndexedHeap *heap)
+{
+  if (! heap)
+    return -1;
+
+  return (heap->size == 0);
+}
+
+int iheap_contains (IndexedHeap *heap, int item)
+{
+  if (! heap || item < 0 || item >= heap->capacity)
+    return 0;
+
+  return (heap->pos[item] != -1);
+}
+
+static void iheap_sift_up (IndexedHeap *heap, int i)
+{
+  int item = heap->heap[i], parent;
+  int64_t key = heap->key[item];
+
+  while (i > 0)
+  {
+    parent = IHEAP_PARENT(i);
+    if (heap->key[heap->heap[parent]] <= key)
+      break;
+
+    heap->heap[i] = heap->heap[parent];
+    heap->pos[heap->heap[i]] = i;
+    i = parent;
+  }
+
+  heap->heap[i]   = item;
+  heap->pos[item] = i;
+}
+
+static void iheap_sift_down (IndexedHeap *heap, int i)
+{
+  int item = heap->heap[i], child, last, smallest, c;
+  int64_t key = heap->key[item];
+
+  while ((child = IHEAP_CHILD(i)) < heap->size)
+  {
+    /* Pick the smallest of the (up to) IHEAP_ARITY children */
+    smallest = child;
+    last = (child + IHEAP_ARITY < heap->size) ? child + IHEAP_ARITY : heap->size;
+    for (c = child + 1; c < last; ++c)
+    {
+      if (heap->key[heap->heap[c]] < heap->key[heap->heap[smallest]])
+        smallest = c;
+    }
+
+    if (heap->key[heap->heap[smallest]] >= key)
+      break;
+
+    heap->heap[i] = heap->heap[smallest];
+    heap->pos[heap->heap[i]] = i;
+    i = smallest;
+  }
+
+  heap->heap[i]   = item;
+  heap->pos[item] = i;
+}
+
+/*
+ * Insert the item, or decrease its key if it is already in the heap
+ * Return 0 if the heap changed, 1 if the item is already in the heap with
+ * a key that is not larger, -1 on error
+ */
+int iheap_push (IndexedHeap *heap, int item, int64_t key)
+{
+  if (! heap || item < 0 || item >= heap->capacity)
+    return -1;
+
+  if (heap->pos[item] != -1)
+  {
+    if (key >= heap->key[item])
+      return 1;
+
+    heap->key[item] = key;
+    iheap_sift_up (heap, heap->pos[item]);
+    return 0;
+  }
+
+  heap->key[item]         = key;
+  heap->heap[heap->size]  = item;
+  heap->pos[item]         = heap->size;
+  heap->size++;
+  iheap_sift_up (heap, heap->size - 1);
+  return 0;
+}
+
+int iheap_remove (IndexedHeap *heap, int item)
+{
+  int i, last;
+
+  if (! heap || item < 0 || item >= heap->capacity
+      || heap->pos[item] == -1)
+    return -1;
+
+  i = heap->pos[item];
+  heap->pos[item] = -1;
+  heap->size--;
+  if (i == heap->size)
+    return 0;
+
+  /* Move the last item into the hole and restore the heap order */
+  last = heap->heap[heap->size];
+  heap->heap[i]   = last;
+  heap->pos[last] = i;
+  if (i > 0 && heap->key[last] < heap->key[heap->heap[IHEAP_PARENT(i)]])
+    iheap_sift_up (heap, i);
+  else
+    iheap_sift_down (heap, i);
+
+  return 0;
+}
+
+/* Return the item with the smallest key without removing it, -1 if the heap is empty */
+int iheap_peek (IndexedHeap *heap, int64_t *key)
+{
+  if (! heap || ! heap->size)
+    return -1;
+
+  if (key)
+    *key = heap->key[heap->heap[0]];
+  return heap->heap[0];
+}
+
+/* Remove and return the item with the smallest key, -1 if the heap is empty */
+int iheap_pop (IndexedHeap *heap, int64_t *key)
+{
+  int top;
+
+  top = iheap_peek (heap, key);
+  if (top == -1)
+    return -1;
+
+  iheap_remove (heap, top);
+  return top;
+}
+
+/* Empty the heap in O(size), the arrays are kept for the next run */
+void iheap_clear (IndexedHeap *heap)
+{
+  int i;
+
+  if (! heap)
+    return;
+
+  for (i = 0; i < heap->size; ++i)
+    heap->pos[heap->heap[i]] = -1;
+  heap->size = 0;
+}
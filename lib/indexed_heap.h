@@ -0,0 +1,29 @@
+#ifndef __INDEXED_HEAP_H__
+#define __INDEXED_HEAP_H__
+
+#include <stdint.h>
+
+/*
+ * Min 4-ary heap over the items 0 .. capacity - 1, each item is in the heap
+ * at most once and its position is tracked so its key can be decreased
+ */
+typedef struct IndexedHeap
+{
+  int capacity;
+  int size;
+  int *heap;      /* heap position -> item */
+  int *pos;       /* item -> heap position, -1 if the item is not in the heap */
+  int64_t *key;   /* item -> key */
+} IndexedHeap;
+
+IndexedHeap* iheap_create (int capacity);
+void iheap_deinit (IndexedHeap *heap);
+int iheap_is_empty (IndexedHeap *heap);
+int iheap_contains (IndexedHeap *heap, int item);
+int iheap_push (IndexedHeap *heap, int item, int64_t key);
+int iheap_remove (IndexedHeap *heap, int item);
+int iheap_peek (IndexedHeap *heap, int64_t *key);
+int iheap_pop (IndexedHeap *heap, int64_t *key);
+void iheap_clear (IndexedHeap *heap);
+
+#endif /* __INDEXED_HEAP_H__ */
@@ -129,12 +129,22 @@ void pq_print (PriorityQueue *pq)
 
 int pq_add_node (PriorityQueue *pq, void *data)
 {
+  int i;
+
   if (!pq || !pq->nodes
       || pq->size == pq->capacity)
     return -1;
 
-  pq->nodes[pq->size++].data = data;
-  pq_heapify (pq);
+  /* Sift the new node up until its parent is no larger */
+  i = pq->size++;
+  pq->nodes[i].data = data;
+  while (i > 0 && (pq->pq_cmp)
+         && (*pq->pq_cmp)(pq->nodes[i].data, pq->nodes[(i - 1)/2].data) < 0)
+  {
+    pq_node_swap (&pq->nodes[i], &pq->nodes[(i - 1)/2]);
+    i = (i - 1)/2;
+  }
+  return 0;
 }
 
 int pq_add (PriorityQueue *pq, void *data)
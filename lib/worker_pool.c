@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "worker_pool.h"
+
+static void* wpool_thread (void *data)
+{
+  WorkerArg *arg = (WorkerArg *)data;
+  WorkerPool *pool = arg->pool;
+  unsigned int seen = 0;
+  WorkerTask task;
+  void *task_arg;
+
+  for (;;)
+  {
+    pthread_mutex_lock (&pool->lock);
+    while (pool->round == seen && ! pool->stop)
+      pthread_cond_wait (&pool->wake, &pool->lock);
+    if (pool->stop)
+    {
+      pthread_mutex_unlock (&pool->lock);
+      break;
+    }
+    seen      = pool->round;
+    task      = pool->task;
+    task_arg  = pool->arg;
+    pthread_mutex_unlock (&pool->lock);
+
+    task (arg->worker, pool->numWorkers, task_arg);
+
+    pthread_mutex_lock (&pool->lock);
+    if (--pool->busy == 0)
+      pthread_cond_signal (&pool->done);
+    pthread_mutex_unlock (&pool->lock);
+  }
+
+  return NULL;
+}
+
+WorkerPool* wpool_create (int num_workers)
+{
+  WorkerPool *pool = NULL;
+  int i;
+
+  if (num_workers <= 0)
+    return NULL;
+
+  pool = (WorkerPool *)calloc(1, sizeof (WorkerPool));
+  if (! pool)
+  {
+    printf ("[%s,%d] Fail to allocate memory for worker pool\n", __func__, __LINE__);
+    return NULL;
+  }
+
+  pool->threads = (pthread_t *)malloc(num_workers * sizeof (pthread_t));
+  pool->args    = (WorkerArg *)malloc(num_workers * sizeof (WorkerArg));
+  if (! pool->threads || ! pool->args)
+  {
+    printf ("[%s,%d] Fail to allocate memory for worker threads\n", __func__, __LINE__);
+    if (pool->threads)  free (pool->threads);
+    if (pool->args)     free (pool->args);
+    free (pool);
+    return NULL;
+  }
+
+  pthread_mutex_init (&pool->lock, NULL);
+  pthread_cond_init (&pool->wake, NULL);
+  pthread_cond_init (&pool->done, NULL);
+
+  /* Worker 0 is the thread calling wpool_run */
+  pool->numWorkers = 1;
+  for (i = 1; i < num_workers; ++i)
+  {
+    pool->args[i].pool    = pool;
+    pool->args[i].worker  = i;
+    if (pthread_create (&pool->threads[i], NULL, wpool_thread, &pool->args[i]) != 0)
+    {
+      printf ("[%s,%d] Fail to start worker %d\n", __func__, __LINE__, i);
+      wpool_deinit (pool);
+      return NULL;
+    }
+    pool->numWorkers++;
+  }
+
+  return pool;
+}
+
+void wpool_deinit (WorkerPool *pool)
+{
+  int i;
+
+  if (! pool)
+    return;
+
+  pthread_mutex_lock (&pool->lock);
+  pool->stop = 1;
+  pthread_cond_broadcast (&pool->wake);
+  pthread_mutex_unlock (&pool->lock);
+
+  for (i = 1; i < pool->numWorkers; ++i)
+    pthread_join (pool->threads[i], NULL);
+
+  pthread_mutex_destroy (&pool->lock);
+  pthread_cond_destroy (&pool->wake);
+  pthread_cond_destroy (&pool->done);
+  free (pool->threads);
+  free (pool->args);
+  free (pool);
+  pool = NULL;
+}
+
+/* Run task on every worker and wait for all of them */
+int wpool_run (WorkerPool *pool, WorkerTask task, void *arg)
+{
+  if (! pool || ! task)
+    return -1;
+
+  if (pool->numWorkers == 1)
+  {
+    task (0, 1, arg);
+    return 0;
+  }
+
+  pthread_mutex_lock (&pool->lock);
+  pool->task  = task;
+  pool->arg   = arg;
+  pool->busy  = pool->numWorkers - 1;
+  pool->round++;
+  pthread_cond_broadcast (&pool->wake);
+  pthread_mutex_unlock (&pool->lock);
+
+  task (0, pool->numWorkers, arg);
+
+  pthread_mutex_lock (&pool->lock);
+  while (pool->busy)
+    pthread_cond_wait (&pool->done, &pool->lock);
+  pthread_mutex_unlock (&pool->lock);
+
+  return 0;
+}
+
+/* Split 0 .. n - 1 into num_workers contiguous chunks, return the one of worker */
+void wpool_range (int worker, int num_workers, int n, int *begin, int *end)
+{
+  *begin  = (int)((long long)n * worker / num_workers);
+  *end    = (int)((long long)n * (worker + 1) / num_workers);
+}
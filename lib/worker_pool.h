@@ -0,0 +1,39 @@
+#ifndef __WORKER_POOL_H__
+#define __WORKER_POOL_H__
+
+#include <pthread.h>
+
+/*
+ * Fixed set of worker threads for data parallel loops. wpool_run hands the
+ * same task to every worker, the calling thread works as worker 0, and
+ * returns once all of them are done, so each run is also a barrier.
+ */
+typedef void (*WorkerTask) (int worker, int num_workers, void *arg);
+
+typedef struct WorkerArg
+{
+  struct WorkerPool *pool;
+  int worker;
+} WorkerArg;
+
+typedef struct WorkerPool
+{
+  int numWorkers;
+  pthread_t *threads;
+  WorkerArg *args;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_cond_t done;
+  WorkerTask task;
+  void *arg;
+  unsigned int round;   /* bumped on every run, wakes the workers */
+  int busy;             /* workers still inside the current run */
+  int stop;
+} WorkerPool;
+
+WorkerPool* wpool_create (int num_workers);
+void wpool_deinit (WorkerPool *pool);
+int wpool_run (WorkerPool *pool, WorkerTask task, void *arg);
+void wpool_range (int worker, int num_workers, int n, int *begin, int *end);
+
+#endif /* __WORKER_POOL_H__ */
@@ -7,6 +7,7 @@
 #ifdef _WIN32
 #include <winsock2.h>
 #include <windows.h>
+#include <sys/time.h>
 #else /* LINUX */
   #include <sys/select.h>
   #include <sys/socket.h>
@@ -14,6 +15,10 @@
   #include <netinet/in.h>
 #endif
 #include "lib/graph.h"
+#include "lib/graph_ch.h"
+#include "lib/graph_flow.h"
+#include "lib/graph_io.h"
+#include "lib/worker_pool.h"
 #include "lib/stack.h"
 #include "lib/queue.h"
 #include "lib/priority_queue.h"
@@ -35,6 +40,35 @@
 #define MIN_RAND            1
 #define MAX_RAND            100
 #define SORT_ARR_LEN        500
+#define GRAPH_SCALE_VERTICES  (10000000)
+#define GRAPH_GRID_SIDE       (300)
+#define GRAPH_QUERY_NUM       (200)
+#define GRAPH_ALT_LANDMARKS   (8)
+#define GRAPH_MAX_THREADS     (32)
+#define GRAPH_BF_VERTICES     (5000)
+#define GRAPH_MST_VERTICES    (1000000)
+#define GRAPH_MST_EDGES       (4000000)
+#define GRAPH_PRIM_VERTICES   (200000)
+#define GRAPH_PRIM_EDGES      (1000000)
+#define GRAPH_PRIM_PQ_VERTICES (5000)
+#define GRAPH_PRIM_PQ_EDGES   (20000)
+#define GRAPH_FLOW_VERTICES   (250000)
+#define GRAPH_FLOW_EDGES      (1000000)
+#define GRAPH_FLOW_TERMINALS  (5000)
+#define GRAPH_FW_VERTICES     (2048)
+#define GRAPH_BFS_VERTICES    (200000)
+#define GRAPH_BFS_EDGES       (3200000)
+#define GRAPH_MS_BFS_VERTICES (50000)
+#define GRAPH_MS_BFS_SOURCES  (256)
+#define GRAPH_DFS_VERTICES    (1000000)
+#define GRAPH_IO_VERTICES     (200000)
+#define GRAPH_IO_EDGES        (2000000)
+#define GRAPH_IO_TEXT_FILE    "graph_edges.txt"
+#define GRAPH_INGEST_VERTICES (500000)
+#define GRAPH_INGEST_EDGES    (4000000)
+#define GRAPH_IO_BIN_FILE     "graph_csr.bin"
+#define GRAPH_DAG_VERTICES    (500000)
+#define GRAPH_DAG_EDGES       (4000000)
 
 EventLoop *event_loop;
 
@@ -610,6 +644,1386 @@ void bp_tree_test (void)
   return;
 }
 
+double graph_bench_seconds (clock_t start)
+{
+  return ((double) (clock() - start)) / CLOCKS_PER_SEC;
+}
+
+/* clock() adds up the CPU time of every thread on Linux, time threaded code on the wall clock */
+double graph_bench_wall_seconds (struct timeval *start)
+{
+  struct timeval now;
+
+  gettimeofday (&now, NULL);
+  return (now.tv_sec - start->tv_sec) + (now.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+/* Build a ring of GRAPH_SCALE_VERTICES vertices from a one slot graph and traverse it */
+void graph_scale_test (void)
+{
+  Graph *graph = NULL;
+  GraphCSR *csr = NULL;
+  Vertex *temp = NULL;
+  size_t vertex_bytes, edge_bytes, csr_bytes;
+  long long checksum = 0;
+  clock_t start;
+  int i, e;
+
+  graph = graph_init (1);
+  if (! graph)
+  {
+    printf ("[%s,%d] Fail to create graph\n", __func__, __LINE__);
+    return;
+  }
+
+  start = clock ();
+  for (i = 0; i < GRAPH_SCALE_VERTICES; ++i)
+    graph_add_edge (graph, i, (i + 1) % GRAPH_SCALE_VERTICES, rand_int (MIN_RAND, MAX_RAND));
+  printf ("Build %d vertices, %d adjacency nodes: %.3f s\n",
+          graph->numVertices, graph->numEdges, graph_bench_seconds (start));
+
+  graph_memory_usage (graph, &vertex_bytes, &edge_bytes);
+  printf ("Adjacency lists: %.1f bytes per vertex, %.1f bytes per edge\n",
+          (double)vertex_bytes / graph->numVertices, (double)edge_bytes / graph->numEdges);
+
+  start = clock ();
+  for (i = 0; i < graph->numVertices; ++i)
+    for (temp = graph->vertices[i]; temp; temp = temp->next)
+      checksum += temp->edge.weight;
+  printf ("Traverse adjacency lists: %.3f s (checksum %lld)\n", graph_bench_seconds (start), checksum);
+
+  start = clock ();
+  csr = graph_csr_build (graph);
+  if (! csr)
+  {
+    printf ("[%s,%d] Fail to build CSR snapshot\n", __func__, __LINE__);
+    graph_deinit (graph);
+    return;
+  }
+  printf ("Build CSR snapshot: %.3f s\n", graph_bench_seconds (start));
+
+  csr_bytes = (size_t)csr->numVertices * 2 * sizeof (int);
+  printf ("CSR snapshot: %.1f bytes per vertex, %.1f bytes per edge\n",
+          (double)csr_bytes / csr->numVertices, 2.0 * sizeof (int));
+
+  checksum = 0;
+  start = clock ();
+  for (i = 0; i < csr->numVertices; ++i)
+    for (e = csr->offsets[i]; e < csr->offsets[i + 1]; ++e)
+      checksum += csr->weight[e];
+  printf ("Traverse CSR snapshot: %.3f s (checksum %lld)\n", graph_bench_seconds (start), checksum);
+
+  graph_csr_deinit (csr);
+  graph_deinit (graph);
+  return;
+}
+
+/* Road-like test graph: GRAPH_GRID_SIDE x GRAPH_GRID_SIDE grid with random weights */
+Graph *graph_grid_create (void)
+{
+  Graph *graph = NULL;
+  int row, col, id;
+
+  graph = graph_init (GRAPH_GRID_SIDE * GRAPH_GRID_SIDE);
+  if (! graph)
+    return NULL;
+
+  for (row = 0; row < GRAPH_GRID_SIDE; ++row)
+  {
+    for (col = 0; col < GRAPH_GRID_SIDE; ++col)
+    {
+      id = row * GRAPH_GRID_SIDE + col;
+      if (col + 1 < GRAPH_GRID_SIDE)
+        graph_add_edge (graph, id, id + 1, rand_int (MIN_RAND, MAX_RAND));
+      if (row + 1 < GRAPH_GRID_SIDE)
+        graph_add_edge (graph, id, id + GRAPH_GRID_SIDE, rand_int (MIN_RAND, MAX_RAND));
+    }
+  }
+
+  return graph;
+}
+
+/* Random graph of num_edges draws without self loops, unit weights unless weighted */
+Graph *graph_random_create (int num_vertices, int num_edges, int weighted)
+{
+  Graph *graph = NULL;
+  int i, src, dest;
+
+  graph = graph_init (num_vertices);
+  if (! graph)
+    return NULL;
+
+  for (i = 0; i < num_edges; ++i)
+  {
+    src   = rand () % num_vertices;
+    dest  = rand () % num_vertices;
+    if (src != dest)
+      graph_add_edge (graph, src, dest, (weighted) ? rand_int (MIN_RAND, MAX_RAND) : 1);
+  }
+
+  return graph;
+}
+
+/* Random weighted edge array, a self loop is moved to the next vertex */
+GraphEdge *graph_random_edges (int num_vertices, int num_edges)
+{
+  GraphEdge *edges = NULL;
+  int i;
+
+  edges = (GraphEdge *)malloc(num_edges * sizeof (GraphEdge));
+  if (! edges)
+    return NULL;
+
+  for (i = 0; i < num_edges; ++i)
+  {
+    edges[i].src    = rand () % num_vertices;
+    edges[i].dest   = rand () % num_vertices;
+    edges[i].weight = rand_int (MIN_RAND, MAX_RAND);
+    if (edges[i].src == edges[i].dest)
+      edges[i].dest = (edges[i].dest + 1) % num_vertices;
+  }
+
+  return edges;
+}
+
+/* Settled vertices and latency of Dijkstra vs A* with ALT bounds on the same queries */
+void graph_alt_test (void)
+{
+  Graph *graph = NULL;
+  GraphCSR *csr = NULL;
+  GraphALT *alt = NULL;
+  graph_dist_t *distance = NULL, dijkstra_dist;
+  int *prev_node = NULL, src[GRAPH_QUERY_NUM], dest[GRAPH_QUERY_NUM];
+  long long settled_dijkstra = 0, settled_alt = 0;
+  double time_dijkstra, time_alt;
+  clock_t start;
+  int i, mismatch = 0;
+
+  graph = graph_grid_create ();
+  csr = graph_csr_build (graph);
+  if (! csr)
+  {
+    printf ("[%s,%d] Fail to build the test graph\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  distance  = (graph_dist_t *)malloc(csr->numVertices * sizeof (graph_dist_t));
+  prev_node = (int *)malloc(csr->numVertices * sizeof (int));
+  if (! distance || ! prev_node)
+    goto EXIT;
+
+  start = clock ();
+  alt = graph_alt_build (csr, csr, GRAPH_ALT_LANDMARKS);
+  if (! alt)
+    goto EXIT;
+  printf ("ALT preprocessing, %d landmarks: %.3f s\n", alt->numLandmarks, graph_bench_seconds (start));
+
+  for (i = 0; i < GRAPH_QUERY_NUM; ++i)
+  {
+    src[i]  = rand_int (0, csr->numVertices - 1);
+    dest[i] = rand_int (0, csr->numVertices - 1);
+  }
+
+  start = clock ();
+  for (i = 0; i < GRAPH_QUERY_NUM; ++i)
+    settled_dijkstra += astar (csr, src[i], dest[i], NULL, NULL, distance, prev_node);
+  time_dijkstra = graph_bench_seconds (start);
+
+  start = clock ();
+  for (i = 0; i < GRAPH_QUERY_NUM; ++i)
+    settled_alt += astar (csr, src[i], dest[i], graph_alt_heuristic, alt, distance, prev_node);
+  time_alt = graph_bench_seconds (start);
+
+  for (i = 0; i < GRAPH_QUERY_NUM; ++i)
+  {
+    astar (csr, src[i], dest[i], NULL, NULL, distance, prev_node);
+    dijkstra_dist = distance[dest[i]];
+    astar (csr, src[i], dest[i], graph_alt_heuristic, alt, distance, prev_node);
+    if (distance[dest[i]] != dijkstra_dist)
+      mismatch++;
+  }
+
+  printf ("Dijkstra: %.1f settled, %.3f ms per query\n",
+          (double)settled_dijkstra / GRAPH_QUERY_NUM, 1000 * time_dijkstra / GRAPH_QUERY_NUM);
+  printf ("A* + ALT: %.1f settled, %.3f ms per query\n",
+          (double)settled_alt / GRAPH_QUERY_NUM, 1000 * time_alt / GRAPH_QUERY_NUM);
+  printf ("Distance mismatches: %d\n", mismatch);
+
+EXIT:
+  if (distance)   free (distance);
+  if (prev_node)  free (prev_node);
+  graph_alt_deinit (alt);
+  graph_csr_deinit (csr);
+  if (graph)
+    graph_deinit (graph);
+  return;
+}
+
+void graph_ch_test (void)
+{
+  Graph *graph = NULL;
+  GraphCSR *csr = NULL;
+  GraphCH *ch = NULL;
+  graph_dist_t *distance = NULL, ch_dist;
+  int *prev_node = NULL, src[GRAPH_QUERY_NUM], dest[GRAPH_QUERY_NUM];
+  double time_dijkstra, time_ch;
+  clock_t start;
+  int i, mismatch = 0;
+
+  graph = graph_grid_create ();
+  csr = graph_csr_build (graph);
+  if (! csr)
+  {
+    printf ("[%s,%d] Fail to build the test graph\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  distance  = (graph_dist_t *)malloc(csr->numVertices * sizeof (graph_dist_t));
+  prev_node = (int *)malloc(csr->numVertices * sizeof (int));
+  if (! distance || ! prev_node)
+    goto EXIT;
+
+  start = clock ();
+  ch = graph_ch_build (csr, csr);
+  if (! ch)
+    goto EXIT;
+  printf ("CH preprocessing: %.3f s, %d shortcuts for %d edges\n",
+          graph_bench_seconds (start), ch->numShortcuts, csr->offsets[csr->numVertices]);
+
+  for (i = 0; i < GRAPH_QUERY_NUM; ++i)
+  {
+    src[i]  = rand_int (0, csr->numVertices - 1);
+    dest[i] = rand_int (0, csr->numVertices - 1);
+  }
+
+  start = clock ();
+  for (i = 0; i < GRAPH_QUERY_NUM; ++i)
+    astar (csr, src[i], dest[i], NULL, NULL, distance, prev_node);
+  time_dijkstra = graph_bench_seconds (start);
+
+  start = clock ();
+  for (i = 0; i < GRAPH_QUERY_NUM; ++i)
+    graph_ch_query (ch, src[i], dest[i], &ch_dist, prev_node, csr->numVertices);
+  time_ch = graph_bench_seconds (start);
+
+  for (i = 0; i < GRAPH_QUERY_NUM; ++i)
+  {
+    astar (csr, src[i], dest[i], NULL, NULL, distance, prev_node);
+    graph_ch_query (ch, src[i], dest[i], &ch_dist, NULL, 0);
+    if (distance[dest[i]] != ch_dist)
+      mismatch++;
+  }
+
+  printf ("Dijkstra: %.3f ms per query\n", 1000 * time_dijkstra / GRAPH_QUERY_NUM);
+  printf ("CH (with path unpacking): %.3f ms per query, %.1fx faster\n",
+          1000 * time_ch / GRAPH_QUERY_NUM, (time_ch > 0) ? time_dijkstra / time_ch : 0);
+  printf ("Distance mismatches: %d\n", mismatch);
+
+EXIT:
+  if (distance)   free (distance);
+  if (prev_node)  free (prev_node);
+  graph_ch_deinit (ch);
+  graph_csr_deinit (csr);
+  if (graph)
+    graph_deinit (graph);
+  return;
+}
+
+void graph_delta_stepping_test (void)
+{
+  Graph *graph = NULL;
+  GraphCSR *csr = NULL;
+  WorkerPool *pool = NULL;
+  graph_dist_t *distance = NULL, *dijkstra_dist = NULL;
+  int *prev_node = NULL, src, i, num_workers, mismatch;
+  struct timeval start;
+  double time_dijkstra, time_delta;
+
+  graph = graph_grid_create ();
+  csr = graph_csr_build (graph);
+  if (! csr)
+  {
+    printf ("[%s,%d] Fail to build the test graph\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  distance      = (graph_dist_t *)malloc(csr->numVertices * sizeof (graph_dist_t));
+  dijkstra_dist = (graph_dist_t *)malloc(csr->numVertices * sizeof (graph_dist_t));
+  prev_node     = (int *)malloc(csr->numVertices * sizeof (int));
+  if (! distance || ! dijkstra_dist || ! prev_node)
+    goto EXIT;
+
+  src = csr->ids[rand_int (0, csr->numVertices - 1)];
+  gettimeofday (&start, NULL);
+  dijkstra (csr, src, UNKNOW_VETEX, dijkstra_dist, prev_node);
+  time_dijkstra = graph_bench_wall_seconds (&start);
+  printf ("Dijkstra: %.3f s\n", time_dijkstra);
+
+  for (num_workers = 1; num_workers <= GRAPH_MAX_THREADS; num_workers *= 2)
+  {
+    pool = wpool_create (num_workers);
+    if (! pool)
+      goto EXIT;
+
+    gettimeofday (&start, NULL);
+    delta_stepping (csr, src, 0, pool, distance, prev_node);
+    time_delta = graph_bench_wall_seconds (&start);
+
+    mismatch = 0;
+    for (i = 0; i < csr->numVertices; ++i)
+    {
+      if (distance[i] != dijkstra_dist[i])
+        mismatch++;
+    }
+
+    printf ("Delta stepping, %2d threads: %.3f s, %.2fx Dijkstra, %d mismatches\n",
+            num_workers, time_delta, (time_delta > 0) ? time_dijkstra / time_delta : 0, mismatch);
+    wpool_deinit (pool);
+    pool = NULL;
+  }
+
+EXIT:
+  if (distance)       free (distance);
+  if (dijkstra_dist)  free (dijkstra_dist);
+  if (prev_node)      free (prev_node);
+  wpool_deinit (pool);
+  graph_csr_deinit (csr);
+  if (graph)
+    graph_deinit (graph);
+  return;
+}
+
+void graph_bellman_ford_test (void)
+{
+  const char *names[] = {"Full passes", "Early exit", "SPFA", "Parallel"};
+  Graph *graph = NULL;
+  GraphCSR *csr = NULL;
+  WorkerPool *pool = NULL;
+  graph_dist_t *distance = NULL, *full_dist = NULL;
+  int *prev_node = NULL, src, i, mode, rv, mismatch;
+  struct timeval start;
+  double time_mode;
+
+  graph = graph_random_create (GRAPH_BF_VERTICES, 4 * GRAPH_BF_VERTICES, 1);
+  csr   = graph_csr_build (graph);
+  pool  = wpool_create (GRAPH_MAX_THREADS);
+  if (! csr || ! pool)
+  {
+    printf ("[%s,%d] Fail to build the test graph\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  distance  = (graph_dist_t *)malloc(csr->numVertices * sizeof (graph_dist_t));
+  full_dist = (graph_dist_t *)malloc(csr->numVertices * sizeof (graph_dist_t));
+  prev_node = (int *)malloc(csr->numVertices * sizeof (int));
+  if (! distance || ! full_dist || ! prev_node)
+    goto EXIT;
+
+  src = csr->ids[0];
+  for (mode = BELLMAN_FORD_FULL; mode <= BELLMAN_FORD_PARALLEL; ++mode)
+  {
+    gettimeofday (&start, NULL);
+    rv = bellman_ford_mode (csr, src, mode, pool, (mode == BELLMAN_FORD_FULL) ? full_dist : distance,
+                            prev_node);
+    time_mode = graph_bench_wall_seconds (&start);
+
+    mismatch = 0;
+    for (i = 0; mode != BELLMAN_FORD_FULL && i < csr->numVertices; ++i)
+    {
+      if (distance[i] != full_dist[i])
+        mismatch++;
+    }
+    printf ("%-12s: %.3f s, rv %d, %d mismatches\n", names[mode], time_mode, rv, mismatch);
+  }
+
+  /* Any negative edge of an undirected graph is a negative cycle */
+  graph_add_edge (graph, csr->ids[0], csr->ids[1], -1);
+  graph_csr_deinit (csr);
+  csr = graph_csr_build (graph);
+  if (! csr)
+    goto EXIT;
+
+  for (mode = BELLMAN_FORD_FULL; mode <= BELLMAN_FORD_PARALLEL; ++mode)
+  {
+    rv = bellman_ford_mode (csr, src, mode, pool, distance, prev_node);
+    printf ("%-12s with a negative cycle: rv %d\n", names[mode], rv);
+  }
+
+EXIT:
+  if (distance)   free (distance);
+  if (full_dist)  free (full_dist);
+  if (prev_node)  free (prev_node);
+  wpool_deinit (pool);
+  graph_csr_deinit (csr);
+  if (graph)
+    graph_deinit (graph);
+  return;
+}
+
+long long graph_tree_weight (Graph *tree)
+{
+  Vertex *temp = NULL;
+  long long weight = 0;
+  int i;
+
+  for (i = 0; i < tree->numVertices; ++i)
+  {
+    for (temp = tree->vertices[i]; temp; temp = temp->next)
+      weight += temp->edge.weight;
+  }
+
+  /* Every tree edge is stored in both directions */
+  return weight / 2;
+}
+
+void graph_kruskal_test (void)
+{
+  Graph *graph = NULL, *tree = NULL;
+  GraphCSR *csr = NULL;
+  WorkerPool *pool = NULL;
+  struct timeval start;
+  double time_kruskal, time_filter;
+  long long weight;
+  int num_workers;
+
+  graph = graph_random_create (GRAPH_MST_VERTICES, GRAPH_MST_EDGES, 1);
+  csr = graph_csr_build (graph);
+  if (! csr)
+  {
+    printf ("[%s,%d] Fail to build the test graph\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  tree = graph_init (csr->numVertices);
+  if (! tree)
+    goto EXIT;
+
+  gettimeofday (&start, NULL);
+  kruskal (csr, tree);
+  time_kruskal = graph_bench_wall_seconds (&start);
+  weight = graph_tree_weight (tree);
+  printf ("Kruskal: %.3f s, tree weight %lld\n", time_kruskal, weight);
+  graph_deinit (tree);
+  tree = NULL;
+
+  for (num_workers = 1; num_workers <= GRAPH_MAX_THREADS; num_workers *= 2)
+  {
+    pool = wpool_create (num_workers);
+    tree = graph_init (csr->numVertices);
+    if (! pool || ! tree)
+      goto EXIT;
+
+    gettimeofday (&start, NULL);
+    kruskal_filter (csr, tree, pool);
+    time_filter = graph_bench_wall_seconds (&start);
+    printf ("Filter-Kruskal, %2d threads: %.3f s, %.2fx Kruskal, tree weight %s\n",
+            num_workers, time_filter, (time_filter > 0) ? time_kruskal / time_filter : 0,
+            (graph_tree_weight (tree) == weight) ? "matches" : "DIFFERS");
+
+    graph_deinit (tree);
+    tree = graph_init (csr->numVertices);
+    if (! tree)
+      goto EXIT;
+
+    gettimeofday (&start, NULL);
+    boruvka (csr, tree, pool);
+    time_filter = graph_bench_wall_seconds (&start);
+    printf ("Boruvka,        %2d threads: %.3f s, %.2fx Kruskal, tree weight %s\n",
+            num_workers, time_filter, (time_filter > 0) ? time_kruskal / time_filter : 0,
+            (graph_tree_weight (tree) == weight) ? "matches" : "DIFFERS");
+
+    graph_deinit (tree);
+    tree = NULL;
+    wpool_deinit (pool);
+    pool = NULL;
+  }
+
+EXIT:
+  wpool_deinit (pool);
+  if (tree)
+    graph_deinit (tree);
+  graph_csr_deinit (csr);
+  if (graph)
+    graph_deinit (graph);
+  return;
+}
+
+int prim_pq_edge_cmp (void *v1, void *v2)
+{
+  Vertex *vertex_1 = (Vertex *)v1;
+  Vertex *vertex_2 = (Vertex *)v2;
+
+  if (vertex_1->edge.weight != vertex_2->edge.weight)
+    return (vertex_1->edge.weight > vertex_2->edge.weight) ? 1 : -1;
+  if (vertex_1->edge.dest != vertex_2->edge.dest)
+    return (vertex_1->edge.dest > vertex_2->edge.dest) ? 1 : -1;
+  if (vertex_1->id != vertex_2->id)
+    return (vertex_1->id > vertex_2->id) ? 1 : -1;
+  return 0;
+}
+
+/*
+ * Benchmark baseline: lazy Prim on the generic PriorityQueue, the way prim()
+ * ran before the indexed heap. Every pq_add pays the linear pq_find_node and
+ * the heapify, but the whole frontier stays queued so the tree spans the
+ * component of the start slot.
+ */
+int prim_pq_baseline (GraphCSR *csr, Graph *minimum_span_tree, int start)
+{
+  PriorityQueue *pq = NULL;
+  Vertex *edges = NULL, *top = NULL;
+  char *in_tree = NULL;
+  int *dest_slot = NULL;
+  int i, e, u, rv = -1;
+
+  edges     = (Vertex *)malloc(csr->offsets[csr->numVertices] * sizeof (Vertex));
+  dest_slot = (int *)malloc(csr->offsets[csr->numVertices] * sizeof (int));
+  in_tree   = (char *)calloc(csr->numVertices, sizeof (char));
+  pq        = pq_create (csr->offsets[csr->numVertices], prim_pq_edge_cmp, NULL);
+  if (! edges || ! dest_slot || ! in_tree || ! pq)
+    goto EXIT;
+
+  for (i = 0; i < csr->numVertices; ++i)
+  {
+    for (e = csr->offsets[i]; e < csr->offsets[i + 1]; ++e)
+    {
+      edges[e].id           = csr->ids[i];
+      edges[e].edge.dest    = csr->ids[csr->dest[e]];
+      edges[e].edge.weight  = csr->weight[e];
+      dest_slot[e]          = csr->dest[e];
+    }
+  }
+
+  u = start;
+  while (u >= 0)
+  {
+    in_tree[u] = 1;
+    for (e = csr->offsets[u]; e < csr->offsets[u + 1]; ++e)
+      if (! in_tree[csr->dest[e]])
+        pq_add (pq, (void *)&edges[e]);
+
+    u = -1;
+    while (! pq_is_empty (pq))
+    {
+      top = (Vertex *) pq_extract_top (pq);
+      if (top && ! in_tree[dest_slot[top - edges]])
+      {
+        u = dest_slot[top - edges];
+        graph_add_edge (minimum_span_tree, top->id, top->edge.dest, top->edge.weight);
+        break;
+      }
+    }
+  }
+  rv = 0;
+
+EXIT:
+  if (pq)         pq_deinit (pq);
+  if (edges)      free (edges);
+  if (dest_slot)  free (dest_slot);
+  if (in_tree)    free (in_tree);
+  return rv;
+}
+
+/* Random graph on a spanning path, so every engine spans all of it */
+GraphCSR *graph_prim_test_build (int num_vertices, int num_edges)
+{
+  Graph *graph = NULL;
+  GraphCSR *csr = NULL;
+  int i;
+
+  graph = graph_random_create (num_vertices, num_edges, 1);
+  if (! graph)
+    return NULL;
+
+  for (i = 1; i < num_vertices; ++i)
+    graph_add_edge (graph, i - 1, i, rand_int (MIN_RAND, MAX_RAND));
+
+  csr = graph_csr_build (graph);
+  if (! csr)
+    printf ("[%s,%d] Fail to build the test graph\n", __func__, __LINE__);
+  graph_deinit (graph);
+  return csr;
+}
+
+void graph_prim_test (void)
+{
+  Graph *tree = NULL;
+  GraphCSR *csr = NULL;
+  struct timeval start;
+  double time_prim, time_other;
+  long long weight;
+
+  csr = graph_prim_test_build (GRAPH_PRIM_VERTICES, GRAPH_PRIM_EDGES);
+  if (! csr)
+    return;
+
+  tree = graph_init (csr->numVertices);
+  if (! tree)
+    goto EXIT;
+
+  gettimeofday (&start, NULL);
+  prim (csr, tree, 0);
+  time_prim = graph_bench_wall_seconds (&start);
+  weight = graph_tree_weight (tree);
+  printf ("Prim on indexed heap: %.3f s, tree weight %lld\n", time_prim, weight);
+  graph_deinit (tree);
+
+  tree = graph_init (csr->numVertices);
+  if (! tree)
+    goto EXIT;
+
+  gettimeofday (&start, NULL);
+  kruskal (csr, tree);
+  time_other = graph_bench_wall_seconds (&start);
+  printf ("Kruskal:              %.3f s, tree weight %s\n", time_other,
+          (graph_tree_weight (tree) == weight) ? "matches" : "DIFFERS");
+  graph_deinit (tree);
+  tree = NULL;
+  graph_csr_deinit (csr);
+
+  /* The linear pq_add makes the baseline quadratic, so it gets a smaller graph */
+  csr = graph_prim_test_build (GRAPH_PRIM_PQ_VERTICES, GRAPH_PRIM_PQ_EDGES);
+  if (! csr)
+    return;
+
+  tree = graph_init (csr->numVertices);
+  if (! tree)
+    goto EXIT;
+
+  gettimeofday (&start, NULL);
+  prim (csr, tree, 0);
+  time_prim = graph_bench_wall_seconds (&start);
+  weight = graph_tree_weight (tree);
+  graph_deinit (tree);
+
+  tree = graph_init (csr->numVertices);
+  if (! tree)
+    goto EXIT;
+
+  gettimeofday (&start, NULL);
+  prim_pq_baseline (csr, tree, 0);
+  time_other = graph_bench_wall_seconds (&start);
+  printf ("%d vertices: indexed heap %.4f s, PriorityQueue %.3f s", csr->numVertices,
+          time_prim, time_other);
+  if (graph_tree_weight (tree) == weight)
+    printf (", %.1fx, tree weight matches\n", (time_prim > 0) ? time_other / time_prim : 0);
+  else
+    printf (", tree weight DIFFERS\n");
+
+EXIT:
+  if (tree)
+    graph_deinit (tree);
+  graph_csr_deinit (csr);
+  return;
+}
+
+void graph_max_flow_test (void)
+{
+  Graph *graph = NULL;
+  GraphCSR *csr = NULL;
+  GraphFlow *flow = NULL;
+  char *source_side = NULL;
+  struct timeval start;
+  double time_dinic, time_push;
+  int64_t flow_dinic, flow_push;
+  int64_t cut;
+  int i, v, e, i_s, i_t, src, dest;
+
+  graph = graph_init (GRAPH_FLOW_VERTICES + 2);
+  if (! graph)
+    return;
+
+  for (i = 0; i < GRAPH_FLOW_EDGES; ++i)
+  {
+    src   = rand () % GRAPH_FLOW_VERTICES;
+    dest  = rand () % GRAPH_FLOW_VERTICES;
+    if (src != dest)
+      graph_add_edge (graph, src, dest, rand_int (MIN_RAND, MAX_RAND));
+  }
+
+  /* Source and sink feed many vertices so the flow is not a single bottleneck */
+  for (i = 0; i < GRAPH_FLOW_TERMINALS; ++i)
+  {
+    graph_add_edge (graph, GRAPH_FLOW_VERTICES, rand () % GRAPH_FLOW_VERTICES, MAX_RAND * MAX_RAND);
+    graph_add_edge (graph, GRAPH_FLOW_VERTICES + 1, rand () % GRAPH_FLOW_VERTICES, MAX_RAND * MAX_RAND);
+  }
+
+  csr = graph_csr_build (graph);
+  if (csr)
+    flow = graph_flow_build (csr);
+  if (! flow)
+  {
+    printf ("[%s,%d] Fail to build the test network\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  source_side = (char *)malloc(csr->numVertices * sizeof (char));
+  if (! source_side)
+    goto EXIT;
+
+  i_s = graph_csr_get_vertex_by_id (csr, GRAPH_FLOW_VERTICES);
+  i_t = graph_csr_get_vertex_by_id (csr, GRAPH_FLOW_VERTICES + 1);
+  printf ("Network: %d vertices, %d residual arcs\n", flow->numVertices, flow->numArcs);
+
+  gettimeofday (&start, NULL);
+  flow_dinic = graph_flow_max (flow, i_s, i_t, GRAPH_FLOW_DINIC, NULL);
+  time_dinic = graph_bench_wall_seconds (&start);
+  printf ("Dinic:         %.3f s, max flow %lld\n", time_dinic, (long long)flow_dinic);
+
+  gettimeofday (&start, NULL);
+  flow_push = graph_flow_max (flow, i_s, i_t, GRAPH_FLOW_PUSH_RELABEL, source_side);
+  time_push = graph_bench_wall_seconds (&start);
+  printf ("Push-relabel:  %.3f s, max flow %s\n", time_push,
+          (flow_push == flow_dinic) ? "matches" : "DIFFERS");
+
+  /* A minimum cut carries exactly the maximum flow */
+  cut = 0;
+  for (v = 0; v < flow->numVertices; ++v)
+  {
+    if (! source_side[v])
+      continue;
+    for (e = flow->offsets[v]; e < flow->offsets[v + 1]; ++e)
+      if (! source_side[flow->head[e]])
+        cut += flow->capacity[e];
+  }
+  printf ("Min cut capacity %s\n", (cut == flow_push) ? "matches" : "DIFFERS");
+
+EXIT:
+  if (source_side)
+    free (source_side);
+  graph_flow_deinit (flow);
+  graph_csr_deinit (csr);
+  if (graph)
+    graph_deinit (graph);
+  return;
+}
+
+void graph_floyd_warshall_test (void)
+{
+  Graph *graph = NULL;
+  GraphCSR *csr = NULL;
+  GraphMat *naive = NULL, *blocked = NULL;
+  WorkerPool *pool = NULL;
+  struct timeval start;
+  double time_naive, time_blocked;
+  size_t size;
+  long long hops = 0;
+  int i, num_workers, *path = NULL;
+
+  graph = graph_random_create (GRAPH_FW_VERTICES, 4 * GRAPH_FW_VERTICES, 1);
+  csr = graph_csr_build (graph);
+  if (! csr || graph_csr_to_matrix (csr, &naive) != 0)
+  {
+    printf ("[%s,%d] Fail to build the test graph\n", __func__, __LINE__);
+    goto EXIT;
+  }
+  size = (size_t)naive->stride * naive->stride * sizeof (graph_dist_t);
+
+  gettimeofday (&start, NULL);
+  floyd_warshall_naive (naive);
+  time_naive = graph_bench_wall_seconds (&start);
+  printf ("Naive Floyd-Warshall, %d vertices: %.3f s\n", csr->numVertices, time_naive);
+
+  for (num_workers = 1; num_workers <= GRAPH_MAX_THREADS; num_workers *= 2)
+  {
+    pool = wpool_create (num_workers);
+    if (! pool || graph_csr_to_matrix (csr, &blocked) != 0)
+      goto EXIT;
+
+    gettimeofday (&start, NULL);
+    floyd_warshall_blocked (blocked, pool);
+    time_blocked = graph_bench_wall_seconds (&start);
+    printf ("Blocked, %2d threads: %.3f s, %.2fx naive, matrix %s\n",
+            num_workers, time_blocked, (time_blocked > 0) ? time_naive / time_blocked : 0,
+            (memcmp (naive->dist, blocked->dist, size) == 0) ? "matches" : "DIFFERS");
+
+    graph_matrix_deinit (blocked);
+    blocked = NULL;
+    wpool_deinit (pool);
+    pool = NULL;
+  }
+
+  /* Routing table on top of the distances */
+  path = (int *)malloc(csr->numVertices * sizeof (int));
+  if (! path)
+    goto EXIT;
+
+  gettimeofday (&start, NULL);
+  floyd_warshall_next_hops (csr, NULL, naive);
+  printf ("Next hops: %.3f s, %d byte(s) per pair\n", graph_bench_wall_seconds (&start), naive->nextWidth);
+
+  gettimeofday (&start, NULL);
+  for (i = 0; i < GRAPH_QUERY_NUM; ++i)
+    hops += graph_matrix_get_path (naive, rand () % csr->numVertices, rand () % csr->numVertices,
+                                   path, csr->numVertices);
+  printf ("%d path queries: %.6f s, %.1f vertices per path\n", GRAPH_QUERY_NUM,
+          graph_bench_wall_seconds (&start), (double)hops / GRAPH_QUERY_NUM);
+
+EXIT:
+  if (path)
+    free (path);
+  wpool_deinit (pool);
+  graph_matrix_deinit (blocked);
+  graph_matrix_deinit (naive);
+  graph_csr_deinit (csr);
+  if (graph)
+    graph_deinit (graph);
+  return;
+}
+
+void graph_bfs_test (void)
+{
+  Graph *graph = NULL;
+  GraphCSR *csr = NULL;
+  struct timeval start;
+  double time_top_down, time_direction;
+  int i, src, reached, mismatch;
+  int *parent = NULL, *depth = NULL, *depth_ref = NULL;
+
+  /* Low diameter random graph, the frontier blows up after a couple of levels */
+  graph = graph_random_create (GRAPH_BFS_VERTICES, GRAPH_BFS_EDGES, 0);
+  csr = graph_csr_build (graph);
+  if (! csr)
+  {
+    printf ("[%s,%d] Fail to build the test graph\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  parent    = (int *)malloc(csr->numVertices * sizeof (int));
+  depth     = (int *)malloc(csr->numVertices * sizeof (int));
+  depth_ref = (int *)malloc(csr->numVertices * sizeof (int));
+  if (! parent || ! depth || ! depth_ref)
+    goto EXIT;
+
+  src = csr->ids[0];
+  gettimeofday (&start, NULL);
+  reached = bfs_mode (csr, NULL, src, BFS_TOP_DOWN, parent, depth_ref);
+  time_top_down = graph_bench_wall_seconds (&start);
+  printf ("Top-down BFS, %d vertices %d edges: %.3f s, %d reached\n",
+          csr->numVertices, csr->numEdges, time_top_down, reached);
+
+  gettimeofday (&start, NULL);
+  reached = bfs (csr, NULL, src, parent, depth);
+  time_direction = graph_bench_wall_seconds (&start);
+
+  mismatch = 0;
+  for (i = 0; i < csr->numVertices; ++i)
+    if (depth[i] != depth_ref[i])
+      ++mismatch;
+  printf ("Direction-optimizing BFS: %.3f s, %.2fx top-down, %d reached, %d depth mismatch\n",
+          time_direction, (time_direction > 0) ? time_top_down / time_direction : 0,
+          reached, mismatch);
+
+EXIT:
+  if (parent)
+    free (parent);
+  if (depth)
+    free (depth);
+  if (depth_ref)
+    free (depth_ref);
+  graph_csr_deinit (csr);
+  if (graph)
+    graph_deinit (graph);
+  return;
+}
+
+void graph_bfs_parallel_test (void)
+{
+  Graph *graph = NULL;
+  GraphCSR *csr = NULL;
+  WorkerPool *pool = NULL;
+  struct timeval start;
+  double time_serial, time_parallel;
+  int i, src, num_workers, reached, mismatch;
+  int *parent = NULL, *depth = NULL, *depth_ref = NULL;
+
+  graph = graph_random_create (GRAPH_BFS_VERTICES, GRAPH_BFS_EDGES, 0);
+  csr = graph_csr_build (graph);
+  if (! csr)
+  {
+    printf ("[%s,%d] Fail to build the test graph\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  parent    = (int *)malloc(csr->numVertices * sizeof (int));
+  depth     = (int *)malloc(csr->numVertices * sizeof (int));
+  depth_ref = (int *)malloc(csr->numVertices * sizeof (int));
+  if (! parent || ! depth || ! depth_ref)
+    goto EXIT;
+
+  src = csr->ids[0];
+  gettimeofday (&start, NULL);
+  bfs_mode (csr, NULL, src, BFS_TOP_DOWN, parent, depth_ref);
+  time_serial = graph_bench_wall_seconds (&start);
+  printf ("Serial top-down BFS, %d vertices %d edges: %.3f s\n",
+          csr->numVertices, csr->numEdges, time_serial);
+
+  for (num_workers = 1; num_workers <= GRAPH_MAX_THREADS; num_workers *= 2)
+  {
+    pool = wpool_create (num_workers);
+    if (! pool)
+      goto EXIT;
+
+    gettimeofday (&start, NULL);
+    reached = bfs_parallel (csr, src, pool, parent, depth);
+    time_parallel = graph_bench_wall_seconds (&start);
+
+    mismatch = 0;
+    for (i = 0; i < csr->numVertices; ++i)
+      if (depth[i] != depth_ref[i])
+        ++mismatch;
+
+    printf ("Parallel BFS, %2d threads: %.3f s, %.2fx serial, %d reached, %d depth mismatch\n",
+            num_workers, time_parallel, (time_parallel > 0) ? time_serial / time_parallel : 0,
+            reached, mismatch);
+    wpool_deinit (pool);
+    pool = NULL;
+  }
+
+EXIT:
+  if (parent)     free (parent);
+  if (depth)      free (depth);
+  if (depth_ref)  free (depth_ref);
+  wpool_deinit (pool);
+  graph_csr_deinit (csr);
+  if (graph)
+    graph_deinit (graph);
+  return;
+}
+
+void graph_ms_bfs_test (void)
+{
+  Graph *graph = NULL;
+  GraphCSR *csr = NULL;
+  struct timeval start;
+  double time_single, time_batch;
+  int i, v, mismatch, sources[GRAPH_MS_BFS_SOURCES];
+  int *depth_all = NULL, *parent = NULL, *depth = NULL;
+
+  graph = graph_random_create (GRAPH_MS_BFS_VERTICES, 8 * GRAPH_MS_BFS_VERTICES, 0);
+  csr = graph_csr_build (graph);
+  if (! csr)
+  {
+    printf ("[%s,%d] Fail to build the test graph\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  depth_all = (int *)malloc((size_t)GRAPH_MS_BFS_SOURCES * csr->numVertices * sizeof (int));
+  parent    = (int *)malloc(csr->numVertices * sizeof (int));
+  depth     = (int *)malloc(csr->numVertices * sizeof (int));
+  if (! depth_all || ! parent || ! depth)
+    goto EXIT;
+
+  for (i = 0; i < GRAPH_MS_BFS_SOURCES; ++i)
+    sources[i] = csr->ids[rand () % csr->numVertices];
+
+  gettimeofday (&start, NULL);
+  ms_bfs (csr, sources, GRAPH_MS_BFS_SOURCES, depth_all);
+  time_batch = graph_bench_wall_seconds (&start);
+
+  mismatch    = 0;
+  time_single = 0;
+  for (i = 0; i < GRAPH_MS_BFS_SOURCES; ++i)
+  {
+    gettimeofday (&start, NULL);
+    bfs_mode (csr, NULL, sources[i], BFS_TOP_DOWN, parent, depth);
+    time_single += graph_bench_wall_seconds (&start);
+
+    for (v = 0; v < csr->numVertices; ++v)
+      if (depth[v] != depth_all[(size_t)i * csr->numVertices + v])
+        ++mismatch;
+  }
+
+  printf ("%d BFS one by one: %.3f s\n", GRAPH_MS_BFS_SOURCES, time_single);
+  printf ("MS-BFS: %.3f s, %.2fx, %d depth mismatch\n", time_batch,
+          (time_batch > 0) ? time_single / time_batch : 0, mismatch);
+
+EXIT:
+  if (depth_all)  free (depth_all);
+  if (parent)     free (parent);
+  if (depth)      free (depth);
+  graph_csr_deinit (csr);
+  if (graph)
+    graph_deinit (graph);
+  return;
+}
+
+void graph_dfs_test (void)
+{
+  Graph *graph = NULL;
+  GraphCSR *csr = NULL;
+  struct timeval start;
+  int i, num_scc, num_cut, num_bridges;
+  int *component = NULL;
+  char *is_cut = NULL, *is_bridge = NULL;
+
+  /* A long chain keeps the DFS tree GRAPH_DFS_VERTICES deep, a few chords close cycles */
+  graph = graph_random_create (GRAPH_DFS_VERTICES, GRAPH_DFS_VERTICES / 100, 0);
+  if (! graph)
+    return;
+
+  for (i = 1; i < GRAPH_DFS_VERTICES; ++i)
+    graph_add_edge (graph, i - 1, i, 1);
+
+  csr = graph_csr_build (graph);
+  if (! csr)
+  {
+    printf ("[%s,%d] Fail to build the test graph\n", __func__, __LINE__);
+    goto EXIT;
+  }
+
+  component = (int *)malloc(csr->numVertices * sizeof (int));
+  is_cut    = (char *)malloc(csr->numVertices * sizeof (char));
+  is_bridge = (char *)malloc(csr->numEdges * sizeof (char));
+  if (! component || ! is_cut || ! is_bridge)
+    goto EXIT;
+
+  gettimeofday (&start, NULL);
+  num_scc = tarjan_scc (csr, component);
+  printf ("Tarjan SCC, %d vertices: %.3f s, %d components\n", csr->numVertices,
+          graph_bench_wall_seconds (&start), num_scc);
+
+  gettimeofday (&start, NULL);
+  num_cut = articulation_points (csr, is_cut, is_bridge);
+  num_bridges = 0;
+  for (i = 0; i < csr->numEdges; ++i)
+    num_bridges += is_bridge[i];
+  printf ("Articulation points: %.3f s, %d cut vertices, %d bridges\n",
+          graph_bench_wall_seconds (&start), num_cut, num_bridges / 2);
+
+EXIT:
+  if (component)  free (component);
+  if (is_cut)     free (is_cut);
+  if (is_bridge)  free (is_bridge);
+  graph_csr_deinit (csr);
+  if (graph)
+    graph_deinit (graph);
+  return;
+}
+
+void graph_io_test (void)
+{
+  FILE *fp = NULL;
+  Graph *graph = NULL;
+  GraphCSR *csr = NULL;
+  GraphMapped *mapped = NULL;
+  struct timeval start;
+  int i, same, *parent = NULL, *depth = NULL;
+
+  fp = fopen (GRAPH_IO_TEXT_FILE, "w");
+  if (! fp)
+    return;
+
+  fprintf (fp, "# %d vertices %d edges\n", GRAPH_IO_VERTICES, GRAPH_IO_EDGES);
+  for (i = 0; i < GRAPH_IO_EDGES; ++i)
+    fprintf (fp, "%d\t%d\t%d\n", rand () % GRAPH_IO_VERTICES, rand () % GRAPH_IO_VERTICES,
+             rand_int (MIN_RAND, MAX_RAND));
+  fclose (fp);
+
+  gettimeofday (&start, NULL);
+  graph = graph_load_edge_list (GRAPH_IO_TEXT_FILE, 0);
+  if (! graph)
+    goto EXIT;
+  printf ("Edge list import, %d edges: %.3f s\n", GRAPH_IO_EDGES, graph_bench_wall_seconds (&start));
+
+  gettimeofday (&start, NULL);
+  csr = graph_csr_build (graph);
+  if (! csr)
+    goto EXIT;
+  printf ("CSR build: %.3f s\n", graph_bench_wall_seconds (&start));
+
+  gettimeofday (&start, NULL);
+  if (graph_csr_save (csr, GRAPH_IO_BIN_FILE) != 0)
+    goto EXIT;
+  printf ("Binary save: %.3f s\n", graph_bench_wall_seconds (&start));
+
+  gettimeofday (&start, NULL);
+  mapped = graph_csr_map (GRAPH_IO_BIN_FILE);
+  if (! mapped)
+    goto EXIT;
+  printf ("Binary map: %.6f s\n", graph_bench_wall_seconds (&start));
+
+  /* The first traversal pays for the page faults */
+  parent  = (int *)malloc(csr->numVertices * sizeof (int));
+  depth   = (int *)malloc(csr->numVertices * sizeof (int));
+  if (! parent || ! depth)
+    goto EXIT;
+
+  gettimeofday (&start, NULL);
+  bfs (&mapped->csr, NULL, mapped->csr.ids[0], parent, depth);
+  printf ("BFS on the mapped CSR: %.3f s\n", graph_bench_wall_seconds (&start));
+
+  same = mapped->csr.numVertices == csr->numVertices
+         && mapped->csr.numEdges == csr->numEdges
+         && memcmp (mapped->csr.offsets, csr->offsets, (csr->numVertices + 1) * sizeof (int)) == 0
+         && memcmp (mapped->csr.dest, csr->dest, csr->numEdges * sizeof (int)) == 0
+         && memcmp (mapped->csr.weight, csr->weight, csr->numEdges * sizeof (int)) == 0;
+  printf ("Mapped CSR %s the built one\n", (same) ? "matches" : "DIFFERS from");
+
+EXIT:
+  if (parent) free (parent);
+  if (depth)  free (depth);
+  graph_csr_unmap (mapped);
+  graph_csr_deinit (csr);
+  if (graph)
+    graph_deinit (graph);
+  remove (GRAPH_IO_TEXT_FILE);
+  remove (GRAPH_IO_BIN_FILE);
+  return;
+}
+
+void graph_add_edges_test (void)
+{
+  Graph *graph_single = NULL, *graph_bulk = NULL;
+  GraphEdge *edges = NULL;
+  struct timeval start;
+  double time_single, time_bulk;
+  int i;
+
+  edges = graph_random_edges (GRAPH_INGEST_VERTICES, GRAPH_INGEST_EDGES);
+  if (! edges)
+    return;
+
+  graph_single  = graph_init (GRAPH_INGEST_VERTICES);
+  graph_bulk    = graph_init (GRAPH_INGEST_VERTICES);
+  if (! graph_single || ! graph_bulk)
+    goto EXIT;
+
+  gettimeofday (&start, NULL);
+  for (i = 0; i < GRAPH_INGEST_EDGES; ++i)
+    graph_add_edge (graph_single, edges[i].src, edges[i].dest, edges[i].weight);
+  time_single = graph_bench_wall_seconds (&start);
+  printf ("graph_add_edge, %d edges: %.3f s\n", GRAPH_INGEST_EDGES, time_single);
+
+  gettimeofday (&start, NULL);
+  graph_add_edges (graph_bulk, edges, GRAPH_INGEST_EDGES);
+  time_bulk = graph_bench_wall_seconds (&start);
+  printf ("graph_add_edges: %.3f s, %.2fx, %d vs %d arcs\n", time_bulk,
+          (time_bulk > 0) ? time_single / time_bulk : 0,
+          graph_bulk->numEdges, graph_single->numEdges);
+
+EXIT:
+  if (graph_single) graph_deinit (graph_single);
+  if (graph_bulk)   graph_deinit (graph_bulk);
+  free (edges);
+  return;
+}
+
+void graph_csr_from_edges_test (void)
+{
+  Graph *graph = NULL;
+  GraphCSR *csr = NULL;
+  GraphEdge *edges = NULL;
+  WorkerPool *pool = NULL;
+  struct timeval start;
+  double time_graph, time_builder;
+  int i, num_workers;
+
+  edges = graph_random_edges (GRAPH_INGEST_VERTICES, GRAPH_INGEST_EDGES);
+  if (! edges)
+    return;
+
+  /* Baseline: the adjacency lists first, then a CSR snapshot of them */
+  gettimeofday (&start, NULL);
+  graph = graph_init (GRAPH_INGEST_VERTICES);
+  if (! graph)
+    goto EXIT;
+  for (i = 0; i < GRAPH_INGEST_EDGES; ++i)
+    graph_add_edge (graph, edges[i].src, edges[i].dest, edges[i].weight);
+  csr = graph_csr_build (graph);
+  time_graph = graph_bench_wall_seconds (&start);
+  printf ("graph_add_edge + graph_csr_build, %d edges: %.3f s\n", GRAPH_INGEST_EDGES, time_graph);
+  graph_csr_deinit (csr);
+  csr = NULL;
+
+  for (num_workers = 1; num_workers <= GRAPH_MAX_THREADS; num_workers *= 2)
+  {
+    pool = wpool_create (num_workers);
+    if (! pool)
+      goto EXIT;
+
+    gettimeofday (&start, NULL);
+    csr = graph_csr_from_edges (edges, GRAPH_INGEST_EDGES, GRAPH_INGEST_VERTICES, 0, pool);
+    time_builder = graph_bench_wall_seconds (&start);
+    printf ("Parallel builder, %2d threads: %.3f s, %.2fx", num_workers, time_builder,
+            (time_builder > 0) ? time_graph / time_builder : 0);
+    graph_csr_deinit (csr);
+
+    gettimeofday (&start, NULL);
+    csr = graph_csr_from_edges (edges, GRAPH_INGEST_EDGES, GRAPH_INGEST_VERTICES,
+                                GRAPH_CSR_DEDUP, pool);
+    printf (", sorted and deduplicated: %.3f s\n", graph_bench_wall_seconds (&start));
+    graph_csr_deinit (csr);
+    csr = NULL;
+
+    wpool_deinit (pool);
+    pool = NULL;
+  }
+
+EXIT:
+  wpool_deinit (pool);
+  if (graph)
+    graph_deinit (graph);
+  free (edges);
+  return;
+}
+
+void graph_directed_test (void)
+{
+  const char *names[] = {"Undirected", "Directed"};
+  Graph *graph[2] = {NULL, NULL};
+  GraphCSR *csr[2] = {NULL, NULL};
+  GraphEdge *edges = NULL;
+  graph_dist_t *distance = NULL, *dag_dist = NULL, longest;
+  int *parent = NULL, *depth = NULL, *prev_node = NULL;
+  struct timeval start;
+  size_t vertex_bytes, edge_bytes;
+  int i, mode, src, mismatch;
+
+  edges     = (GraphEdge *)malloc(GRAPH_DAG_EDGES * sizeof (GraphEdge));
+  parent    = (int *)malloc(GRAPH_DAG_VERTICES * sizeof (int));
+  depth     = (int *)malloc(GRAPH_DAG_VERTICES * sizeof (int));
+  prev_node = (int *)malloc(GRAPH_DAG_VERTICES * sizeof (int));
+  distance  = (graph_dist_t *)malloc(GRAPH_DAG_VERTICES * sizeof (graph_dist_t));
+  dag_dist  = (graph_dist_t *)malloc(GRAPH_DAG_VERTICES * sizeof (graph_dist_t));
+  if (! edges || ! parent || ! depth || ! prev_node || ! distance || ! dag_dist)
+    goto EXIT;
+
+  /* Every edge goes from the lower to the higher id, so the directed graph is a DAG */
+  for (i = 0; i < GRAPH_DAG_EDGES; ++i)
+  {
+    do
+    {
+      edges[i].src  = rand () % GRAPH_DAG_VERTICES;
+      edges[i].dest = rand () % GRAPH_DAG_VERTICES;
+    } while (edges[i].src == edges[i].dest);
+
+    if (edges[i].src > edges[i].dest)
+    {
+      src           = edges[i].src;
+      edges[i].src  = edges[i].dest;
+      edges[i].dest = src;
+    }
+    edges[i].weight = rand_int (MIN_RAND, MAX_RAND);
+  }
+
+  /* The source with the lowest id reaches the most of the DAG */
+  src = edges[0].src;
+  for (i = 1; i < GRAPH_DAG_EDGES; ++i)
+    if (edges[i].src < src)
+      src = edges[i].src;
+
+  /* Same edges both ways, the directed graph keeps one arc per edge */
+  for (mode = 0; mode < 2; ++mode)
+  {
+    gettimeofday (&start, NULL);
+    graph[mode] = graph_init_flags (GRAPH_DAG_VERTICES, (mode) ? GRAPH_DIRECTED : 0);
+    if (! graph[mode] || graph_add_edges (graph[mode], edges, GRAPH_DAG_EDGES) != 0)
+      goto EXIT;
+    graph_memory_usage (graph[mode], &vertex_bytes, &edge_bytes);
+    printf ("%-10s: build %.3f s, %d arcs, %.1f MB edges",
+            names[mode], graph_bench_wall_seconds (&start), graph[mode]->numEdges,
+            edge_bytes / (1024.0 * 1024.0));
+
+    csr[mode] = graph_csr_build (graph[mode]);
+    if (! csr[mode])
+      goto EXIT;
+
+    gettimeofday (&start, NULL);
+    i = bfs_mode (csr[mode], NULL, src, BFS_TOP_DOWN, parent, depth);
+    printf (", BFS %.3f s, %d reached\n", graph_bench_wall_seconds (&start), i);
+  }
+
+  gettimeofday (&start, NULL);
+  dag_shortest_path (csr[1], src, DAG_SHORTEST_PATH, dag_dist, prev_node);
+  printf ("DAG shortest path: %.3f s", graph_bench_wall_seconds (&start));
+
+  gettimeofday (&start, NULL);
+  bellman_ford_mode (csr[1], src, BELLMAN_FORD_SPFA, NULL, distance, prev_node);
+  printf (", SPFA %.3f s", graph_bench_wall_seconds (&start));
+
+  mismatch = 0;
+  for (i = 0; i < csr[1]->numVertices; ++i)
+    if (distance[i] != dag_dist[i])
+      mismatch++;
+  printf (", %d mismatches\n", mismatch);
+
+  longest = 0;
+  dag_shortest_path (csr[1], src, DAG_LONGEST_PATH, distance, prev_node);
+  for (i = 0; i < csr[1]->numVertices; ++i)
+    if (dag_dist[i] != GRAPH_DIST_INFINITY)
+      longest = MAX(longest, distance[i]);
+  printf ("Critical path from %d: %lld\n", src, (long long)longest);
+
+EXIT:
+  if (edges)      free (edges);
+  if (parent)     free (parent);
+  if (depth)      free (depth);
+  if (prev_node)  free (prev_node);
+  if (distance)   free (distance);
+  if (dag_dist)   free (dag_dist);
+  for (mode = 0; mode < 2; ++mode)
+  {
+    graph_csr_deinit (csr[mode]);
+    if (graph[mode])
+      graph_deinit (graph[mode]);
+  }
+  return;
+}
+
+void graph_slab_test (void)
+{
+  Graph *graph = NULL;
+  GraphCSR *csr = NULL;
+  GraphEdge *edges = NULL;
+  struct timeval start;
+  int i, removed;
+
+  edges = graph_random_edges (GRAPH_INGEST_VERTICES, GRAPH_INGEST_EDGES);
+  if (! edges)
+    return;
+
+  gettimeofday (&start, NULL);
+  graph = graph_init (GRAPH_INGEST_VERTICES);
+  if (! graph)
+    goto EXIT;
+  for (i = 0; i < GRAPH_INGEST_EDGES; ++i)
+    graph_add_edge (graph, edges[i].src, edges[i].dest, edges[i].weight);
+  printf ("graph_add_edge, %d edges: %.3f s\n", GRAPH_INGEST_EDGES, graph_bench_wall_seconds (&start));
+  graph_alloc_stats_print (graph);
+
+  gettimeofday (&start, NULL);
+  csr = graph_csr_build (graph);
+  printf ("graph_csr_build: %.3f s\n", graph_bench_wall_seconds (&start));
+  graph_csr_deinit (csr);
+
+  /* Removed nodes go to the free list and are handed out again before any new slab */
+  gettimeofday (&start, NULL);
+  removed = 0;
+  for (i = 0; i < GRAPH_INGEST_EDGES; i += 2)
+    if (graph_remove_edge (graph, edges[i].src, edges[i].dest) == 0)
+      removed++;
+  printf ("Removed %d edges: %.3f s\n", removed, graph_bench_wall_seconds (&start));
+  graph_alloc_stats_print (graph);
+
+  gettimeofday (&start, NULL);
+  for (i = 0; i < GRAPH_INGEST_EDGES; i += 2)
+    graph_add_edge (graph, edges[i].src, edges[i].dest, edges[i].weight);
+  printf ("Re-added them: %.3f s\n", graph_bench_wall_seconds (&start));
+  graph_alloc_stats_print (graph);
+
+  gettimeofday (&start, NULL);
+  graph_deinit (graph);
+  graph = NULL;
+  printf ("graph_deinit: %.3f s\n", graph_bench_wall_seconds (&start));
+
+EXIT:
+  if (graph)
+    graph_deinit (graph);
+  free (edges);
+  return;
+}
+
 void thread_event_cb_test (void *input)
 {
   Event *thread;
@@ -767,12 +2181,51 @@ int main (int argc, char** argv)
   // printf ("\n************ Ford-Fulkerson's Algorithm ************* \n");
   // /* Only use for directed graph */
   // graph_ford_fulkerson (graph, 0, 3);
+  // graph_max_flow (graph, 0, 3, GRAPH_FLOW_DINIC);
 
   // printf ("\n************ Floyd-Warshall's Algorithm ************* \n");
   // graph_floyd_warshall (graph);
 
   // graph_deinit (graph);
 
+  // printf ("\n************** Graph Scale Benchmark *************** \n");
+  // graph_scale_test ();
+
+  // printf ("\n************* A* with ALT Benchmark **************** \n");
+  // graph_alt_test ();
+
+  // graph_ch_test ();
+
+  // graph_delta_stepping_test ();
+
+  // graph_bellman_ford_test ();
+
+  // graph_kruskal_test ();
+
+  // graph_prim_test ();
+
+  // graph_max_flow_test ();
+
+  // graph_floyd_warshall_test ();
+
+  // graph_bfs_test ();
+
+  // graph_bfs_parallel_test ();
+
+  // graph_ms_bfs_test ();
+
+  // graph_dfs_test ();
+
+  // graph_io_test ();
+
+  // graph_add_edges_test ();
+
+  // graph_csr_from_edges_test ();
+
+  // graph_directed_test ();
+
+  // graph_slab_test ();
+
   // printf ("\n************ Huffman Coding's Algorithm ************* \n");
   // huffman_coding_test();
 